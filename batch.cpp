@@ -0,0 +1,471 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * batch.cpp
+ *
+ * Entry file for headless analysis of many positions, such as EPD test suites
+ *
+ */
+
+
+
+/* INCLUDES */
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <louischessx/chess.h>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <regex>
+#include <span>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+
+/* PROGRAM OPTIONS NAMESPACE */
+namespace po = boost::program_options;
+
+
+
+/* POSITIONS */
+
+/* struct position_t
+ *
+ * A position read from an EPD or FEN line
+ */
+struct position_t
+{
+    /* The FEN of the position, with move clocks added if the line had none */
+    std::string fen;
+
+    /* The id operation, if any */
+    std::string id;
+
+    /* The best moves and avoid moves operations, as SAN */
+    std::vector<std::string> best_moves, avoid_moves;
+};
+
+/** @name  parse_position
+ *
+ * @brief  Parse a line of an EPD or FEN file. EPD operations other than id, bm and am are ignored.
+ * @param  line: The line to parse.
+ * @return The position, or std::nullopt if the line is empty or a comment.
+ */
+std::optional<position_t> parse_position ( const std::string& line )
+{
+    /* Split the line into the first four fields and the rest, returning if there are too few fields */
+    std::smatch line_match;
+    if ( !std::regex_match ( line, line_match, std::regex { "^\\s*([^#\\s]\\S*\\s+\\S+\\s+\\S+\\s+\\S+)\\s*(.*?)\\s*$" } ) ) return std::nullopt;
+    position_t position;
+    std::string rest = line_match.str ( 2 );
+
+    /* If the rest starts with the two move clocks, this is a FEN, otherwise add the clocks */
+    std::smatch clocks_match;
+    if ( std::regex_search ( rest, clocks_match, std::regex { "^(\\d+)\\s+(\\d+)\\s*" } ) )
+        { position.fen = line_match.str ( 1 ) + " " + clocks_match.str ( 1 ) + " " + clocks_match.str ( 2 ); rest = clocks_match.suffix (); }
+    else position.fen = line_match.str ( 1 ) + " 0 1";
+
+    /* Read the operations, each being an opcode followed by operands up to a semicolon */
+    const std::regex operation_regex { "\\s*(\\w+)\\s*((?:\"[^\"]*\"|[^;])*);?" };
+    for ( std::sregex_iterator it { rest.begin (), rest.end (), operation_regex }, end; it != end; ++it )
+    {
+        /* Get the opcode and split the operands */
+        const std::string opcode = it->str ( 1 );
+        std::istringstream operands { it->str ( 2 ) };
+
+        /* Store the operations which are used */
+        if ( opcode == "id" ) position.id = std::regex_replace ( it->str ( 2 ), std::regex { "^\\s*\"?|\"?\\s*$" }, "" ); else
+        if ( opcode == "bm" ) for ( std::string move; operands >> move; ) position.best_moves.push_back ( move ); else
+        if ( opcode == "am" ) for ( std::string move; operands >> move; ) position.avoid_moves.push_back ( move );
+    }
+
+    /* Return the position */
+    return position;
+}
+
+
+
+/* RESULTS */
+
+/** @name  escape_json
+ *
+ * @brief  Escape a string for inclusion in a JSON string.
+ * @param  str: The string to escape.
+ * @return The escaped string, without surrounding quotes.
+ */
+std::string escape_json ( const std::string& str )
+{
+    /* Escape quotes, backslashes and control characters */
+    std::ostringstream ss;
+    for ( const char c : str )
+        if ( c == '"' || c == '\\' ) ss << '\\' << c; else
+        if ( static_cast<unsigned char> ( c ) < 0x20 ) ss << "\\u" << std::hex << std::setw ( 4 ) << std::setfill ( '0' ) << static_cast<int> ( c ) << std::dec; else
+        ss << c;
+    return ss.str ();
+}
+
+/** @name  escape_csv
+ *
+ * @brief  Quote a string for a CSV field, if necessary.
+ * @param  str: The string to escape.
+ * @return The field.
+ */
+std::string escape_csv ( const std::string& str )
+{
+    /* Return the string unchanged unless it contains a comma, quote or newline */
+    if ( str.find_first_of ( ",\"\n" ) == std::string::npos ) return str;
+
+    /* Otherwise quote it, doubling any quotes */
+    return "\"" + std::regex_replace ( str, std::regex { "\"" }, "\"\"" ) + "\"";
+}
+
+/* struct result_t
+ *
+ * The result of analysing a position
+ */
+struct result_t
+{
+    /* The best move as SAN, and its value */
+    std::string best_move;
+    int score = 0;
+
+    /* The depth searched, and the number of nodes visited over every depth */
+    int depth = 0;
+    unsigned long long nodes = 0;
+
+    /* The time taken */
+    std::chrono::duration<double> duration {};
+
+    /* Whether the position has bm or am operations, and if so whether the best move satisfies them */
+    bool checked = false, solved = false;
+
+    /* An error message, if the position could not be analysed */
+    std::string error;
+};
+
+/* The type of a function which searches a board, returning the result and setting the number of nodes visited over every depth */
+using search_function_t = std::function<chess::chessboard::ab_result_t ( chess::chessboard& cb, chess::pcolor pc, unsigned long long& nodes )>;
+
+/** @name  search_locally
+ *
+ * @brief  Search a position on this machine, to a fixed depth or until a node budget is used.
+ * @param  cb: The position to search.
+ * @param  pc: The color whose move it is next.
+ * @param  depth: The depth to search to.
+ * @param  max_nodes: The node budget.
+ * @param  ttable: The transposition table to use, which is cleared first so that the result does not depend on previous positions.
+ * @param  nodes: Set to the number of nodes visited over every depth.
+ * @return The result.
+ */
+chess::chessboard::ab_result_t search_locally ( chess::chessboard& cb, const chess::pcolor pc, const int depth, const unsigned long long max_nodes, chess::chessboard::ab_ttable_t& ttable, unsigned long long& nodes )
+{
+    /* Clear the ttable */
+    ttable.clear ();
+
+    /* Search every depth up to the requested depth, counting the nodes of every depth */
+    std::vector<int> depths ( depth ); std::iota ( depths.begin (), depths.end (), 1 );
+    chess::chessboard::ab_result_t ab_result = cb.alpha_beta_iterative_deepening ( pc, depths, true, ttable, std::stop_token {}, chess::chess_clock::time_point::max (), {}, true, 1, max_nodes );
+    nodes = ab_result.total_nodes;
+    return ab_result;
+}
+
+/** @name  analyse_position
+ *
+ * @brief  Search a position, and check the best move against its operations.
+ * @param  position: The position to analyse.
+ * @param  search: The function to search the position with.
+ * @return The result.
+ */
+result_t analyse_position ( const position_t& position, const search_function_t& search ) try
+{
+    /* Set up the board */
+    chess::chessboard cb;
+    const chess::pcolor pc = cb.fen_deserialize_board ( position.fen );
+
+    /* The search requires one king of each color, and that the color not to move is not in check */
+    if ( cb.bb ( chess::pcolor::white, chess::ptype::king ).popcount () != 1 || cb.bb ( chess::pcolor::black, chess::ptype::king ).popcount () != 1 )
+        throw chess::chess_input_error { "Position must have one king of each color." };
+    if ( cb.is_in_check ( chess::other_color ( pc ) ) ) throw chess::chess_input_error { "The color not to move is in check." };
+
+    /* Search the position */
+    result_t result;
+    const auto t0 = std::chrono::steady_clock::now ();
+    const chess::chessboard::ab_result_t ab_result = search ( cb, pc, result.nodes );
+    result.duration = std::chrono::steady_clock::now () - t0;
+
+    /* Return if there are no legal moves */
+    result.depth = ab_result.depth;
+    if ( ab_result.moves.empty () ) { result.error = "no legal moves"; return result; }
+
+    /* Set the best move and score */
+    const chess::move_t& best_move = ab_result.moves.front ().first;
+    result.best_move = cb.fide_serialize_move ( best_move );
+    result.score = ab_result.moves.front ().second;
+
+    /* Check the best move against the bm and am operations, comparing the deserialized moves so that SAN variations do not matter */
+    auto matches = [ & ] ( const std::string& desc ) { const chess::move_t move = cb.fide_deserialize_move ( pc, desc ); return move.is_similar ( best_move ) && move.promote_pt == best_move.promote_pt; };
+    result.checked = position.best_moves.size () || position.avoid_moves.size ();
+    result.solved = ( position.best_moves.empty () || std::any_of ( position.best_moves.begin (), position.best_moves.end (), matches ) )
+        && std::none_of ( position.avoid_moves.begin (), position.avoid_moves.end (), matches );
+
+    /* Return the result */
+    return result;
+}
+
+/* Catch an input error, such as an invalid FEN */
+catch ( const chess::chess_input_error& e )
+{
+    /* Return the error */
+    result_t result; result.error = e.what ();
+    return result;
+}
+
+/** @name  format_result
+ *
+ * @brief  Format the result of a position as a CSV row or JSON line.
+ * @param  index: The index of the position in the input.
+ * @param  position: The position.
+ * @param  result: The result.
+ * @param  json: Whether to format as JSON, rather than CSV.
+ * @return The line, without a newline.
+ */
+std::string format_result ( const std::size_t index, const position_t& position, const result_t& result, const bool json )
+{
+    /* Get the nodes per second */
+    const unsigned long long nps = ( result.duration.count () > 0 ? result.nodes / result.duration.count () : 0 );
+    const long long time_ms = std::chrono::duration_cast<std::chrono::milliseconds> ( result.duration ).count ();
+
+    /* Format the line */
+    std::ostringstream ss;
+    if ( json )
+    {
+        ss << "{\"index\":" << index << ",\"id\":\"" << escape_json ( position.id ) << "\",\"fen\":\"" << escape_json ( position.fen ) << '"';
+        if ( result.error.size () ) ss << ",\"error\":\"" << escape_json ( result.error ) << '"';
+        else ss << ",\"best_move\":\"" << escape_json ( result.best_move ) << "\",\"score\":" << result.score << ",\"depth\":" << result.depth << ",\"nodes\":" << result.nodes << ",\"time_ms\":" << time_ms << ",\"nps\":" << nps;
+        if ( result.checked && result.error.empty () ) ss << ",\"solved\":" << ( result.solved ? "true" : "false" );
+        ss << '}';
+    } else
+    {
+        ss << index << ',' << escape_csv ( position.id ) << ',' << escape_csv ( position.fen ) << ',';
+        if ( result.error.empty () ) ss << escape_csv ( result.best_move ) << ',' << result.score << ',' << result.depth << ',' << result.nodes << ',' << time_ms << ',' << nps << ',';
+        else ss << ",,,,,,";
+        ss << ( result.checked && result.error.empty () ? ( result.solved ? "1" : "0" ) : "" ) << ',' << escape_csv ( result.error );
+    }
+
+    /* Return the line */
+    return ss.str ();
+}
+
+
+
+/** @name  main
+ *
+ * @brief  Main function
+ * @param  argc: The number of command line parameters
+ * @param  argv: The command line parameters.
+ * @return 0, unless an error occured.
+ */
+int main ( const int argc, const char ** argv )
+{
+    /* Create a complete options description for the executable */
+    po::options_description options_desc;
+    options_desc.add_options ()
+
+        /* Help option */
+        ( "help,h", "produce help message" )
+
+        /* Input and output options */
+        ( "input,i", po::value<std::string> ()->default_value ( "-" ), "an EPD or FEN file with one position per line, or - for stdin" )
+        ( "output,o", po::value<std::string> ()->default_value ( "-" ), "the file to write results to, or - for stdout" )
+        ( "format,f", po::value<std::string> ()->default_value ( "csv" ), "the format of the results, either 'csv' or 'jsonl'" )
+
+        /* Search options */
+        ( "depth,d", po::value<int> ()->default_value ( 6 ), "the depth to search each position to" )
+        ( "nodes,n", po::value<unsigned long long> (), "stop searching each position after this many nodes, keeping the deepest complete depth (the first depth always completes)" )
+        ( "threads,t", po::value<int> ()->default_value ( std::max<int> ( std::thread::hardware_concurrency (), 1 ) ), "the number of positions to search in parallel on this machine, which may be 0 if there are workers" )
+        ( "hash,m", po::value<std::size_t> ()->default_value ( 16 ), "the size of each thread's transposition table in MB" )
+
+        /* Distributed search options */
+        ( "listen", po::value<int> (), "run as a worker for other machines on this TCP port, searching each position with --threads threads, instead of reading positions" )
+        ( "bind", po::value<std::string> ()->default_value ( "127.0.0.1" ), "the address to listen on with --listen, which is '::' for every interface. There is no authentication, so only listen on trusted networks" )
+        ( "max-connections", po::value<int> ()->default_value ( 1 ), "the number of coordinators a worker serves at once, each with its own transposition table and --threads threads, while any others wait" )
+        ( "worker,w", po::value<std::vector<std::string>> ()->composing (), "the host:port of a worker to search positions on as well as the local threads, which may be given several times" )
+        ( "split-root", "split the root moves of each position between the workers, searching one position at a time, rather than searching positions on each worker and local thread" )
+
+        /* Evaluation options */
+        ( "nnue", po::value<std::string> (), "an NNUE network file to evaluate positions with" )
+        ( "eval", po::value<std::string> (), "the evaluator to use, either 'handcrafted' or 'nnue' (defaults to 'nnue' only if a network is given)" );
+
+    /* Allow the input file to be given without --input */
+    po::positional_options_description positional_desc;
+    positional_desc.add ( "input", 1 );
+
+    /* Create a variables map and extract the command line arguments from argc and argv */
+    po::variables_map variables_map;
+    po::store ( po::command_line_parser ( argc, argv ).options ( options_desc ).positional ( positional_desc ).run (), variables_map );
+    po::notify ( variables_map );
+
+    /* If the help option was given, output the help and return */
+    if ( variables_map.count ( "help" ) )
+    {
+        /* Output the help */
+        std::cout << "Usage: louischessx_batch [options] [input]" << std::endl << options_desc << std::endl;
+
+        /* Return 0 */
+        return 0;
+    }
+
+    /* Get the search options, and throw if invalid */
+    const int depth = variables_map.at ( "depth" ).as<int> (), num_threads = variables_map.at ( "threads" ).as<int> ();
+    const std::string format = variables_map.at ( "format" ).as<std::string> ();
+    const unsigned long long max_nodes = ( variables_map.count ( "nodes" ) ? variables_map.at ( "nodes" ).as<unsigned long long> () : std::numeric_limits<unsigned long long>::max () );
+    if ( depth < 1 ) throw chess::chess_input_error { "Depth must be positive." };
+    if ( num_threads < 0 ) throw chess::chess_input_error { "Number of threads must not be negative." };
+    if ( format != "csv" && format != "jsonl" ) throw chess::chess_input_error { "Unknown format '" + format + "'." };
+
+    /* If a network is specified, load it, then choose the evaluator */
+    if ( variables_map.count ( "nnue" ) ) chess::nnue::load ( variables_map.at ( "nnue" ).as<std::string> () );
+    const std::string evaluator = ( variables_map.count ( "eval" ) ? variables_map.at ( "eval" ).as<std::string> () : chess::nnue::is_loaded () ? "nnue" : "handcrafted" );
+    if ( evaluator == "nnue" ) chess::chessboard::set_evaluator ( chess::chessboard::evaluator_t::nnue ); else
+    if ( evaluator == "handcrafted" ) chess::chessboard::set_evaluator ( chess::chessboard::evaluator_t::handcrafted ); else
+    throw chess::chess_input_error { "Unknown evaluator '" + evaluator + "'." };
+
+    /* If listening, serve other machines forever */
+    if ( variables_map.count ( "listen" ) ) chess::remote_server { variables_map.at ( "bind" ).as<std::string> (), variables_map.at ( "listen" ).as<int> () }
+        .serve ( variables_map.at ( "hash" ).as<std::size_t> (), num_threads, variables_map.at ( "max-connections" ).as<int> () );
+
+    /* Connect to the workers */
+    std::vector<chess::remote_worker> workers;
+    if ( variables_map.count ( "worker" ) ) for ( const std::string& address : variables_map.at ( "worker" ).as<std::vector<std::string>> () ) workers.emplace_back ( address );
+    const bool split_root = variables_map.count ( "split-root" );
+    if ( split_root && workers.empty () ) throw chess::chess_input_error { "Splitting root moves requires at least one worker." };
+    if ( num_threads == 0 && workers.empty () ) throw chess::chess_input_error { "There must be at least one thread or worker to search with." };
+
+    /* Open the input and output */
+    std::ifstream input_file; std::ofstream output_file;
+    if ( variables_map.at ( "input"  ).as<std::string> () != "-" ) { input_file.open  ( variables_map.at ( "input"  ).as<std::string> () ); if ( !input_file  ) throw chess::chess_input_error { "Failed to open input file." }; }
+    if ( variables_map.at ( "output" ).as<std::string> () != "-" ) { output_file.open ( variables_map.at ( "output" ).as<std::string> () ); if ( !output_file ) throw chess::chess_input_error { "Failed to open output file." }; }
+    std::istream& input = ( input_file.is_open () ? input_file : std::cin );
+    std::ostream& output = ( output_file.is_open () ? output_file : std::cout );
+
+
+
+    /* Read the positions */
+    std::vector<position_t> positions;
+    for ( std::string line; std::getline ( input, line ); ) if ( std::optional<position_t> position = parse_position ( line ) ) positions.push_back ( std::move ( * position ) );
+
+    /* Write the CSV header */
+    if ( format == "csv" ) output << "index,id,fen,best_move,score,depth,nodes,time_ms,nps,solved,error" << std::endl;
+
+    /* The index of the next position to search, the positions put back by threads whose workers lost their connection, and the number of positions being searched.
+     * Then the results not yet written, the index of the next result to write, and the totals. All are protected by results_mx.
+     */
+    std::size_t next_position = 0, num_searching = 0;
+    std::vector<std::size_t> returned_positions;
+    std::vector<std::optional<result_t>> results ( positions.size () );
+    std::size_t next_result = 0, num_checked = 0, num_solved = 0;
+    unsigned long long total_nodes = 0;
+    std::mutex results_mx;
+    std::condition_variable positions_cv;
+
+    /* Take a position to search, preferring those put back. While there are none left, but other threads are searching and so may put one back, wait. */
+    auto take_position = [ & ] () -> std::optional<std::size_t>
+    {
+        std::unique_lock results_lock { results_mx };
+        positions_cv.wait ( results_lock, [ & ] () { return returned_positions.size () || next_position < positions.size () || num_searching == 0; } );
+        if ( returned_positions.empty () && next_position == positions.size () ) return std::nullopt;
+        std::size_t index = next_position;
+        if ( returned_positions.size () ) { index = returned_positions.back (); returned_positions.pop_back (); } else ++next_position;
+        ++num_searching;
+        return index;
+    };
+
+    /* Store a result, then write any results which are now in order */
+    auto store_result = [ & ] ( const std::size_t index, result_t result )
+    {
+        std::unique_lock results_lock { results_mx };
+        results.at ( index ) = std::move ( result );
+        for ( ; next_result < results.size () && results.at ( next_result ); ++next_result )
+        {
+            const result_t& next = * results.at ( next_result );
+            output << format_result ( next_result, positions.at ( next_result ), next, format == "jsonl" ) << std::endl;
+            total_nodes += next.nodes; num_checked += next.checked && next.error.empty (); num_solved += next.checked && next.solved && next.error.empty ();
+            results.at ( next_result ).reset ();
+        }
+    };
+
+    /* Search the positions on a pool of threads: each local thread has its own ttable, and each worker is used by its own thread.
+     * If splitting root moves, there is instead a single thread, searching each position on every worker.
+     * If a worker loses its connection, the position is put back for the other threads, and the thread using that worker stops.
+     * Results are written in the order of the input, as soon as every earlier result is also complete.
+     */
+    const auto t0 = std::chrono::steady_clock::now ();
+    {
+        std::vector<std::jthread> threads;
+        const std::size_t num_searchers = ( split_root ? 1 : num_threads + workers.size () );
+        for ( std::size_t i = 0; i < num_searchers; ++i ) threads.emplace_back ( [ &, i ] ()
+        {
+            /* Choose the workers to search on, which are every worker if splitting root moves, or else one worker for the threads after the local threads */
+            const std::span<chess::remote_worker> search_workers = ( split_root ? std::span { workers } : i >= static_cast<std::size_t> ( num_threads ) ? std::span { workers }.subspan ( i - num_threads, 1 ) : std::span<chess::remote_worker> {} );
+
+            /* Search on the workers, or locally by allocating a ttable */
+            chess::chessboard::ab_ttable_t ttable;
+            search_function_t search;
+            if ( search_workers.size () ) search = [ & ] ( chess::chessboard& cb, const chess::pcolor pc, unsigned long long& nodes )
+                { chess::chessboard::ab_result_t ab_result = chess::remote_search ( cb, pc, depth, max_nodes, search_workers ); nodes = ab_result.total_nodes; return ab_result; };
+            else
+            {
+                ttable = chess::chessboard::ab_ttable_t { variables_map.at ( "hash" ).as<std::size_t> () };
+                search = [ & ] ( chess::chessboard& cb, const chess::pcolor pc, unsigned long long& nodes ) { return search_locally ( cb, pc, depth, max_nodes, ttable, nodes ); };
+            }
+
+            /* Take positions until there are none left */
+            for ( std::optional<std::size_t> index; ( index = take_position () ); )
+            {
+                /* Analyse the position */
+                result_t result = analyse_position ( positions.at ( * index ), search );
+
+                /* If a worker has lost its connection, put the position back and stop this thread */
+                if ( const auto lost_it = std::find_if ( search_workers.begin (), search_workers.end (), [] ( const chess::remote_worker& worker ) { return !worker.is_connected (); } ); lost_it != search_workers.end () )
+                {
+                    std::unique_lock results_lock { results_mx };
+                    std::cerr << "lost connection to worker " << lost_it->get_address () << ", searching its positions elsewhere" << std::endl;
+                    returned_positions.push_back ( * index ); --num_searching;
+                    positions_cv.notify_all ();
+                    return;
+                }
+
+                /* Store the result, then wake any threads waiting for positions to be put back, in case this was the last search */
+                store_result ( * index, std::move ( result ) );
+                { std::unique_lock results_lock { results_mx }; --num_searching; }
+                positions_cv.notify_all ();
+            }
+        } );
+    }
+
+    /* If every thread stopped, the positions put back or not yet taken could not be searched */
+    for ( ; next_position < positions.size (); ++next_position ) returned_positions.push_back ( next_position );
+    for ( const std::size_t index : returned_positions ) { result_t result; result.error = "no thread or worker left to search with"; store_result ( index, std::move ( result ) ); }
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now () - t0;
+
+    /* Output the totals */
+    std::cerr << "positions " << positions.size ();
+    if ( num_checked ) std::cerr << " solved " << num_solved << "/" << num_checked;
+    std::cerr << " total nodes " << total_nodes << " time " << std::fixed << std::setprecision ( 3 ) << duration.count () << "s nps " << static_cast<unsigned long long> ( duration.count () > 0 ? total_nodes / duration.count () : 0 ) << std::endl;
+
+
+
+    /* Return 0 */
+    return 0;
+}
@@ -25,6 +25,10 @@
 #include <louischessx/macros.h>
 #include <string>
 
+#if CHESS_USE_PEXT || CHESS_USE_SSE2
+    #include <immintrin.h>
+#endif
+
 
 
 /* DECLARATIONS */
@@ -91,6 +95,13 @@ namespace chess
      */
     class chessboard;
 
+    /* class bitboard_pair
+     *
+     * A pair of bitboards, to which each operation is applied at once.
+     * Forward reference to bitboard can friend it.
+     */
+    class bitboard_pair;
+
 
 
     /* BITBOARD CREATION */
@@ -119,8 +130,9 @@ namespace chess
 class chess::bitboard
 {
 
-    /* Friend chessboard */
+    /* Friend chessboard and bitboard_pair */
     friend chessboard;
+    friend bitboard_pair;
 
 public:
 
@@ -762,6 +774,24 @@ public:
     chess_const static constexpr bitboard omnidir_attack_lookup ( compass dir, int pos ) noexcept { return bitboard { omnidir_attack_lookups [ cast_compass ( dir ) ] [ pos ] }; }
     chess_const static constexpr bitboard omnidir_attack_lookup ( compass dir, int rank, int file ) noexcept { return bitboard { omnidir_attack_lookups [ cast_compass ( dir ) ] [ rank * 8 + file ] }; }
 
+    /** @name  straight/diagonal/queen_sliding_attack_lookup
+     * 
+     * @brief  Lookup the attacks of a single sliding piece, given the occupied cells of the board.
+     *         The attacks stop at, and include, the first occupied cell in each direction.
+     *         The cells are found from magic bitboard tables, indexed by PEXT if CHESS_USE_PEXT is true.
+     * @param  pos:  The absolute position [0,63]
+     * @param  rank: The rank of the bit [0,7]
+     * @param  file: The file of the bit [0,7]
+     * @param  occ:  The occupied cells of the board
+     * @return bitboard
+     */
+    chess_pure static bitboard straight_sliding_attack_lookup ( int pos, bitboard occ ) noexcept;
+    chess_pure static bitboard diagonal_sliding_attack_lookup ( int pos, bitboard occ ) noexcept;
+    chess_pure static bitboard queen_sliding_attack_lookup    ( int pos, bitboard occ ) noexcept;
+    chess_pure static bitboard straight_sliding_attack_lookup ( int rank, int file, bitboard occ ) noexcept { return straight_sliding_attack_lookup ( rank * 8 + file, occ ); }
+    chess_pure static bitboard diagonal_sliding_attack_lookup ( int rank, int file, bitboard occ ) noexcept { return diagonal_sliding_attack_lookup ( rank * 8 + file, occ ); }
+    chess_pure static bitboard queen_sliding_attack_lookup    ( int rank, int file, bitboard occ ) noexcept { return queen_sliding_attack_lookup    ( rank * 8 + file, occ ); }
+
 
 
     /* FORMATTING */
@@ -1078,6 +1108,58 @@ private:
 
 
 
+    /* MAGIC SLIDING ATTACKS */
+
+    /* struct magic_t
+     *
+     * The relevant occupancy mask, magic multiplier, shift and table offset for a sliding piece on a single cell
+     */
+    struct magic_t
+    {
+        unsigned long long mask;
+        unsigned long long magic;
+        unsigned shift;
+        unsigned offset;
+    };
+
+    /* struct sliding_attack_tables_t
+     *
+     * The magics and attack tables for straight and diagonal sliding pieces. Filled by the constructor in bitboard.cpp.
+     */
+    struct sliding_attack_tables_t
+    {
+        /* The number of entries in each attack table */
+        static constexpr unsigned straight_table_size = 102400;
+        static constexpr unsigned diagonal_table_size = 5248;
+
+        /* The magics for each cell */
+        std::array<magic_t, 64> straight_magics;
+        std::array<magic_t, 64> diagonal_magics;
+
+        /* The attack tables */
+        std::array<unsigned long long, straight_table_size> straight_attacks;
+        std::array<unsigned long long, diagonal_table_size> diagonal_attacks;
+
+        /** @name  default constructor
+         * 
+         * @brief  Computes the relevant occupancy masks, searches for magics (unless PEXT is used), and fills the attack tables
+         */
+        sliding_attack_tables_t ();
+    };
+
+    /* The sliding attack tables */
+    static const sliding_attack_tables_t sliding_attack_tables;
+
+    /** @name  magic_index
+     * 
+     * @brief  Get the index into an attack table from a magic and the occupied cells of the board
+     * @param  m: The magic for the cell
+     * @param  occ: The occupied cells of the board
+     * @return The index into the attack table
+     */
+    chess_pure static unsigned magic_index ( const magic_t& m, bitboard occ ) noexcept;
+
+
     /* INTERNAL METHODS */
 
     /** @name  shift_val, shift_mask
@@ -1106,6 +1188,182 @@ private:
 
 
 
+/* CLASS BITBOARD PAIR DEFINITION */
+
+/* class bitboard_pair
+ *
+ * A pair of bitboards, to which each operation is applied at once.
+ * This is used to compute the white and black versions of symmetric evaluation terms together, white being the first of each pair by convention.
+ * If CHESS_USE_SSE2 is true, the bitboards are stored in a single 128-bit register, so most operations on the pair are a single instruction.
+ * Otherwise the operations are applied to each bitboard in turn.
+ */
+class chess::bitboard_pair
+{
+public:
+
+    /* CONSTRUCTORS */
+
+    /** @name default constructor 
+     * 
+     * @brief  Both bitboards are empty
+     */
+    bitboard_pair () noexcept : bitboard_pair { bitboard {}, bitboard {} } {}
+
+    /** @name  pair constructor
+     * 
+     * @param  first: The first bitboard
+     * @param  second: The second bitboard
+     */
+    bitboard_pair ( bitboard first, bitboard second ) noexcept;
+
+    /** @name  broadcast constructor
+     * 
+     * @param  both: The bitboard to set both bitboards to
+     */
+    explicit bitboard_pair ( bitboard both ) noexcept : bitboard_pair { both, both } {}
+
+
+
+    /* ACCESS */
+
+    /** @name  first, second
+     * 
+     * @return The first or second bitboard of the pair
+     */
+    chess_pure bitboard first  () const noexcept;
+    chess_pure bitboard second () const noexcept;
+
+    /** @name  swap
+     * 
+     * @return A new pair with the first and second bitboards swapped
+     */
+    chess_pure bitboard_pair swap () const noexcept;
+
+
+
+    /* SET OPERATORS */
+
+    /** @name  operator&, operator|, operator^
+     * 
+     * @brief  Bitwise operators, applied to each bitboard with its counterpart in other
+     * @param  other: The other pair required for the bitwise operation
+     * @return A new pair from the bitwise operation of this and other
+     */
+    chess_pure bitboard_pair operator& ( bitboard_pair other ) const noexcept;
+    chess_pure bitboard_pair operator| ( bitboard_pair other ) const noexcept;
+    chess_pure bitboard_pair operator^ ( bitboard_pair other ) const noexcept;
+
+    /** @name  operator~
+     * 
+     * @brief  Ones-complement of both bitboards
+     * @return A new pair from the ones-complement of this pair
+     */
+    chess_pure bitboard_pair operator~ () const noexcept;
+
+    /** @name  operator&=, operator|=, operator^=
+     * 
+     * @brief  Bitwise assignment operators
+     * @param  other: The other pair required for the bitwise operation
+     * @return A reference to this pair
+     */
+    bitboard_pair& operator&= ( bitboard_pair other ) noexcept { return * this = * this & other; }
+    bitboard_pair& operator|= ( bitboard_pair other ) noexcept { return * this = * this | other; }
+    bitboard_pair& operator^= ( bitboard_pair other ) noexcept { return * this = * this ^ other; }
+
+
+
+    /* BIT COUNTING */
+
+    /** @name  popcount_diff
+     * 
+     * @brief  Count the set bits of each bitboard
+     * @return The number of set bits in the first bitboard, minus those in the second
+     */
+    chess_pure int popcount_diff () const noexcept { return first ().popcount () - second ().popcount (); }
+
+
+
+    /* SHIFTS AND FILLS */
+
+    /** @name  shift
+     * 
+     * @brief  Shift both bitboards in a compass direction
+     * @see    bitboard::shift ()
+     * @param  dir: Compass direction
+     * @return A new pair
+     */
+    chess_pure bitboard_pair shift ( compass dir ) const noexcept { return bitshift ( bitboard::shift_val ( dir ) ) & bitboard_pair { bitboard::shift_mask ( dir ) }; }
+
+    /** @name  fill
+     * 
+     * @brief  Fill both bitboards in a given direction taking into account occluders
+     * @see    bitboard::fill ()
+     * @param  dir: The direction to fill
+     * @param  p: Propagator sets: set bits are where each board is allowed to flow, universe by default
+     * @return A new pair
+     */
+    chess_pure bitboard_pair fill ( compass dir, bitboard_pair p = bitboard_pair { ~bitboard {} } ) const noexcept;
+
+    /** @name  span
+     * 
+     * @brief  Span both bitboards in a given direction taking into account occluders
+     * @see    bitboard::span ()
+     * @param  dir: The direction to span
+     * @param  pp: Primary propagator sets, universe by default
+     * @param  sp: Secondary propagator sets, empty by default
+     * @return A new pair
+     */
+    chess_pure bitboard_pair span ( compass dir, bitboard_pair pp = bitboard_pair { ~bitboard {} }, bitboard_pair sp = bitboard_pair {} ) const noexcept { return fill ( dir, pp ).shift ( dir ) & ( pp | sp ); }
+
+    /** @name  rook/bishop_attack
+     * 
+     * @brief  Gives the possible movement of sliding pieces in both bitboards
+     * @see    bitboard::rook_attack (), bitboard::bishop_attack ()
+     * @param  dir: The direction to fill
+     * @param  pp: Primary propagator sets, universe by default
+     * @param  sp: Secondary propagator sets, empty by default
+     * @return A new pair
+     */
+    chess_pure bitboard_pair rook_attack   ( straight_compass dir, bitboard_pair pp = bitboard_pair { ~bitboard {} }, bitboard_pair sp = bitboard_pair {} ) const noexcept { return span ( static_cast<compass> ( dir ), pp, sp ); }
+    chess_pure bitboard_pair bishop_attack ( diagonal_compass dir, bitboard_pair pp = bitboard_pair { ~bitboard {} }, bitboard_pair sp = bitboard_pair {} ) const noexcept { return span ( static_cast<compass> ( dir ), pp, sp ); }
+
+
+
+private:
+
+    /* ATTRIBUTES */
+
+    /* The contents of the pair, the first bitboard in the low 64 bits of the register */
+#if CHESS_USE_SSE2
+    __m128i bits;
+#else
+    bitboard first_bits, second_bits;
+#endif
+
+
+
+    /* INTERNAL METHODS */
+
+#if CHESS_USE_SSE2
+    /** @name  register constructor
+     * 
+     * @param  _bits: The register to store
+     */
+    explicit bitboard_pair ( __m128i _bits ) noexcept : bits { _bits } {}
+#endif
+
+    /** @name  bitshift
+     * 
+     * @brief  Shift both bitboards by the same offset
+     * @param  offset: Positive for a left shift, negative for a right shift
+     * @return A new pair
+     */
+    chess_pure bitboard_pair bitshift ( int offset ) const noexcept;
+
+};
+
+
+
 /* INCLUDE INLINE IMPLEMENTATION */
 #include <louischessx/bitboard.hpp>
 
@@ -633,5 +633,147 @@ inline constexpr chess::bitboard chess::bitboard::knight_mult_attack ( const bit
 
 
 
+
+/* MAGIC SLIDING ATTACKS */
+
+/** @name  magic_index
+ * 
+ * @brief  Get the index into an attack table from a magic and the occupied cells of the board
+ * @param  m: The magic for the cell
+ * @param  occ: The occupied cells of the board
+ * @return The index into the attack table
+ */
+inline unsigned chess::bitboard::magic_index ( const magic_t& m, const bitboard occ ) noexcept
+{
+#if CHESS_USE_PEXT
+    return m.offset + _pext_u64 ( occ.bits, m.mask );
+#else
+    return m.offset + ( ( ( occ.bits & m.mask ) * m.magic ) >> m.shift );
+#endif
+}
+
+/** @name  straight/diagonal/queen_sliding_attack_lookup
+ * 
+ * @brief  Lookup the attacks of a single sliding piece, given the occupied cells of the board.
+ *         The attacks stop at, and include, the first occupied cell in each direction.
+ * @param  pos: The absolute position [0,63]
+ * @param  occ: The occupied cells of the board
+ * @return bitboard
+ */
+inline chess::bitboard chess::bitboard::straight_sliding_attack_lookup ( const int pos, const bitboard occ ) noexcept
+    { return bitboard { sliding_attack_tables.straight_attacks [ magic_index ( sliding_attack_tables.straight_magics [ pos ], occ ) ] }; }
+inline chess::bitboard chess::bitboard::diagonal_sliding_attack_lookup ( const int pos, const bitboard occ ) noexcept
+    { return bitboard { sliding_attack_tables.diagonal_attacks [ magic_index ( sliding_attack_tables.diagonal_magics [ pos ], occ ) ] }; }
+inline chess::bitboard chess::bitboard::queen_sliding_attack_lookup ( const int pos, const bitboard occ ) noexcept
+    { return straight_sliding_attack_lookup ( pos, occ ) | diagonal_sliding_attack_lookup ( pos, occ ); }
+
+
+
+
+/* BITBOARD PAIR */
+
+
+
+/** @name  pair constructor
+ * 
+ * @param  first: The first bitboard
+ * @param  second: The second bitboard
+ */
+inline chess::bitboard_pair::bitboard_pair ( const bitboard first, const bitboard second ) noexcept
+#if CHESS_USE_SSE2
+    : bits { _mm_set_epi64x ( second.bits, first.bits ) } {}
+#else
+    : first_bits { first }, second_bits { second } {}
+#endif
+
+/** @name  first, second
+ * 
+ * @return The first or second bitboard of the pair
+ */
+inline chess::bitboard chess::bitboard_pair::first () const noexcept
+{
+#if CHESS_USE_SSE2
+    return bitboard { static_cast<unsigned long long> ( _mm_cvtsi128_si64 ( bits ) ) };
+#else
+    return first_bits;
+#endif
+}
+inline chess::bitboard chess::bitboard_pair::second () const noexcept
+{
+#if CHESS_USE_SSE2
+    return bitboard { static_cast<unsigned long long> ( _mm_cvtsi128_si64 ( _mm_unpackhi_epi64 ( bits, bits ) ) ) };
+#else
+    return second_bits;
+#endif
+}
+
+/** @name  swap
+ * 
+ * @return A new pair with the first and second bitboards swapped
+ */
+inline chess::bitboard_pair chess::bitboard_pair::swap () const noexcept
+{
+#if CHESS_USE_SSE2
+    return bitboard_pair { _mm_shuffle_epi32 ( bits, 0x4e ) };
+#else
+    return bitboard_pair { second_bits, first_bits };
+#endif
+}
+
+/** @name  operator&, operator|, operator^, operator~
+ * 
+ * @brief  Bitwise operators, applied to each bitboard with its counterpart in other
+ * @param  other: The other pair required for the bitwise operation
+ * @return A new pair
+ */
+#if CHESS_USE_SSE2
+inline chess::bitboard_pair chess::bitboard_pair::operator& ( const bitboard_pair other ) const noexcept { return bitboard_pair { _mm_and_si128 ( bits, other.bits ) }; }
+inline chess::bitboard_pair chess::bitboard_pair::operator| ( const bitboard_pair other ) const noexcept { return bitboard_pair { _mm_or_si128  ( bits, other.bits ) }; }
+inline chess::bitboard_pair chess::bitboard_pair::operator^ ( const bitboard_pair other ) const noexcept { return bitboard_pair { _mm_xor_si128 ( bits, other.bits ) }; }
+inline chess::bitboard_pair chess::bitboard_pair::operator~ () const noexcept { return bitboard_pair { _mm_xor_si128 ( bits, _mm_set1_epi64x ( -1 ) ) }; }
+#else
+inline chess::bitboard_pair chess::bitboard_pair::operator& ( const bitboard_pair other ) const noexcept { return bitboard_pair { first_bits & other.first_bits, second_bits & other.second_bits }; }
+inline chess::bitboard_pair chess::bitboard_pair::operator| ( const bitboard_pair other ) const noexcept { return bitboard_pair { first_bits | other.first_bits, second_bits | other.second_bits }; }
+inline chess::bitboard_pair chess::bitboard_pair::operator^ ( const bitboard_pair other ) const noexcept { return bitboard_pair { first_bits ^ other.first_bits, second_bits ^ other.second_bits }; }
+inline chess::bitboard_pair chess::bitboard_pair::operator~ () const noexcept { return bitboard_pair { ~first_bits, ~second_bits }; }
+#endif
+
+/** @name  bitshift
+ * 
+ * @brief  Shift both bitboards by the same offset
+ * @param  offset: Positive for a left shift, negative for a right shift
+ * @return A new pair
+ */
+inline chess::bitboard_pair chess::bitboard_pair::bitshift ( const int offset ) const noexcept
+{
+#if CHESS_USE_SSE2
+    return bitboard_pair { offset > 0 ? _mm_sll_epi64 ( bits, _mm_cvtsi32_si128 ( offset ) ) : _mm_srl_epi64 ( bits, _mm_cvtsi32_si128 ( -offset ) ) };
+#else
+    return bitboard_pair { first_bits.bitshift ( offset ), second_bits.bitshift ( offset ) };
+#endif
+}
+
+/** @name  fill
+ *
+ * @brief  Fill both bitboards in a given direction taking into account occluders
+ * @see    bitboard::fill ()
+ * @param  dir: The direction to fill
+ * @param  p: Propagator sets: set bits are where each board is allowed to flow, universe by default
+ * @return A new pair
+ */
+inline chess::bitboard_pair chess::bitboard_pair::fill ( const compass dir, bitboard_pair p ) const noexcept
+{
+    bitboard_pair x { * this }; int r = bitboard::shift_val ( dir );
+    p &=     bitboard_pair { bitboard::shift_mask ( dir ) };
+    x |= p & x.bitshift ( r );
+    p &=     p.bitshift ( r );
+    x |= p & x.bitshift ( r * 2 );
+    p &=     p.bitshift ( r * 2 );
+    x |= p & x.bitshift ( r * 4 );
+    return x;
+}
+
+
+
 /* HEADER GUARD */
 #endif /* #ifndef CHESS_BITBOARD_HPP_INCLUDED */
\ No newline at end of file
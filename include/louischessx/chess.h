@@ -15,4 +15,9 @@
 /* INCLUDES */
 #include <louischessx/bitboard.h>
 #include <louischessx/chessboard.h>
-#include <louischessx/game_controller.h>
\ No newline at end of file
+#include <louischessx/game_controller.h>
+#include <louischessx/nnue.h>
+#include <louischessx/opening_book.h>
+#include <louischessx/remote_search.h>
+#include <louischessx/tablebase.h>
+#include <louischessx/time_manager.h>
\ No newline at end of file
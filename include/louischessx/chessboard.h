@@ -20,17 +20,23 @@
 
 /* INCLUDES */
 #include <algorithm>
+#include <atomic>
 #include <stop_token>
 #include <louischessx/bitboard.h>
 #include <louischessx/macros.h>
+#include <louischessx/nnue.h>
 #include <cmath>
+#include <cstdint>
+#include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <future>
 #include <memory>
-#include <unordered_map>
+#include <optional>
 #include <regex>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
@@ -154,6 +160,12 @@ namespace chess
      */
     class move_t;
 
+    /* class packed_move_t
+     *
+     * Stores a move in 16 bits, for search tables
+     */
+    class packed_move_t;
+
 
 
     /* CHESSBOARD CLASS */
@@ -166,6 +178,16 @@ namespace chess
 
 
 
+    /* TIME MANAGER CLASS */
+
+    /* class time_manager
+     *
+     * Decides how long a search should run for. Declared fully in time_manager.h, which includes this header.
+     */
+    class time_manager;
+
+
+
     /* GAME CONTROLLER CLASS */
 
     /* class game_controller
@@ -289,6 +311,116 @@ public:
 
 
 
+/* PACKED MOVE CLASS */
+
+/* class packed_move_t
+ *
+ * Stores a move in 16 bits, for compact storage in killer, countermove, move ordering and transposition tables.
+ * Bits 0-5 are the departure, bits 6-11 the destination, bits 12-13 the promotion type (knight to queen) and bits 14-15 the flags.
+ * The moving and captured pieces are not stored, so chessboard::unpack_move must reconstruct a full move_t from the board it is for.
+ * The empty move is all zeros, which is never a legal move, since its departure and destination are the same.
+ */
+class chess::packed_move_t
+{
+public:
+
+    /* TYPES */
+
+    /* The flags of a move. A fourth value would fit, but is unused. */
+    enum class flag_t : std::uint16_t { normal, promotion, castle };
+
+
+
+    /* CONSTRUCTORS */
+
+    /** @name  default constructor
+     * 
+     * @brief  Constructs the empty move
+     */
+    constexpr packed_move_t () noexcept = default;
+
+    /** @name  full constructor
+     * 
+     * @brief  Construct from the departure, destination, flag and promotion type.
+     * @param  from: The departure.
+     * @param  to: The destination.
+     * @param  flag: The flag. Normal by default.
+     * @param  promote_pt: The promotion type, from knight to queen, which is ignored unless the flag is promotion.
+     */
+    constexpr packed_move_t ( const int from, const int to, const flag_t flag = flag_t::normal, const ptype promote_pt = ptype::knight ) noexcept
+        : data { static_cast<std::uint16_t> ( from | to << 6 | ( flag == flag_t::promotion ? static_cast<int> ( promote_pt ) - static_cast<int> ( ptype::knight ) : 0 ) << 12 | static_cast<int> ( flag ) << 14 ) }
+    {}
+
+    /** @name  move constructor
+     * 
+     * @brief  Pack a move_t. An empty or null move gives the empty move.
+     */
+    explicit constexpr packed_move_t ( const move_t& move ) noexcept
+        : packed_move_t { move.from < 0 ? packed_move_t {} : packed_move_t { move.from, move.to,
+            ( move.promote_pt != ptype::no_piece ? flag_t::promotion : move.is_kingside_castle () || move.is_queenside_castle () ? flag_t::castle : flag_t::normal ), move.promote_pt } }
+    {}
+
+    /** @name  from_data
+     * 
+     * @brief  Construct from 16 bits given by get_data.
+     * @param  data: The packed move.
+     * @return packed_move_t
+     */
+    chess_const static constexpr packed_move_t from_data ( const std::uint16_t data ) noexcept { packed_move_t move; move.data = data; return move; }
+
+
+
+    /* OPERATORS AND COMPARISON */
+
+    /* Default comparison operator */
+    constexpr bool operator== ( const packed_move_t& other ) const noexcept = default;
+
+    /** @name  operator bool
+     * 
+     * @brief  Returns true unless this is the empty move
+     */
+    explicit constexpr operator bool () const noexcept { return data; }
+
+
+
+    /* ACCESS */
+
+    /** @name  from, to, flag
+     * 
+     * @brief  Get the departure, destination and flag.
+     * @return int, or flag_t
+     */
+    constexpr int from () const noexcept { return data & 0x3f; }
+    constexpr int to   () const noexcept { return ( data >> 6 ) & 0x3f; }
+    constexpr flag_t flag () const noexcept { return static_cast<flag_t> ( data >> 14 ); }
+
+    /** @name  promote_pt
+     * 
+     * @brief  Get the promotion type.
+     * @return One of ptype, which is no_piece unless the flag is promotion.
+     */
+    constexpr ptype promote_pt () const noexcept { return ( flag () == flag_t::promotion ? static_cast<ptype> ( static_cast<int> ( ptype::knight ) + ( ( data >> 12 ) & 0x3 ) ) : ptype::no_piece ); }
+
+    /** @name  get_data
+     * 
+     * @brief  Get the 16 bits of the packed move.
+     * @return std::uint16_t
+     */
+    constexpr std::uint16_t get_data () const noexcept { return data; }
+
+
+
+private:
+
+    /* ATTRIBUTES */
+
+    /* The packed move */
+    std::uint16_t data = 0;
+
+};
+
+
+
 /* CHESSBOARD DEFINITION */
 
 /* class chessboard 
@@ -419,6 +551,39 @@ public:
 
 
 
+    /* EVALUATOR ENUM */
+
+    /* The functions which evaluate may use */
+    enum class evaluator_t
+    {
+        /* evaluate_handcrafted */
+        handcrafted,
+
+        /* evaluate_nnue */
+        nnue
+    };
+
+
+
+    /* EVAL ACCUMULATOR STRUCT */
+
+    /* The evaluation terms which depend only on each individual piece and its cell, and the game phase.
+     * These are maintained incrementally by make_move_internal, so that evaluate need not recompute them.
+     */
+    struct eval_accumulator_t
+    {
+        /* The sum of material and piece-square values, positive for white */
+        int psqt_value = 0;
+
+        /* The game phase, as the number of pieces (including pawns and kings), and the number of restrictives (pieces other than pawns and kings) of each color */
+        std::array<signed char, 2> num_pieces {}, num_restrictives {};
+
+        /* Default comparison operator */
+        bool operator== ( const eval_accumulator_t& other ) const noexcept = default;
+    };
+
+
+
     /* GAME STATE */
 
     /* A structure to store a state of the game */
@@ -439,8 +604,12 @@ public:
          * @brief  Construct from a chessboard state
          * @param  cb: The chessboard to construct from
          * @param  _last_pc: The player who last moved (in order to give this state)
+         * @param  _key: The Zobrist key of the state. If not given, it will be computed from scratch.
+         * @param  _pawn_key: The pawn-only Zobrist key of the state. If not given, it will be computed from scratch.
+         * @param  _accumulator: The eval accumulator of the state. If not given, it will be computed from scratch.
          */
         game_state_t ( const chessboard& cb, pcolor _last_pc ) chess_validate_throw;
+        game_state_t ( const chessboard& cb, pcolor _last_pc, std::uint64_t _key, std::uint64_t _pawn_key, const eval_accumulator_t& _accumulator ) chess_validate_throw;
 
 
         
@@ -493,6 +662,23 @@ public:
         /* the auxiliary info */
         aux_info_t aux_info;
 
+        /* The Zobrist key of the state */
+        std::uint64_t key = 0;
+
+        /* The Zobrist key of only the pawns of the state, for the pawn hash table */
+        std::uint64_t pawn_key = 0;
+
+        /* The eval accumulator of the state */
+        eval_accumulator_t accumulator;
+
+        /* The number of plies since the last capture or pawn move, for the fifty-move rule */
+        int halfmove_clock = 0;
+
+        /* The number of plies since the last capture, pawn move or null move.
+         * No earlier state can be repeated by this one (or, for a null move, would be a real repetition), so this bounds the search for repetitions.
+         */
+        int reversible_plies = 0;
+
     };
 
 
@@ -530,16 +716,319 @@ public:
         /* Whether the ttable entry is exact or an upper or lower bound */
         enum class bound_t : char { exact, upper, lower } bound;
 
-        /* The departure and destination of the best move in this state */
-        char best_move_from, best_move_to;
+        /* The best move in this state, or the empty move if there is none */
+        packed_move_t best_move;
     };
 
 
 
-    /* TTABLE TYPEDEF */
+    /* TTABLE CLASS */
+
+    /* class ab_ttable_t
+     *
+     * A fixed-size, open-addressed transposition table, safe for concurrent lockless reads and writes.
+     * Copying an ab_ttable_t copies a handle to the same table, so parallel searches can share a single table.
+     * The table is split into a power-of-two number of cache-line-sized buckets, each containing BUCKET_SLOTS slots.
+     * Each slot stores a packed entry, and the 64-bit key of the entry XORed with the packed entry.
+     * A torn write between two threads will therefore fail the key check, and is simply treated as a miss.
+     * The buckets can be saved to a file, and later memory-mapped back in, so that the table can persist between processes.
+     */
+    class ab_ttable_t
+    {
+    public:
+
+        /* CONSTEXPRS */
+
+        /* The default size of a table in MB */
+        static inline constexpr std::size_t DEFAULT_SIZE_MB = 64;
+
+        /* The number of slots in each bucket */
+        static inline constexpr int BUCKET_SLOTS = 4;
+
+        /* The version of the file format used by save. Must be changed whenever the layout of a bucket or the entry packing changes. */
+        static inline constexpr std::uint32_t FILE_FORMAT_VERSION = 2;
+
+
+
+        /* CONSTRUCTORS */
+
+        /** @name  default constructor
+         * 
+         * @brief  Constructs an empty handle, with no table allocated.
+         */
+        ab_ttable_t () noexcept = default;
+
+        /** @name  size constructor
+         * 
+         * @brief  Allocates a new, empty table.
+         * @param  size_mb: The maximum size of the table in MB. The actual size will be the largest power-of-two number of buckets that fits.
+         */
+        explicit ab_ttable_t ( std::size_t size_mb );
+
+        /** @name  file constructor
+         * 
+         * @brief  Memory-maps a table previously written by save.
+         *         The mapping is private, so searches using the table never modify the file.
+         * @param  path: The path of the file to map.
+         * @throws chess_input_error if the file cannot be mapped, or was saved with a different format version or set of Zobrist keys.
+         */
+        explicit ab_ttable_t ( const std::string& path );
+
+
+
+        /* OPERATORS */
+
+        /** @name  operator bool
+         * 
+         * @brief  Returns true if a table has been allocated.
+         */
+        explicit operator bool () const noexcept { return static_cast<bool> ( table ); }
 
-    /* The transposition table type */
-    typedef std::unordered_map<game_state_t, ab_ttable_entry_t, hash> ab_ttable_t;
+
+
+        /* TABLE MANAGEMENT */
+
+        /** @name  size, size_mb
+         * 
+         * @brief  Get the number of slots in the table, or the size of the table in MB.
+         * @return std::size_t
+         */
+        std::size_t size    () const noexcept { return table ? table->num_buckets * BUCKET_SLOTS : 0; }
+        std::size_t size_mb () const noexcept { return table ? table->num_buckets * sizeof ( bucket_t ) >> 20 : 0; }
+
+        /** @name  resize
+         * 
+         * @brief  Allocate a new, empty table for this handle. Other handles to the old table are unaffected.
+         * @param  size_mb: The maximum size of the table in MB.
+         * @return void
+         */
+        void resize ( std::size_t size_mb ) { * this = ab_ttable_t { size_mb }; }
+
+        /** @name  clear
+         * 
+         * @brief  Empty the table, without reallocating it. Should not be called while a search is using the table.
+         * @return void
+         */
+        void clear () noexcept;
+
+        /** @name  new_generation
+         * 
+         * @brief  Age all of the entries currently in the table, so that they are favoured for replacement by entries from later searches.
+         * @param  min_bk_depth: Aged entries with a bk_depth less than this are considered empty for the purposes of replacement.
+         * @return void
+         */
+        void new_generation ( int min_bk_depth = 0 ) noexcept;
+
+        /** @name  save
+         * 
+         * @brief  Write the table to a file, which can later be loaded with the file constructor. Should not be called while a search is using the table.
+         *         The file is written to a temporary path and then renamed, so a file currently mapped by any table is never truncated.
+         * @param  path: The path of the file to write.
+         * @throws chess_input_error if there is no table or the file cannot be written.
+         * @return void
+         */
+        void save ( const std::string& path ) const;
+
+
+
+        /* ACCESS */
+
+        /** @name  probe
+         * 
+         * @brief  Look for an entry in the table.
+         * @param  key: The 64-bit key of the state.
+         * @return An entry if found, std::nullopt otherwise.
+         */
+        std::optional<ab_ttable_entry_t> probe ( std::uint64_t key ) const noexcept;
+
+        /** @name  store
+         * 
+         * @brief  Store an entry in the table.
+         *         An entry with the same key is always replaced.
+         *         Otherwise the slot in the bucket with the least bk_depth, after penalizing entries from previous generations, is replaced.
+         * @param  key: The 64-bit key of the state.
+         * @param  entry: The entry to store.
+         * @return True if an entry for another state was replaced.
+         */
+        bool store ( std::uint64_t key, const ab_ttable_entry_t& entry ) noexcept;
+
+
+
+    private:
+
+        /* CONSTEXPRS */
+
+        /* The bk_depth penalty per generation of age when choosing a slot to replace */
+        static inline constexpr int AGE_REPLACEMENT_PENALTY = 4;
+
+        /* A bit which is set in the packed data of every valid entry */
+        static inline constexpr std::uint64_t VALID_BIT = 1ull << 63;
+
+        /* The magic string at the start of a saved table */
+        static inline constexpr char FILE_MAGIC [ 8 ] = { 'L', 'C', 'X', 'T', 'T', 'A', 'B', 'L' };
+
+
+
+        /* TYPES */
+
+        /* A single slot in a bucket */
+        struct slot_t
+        {
+            /* The key XORed with the data, and the packed data */
+            std::atomic<std::uint64_t> check, data;
+        };
+
+        /* A bucket of slots, the size of a cache line */
+        struct alignas ( 64 ) bucket_t
+        {
+            /* The slots */
+            std::array<slot_t, BUCKET_SLOTS> slots;
+        };
+
+        /* The header of a saved table, which is followed directly by the buckets.
+         * The header is the size of a bucket, so that the buckets of a mapped file remain aligned.
+         */
+        struct alignas ( 64 ) file_header_t
+        {
+            /* The magic string and format version */
+            char magic [ 8 ]; std::uint32_t version;
+
+            /* The generation and minimum bk_depth to keep an aged entry */
+            std::uint32_t generation; std::int32_t min_keep_bk_depth;
+
+            /* A fingerprint of the Zobrist keys, since keys from a different set would be meaningless */
+            std::uint64_t zobrist_fingerprint;
+
+            /* The number of buckets which follow */
+            std::uint64_t num_buckets;
+        };
+
+        /* The shared table */
+        struct table_t
+        {
+            /** @name  destructor
+             * 
+             * @brief  Frees or unmaps the buckets.
+             */
+            ~table_t ();
+
+            /* The buckets, and the number of them (always a power of two) */
+            bucket_t * buckets = nullptr; std::size_t num_buckets = 0;
+
+            /* If the buckets are memory-mapped from a file, the start and size of the mapping. Otherwise the buckets are heap-allocated. */
+            void * mapping = nullptr; std::size_t mapping_size = 0;
+
+            /* The current generation */
+            std::atomic<unsigned> generation = 0;
+
+            /* The minimum bk_depth for which an aged entry will not be considered empty */
+            std::atomic_int min_keep_bk_depth = 0;
+        };
+
+
+
+        /* ATTRIBUTES */
+
+        /* The table */
+        std::shared_ptr<table_t> table;
+
+
+
+        /* PACKING */
+
+        /** @name  pack
+         * 
+         * @brief  Pack an entry and generation into 64 bits.
+         * @param  entry: The entry to pack.
+         * @param  generation: The generation to store.
+         * @return The packed data.
+         */
+        chess_const static constexpr std::uint64_t pack ( const ab_ttable_entry_t& entry, unsigned generation ) noexcept;
+
+        /** @name  unpack_entry, unpack_generation
+         * 
+         * @brief  Extract an entry or generation from packed data.
+         * @param  data: The packed data.
+         * @return ab_ttable_entry_t or generation.
+         */
+        chess_const static constexpr ab_ttable_entry_t unpack_entry ( std::uint64_t data ) noexcept;
+        chess_const static constexpr unsigned unpack_generation ( std::uint64_t data ) noexcept { return ( data >> 48 ) & 0xff; }
+
+
+
+        /* FILES */
+
+        /** @name  zobrist_fingerprint
+         * 
+         * @brief  Get a fingerprint of the Zobrist keys, to check that a saved table was made using the same keys.
+         * @return The fingerprint.
+         */
+        chess_const static constexpr std::uint64_t zobrist_fingerprint () noexcept 
+            { return zobrist_keys.pieces.front ().front ().front () ^ zobrist_keys.pieces.back ().back ().back () ^ zobrist_keys.castling_rights.back () ^ zobrist_keys.white_last_pc; }
+    };
+
+
+
+    /* SEARCH STATISTICS STRUCT */
+
+    /* Detailed statistics of searches, which are only gathered if CHESS_STATS is true (see macros.h) */
+    struct search_stats_t
+    {
+        /* The number of buckets for the index of the move causing a beta cutoff. The last bucket includes every later move. */
+        static inline constexpr int NUM_CUTOFF_BUCKETS = 8;
+
+        /* struct scoped_timer_t
+         *
+         * Adds the time between its construction and destruction to a duration
+         */
+        struct scoped_timer_t
+        {
+            /* The duration to add to, and the time of construction */
+            chess_clock::duration& total;
+            const chess_clock::time_point start = chess_clock::now ();
+
+            /* Add to the duration on destruction */
+            ~scoped_timer_t () { total += chess_clock::now () - start; }
+        };
+
+        /* The number of beta cutoffs, bucketed by the index of the move which caused it (the first being the ttable best move, if any) */
+        std::array<unsigned long long, NUM_CUTOFF_BUCKETS> beta_cutoffs {};
+
+        /* The number of null moves tried, and those which caused a cutoff */
+        unsigned long long null_move_tries = 0, null_move_cutoffs = 0;
+
+        /* The number of quiescence nodes not in check, those cut off by lazy evaluation, and those returned by delta pruning */
+        unsigned long long delta_pruning_tries = 0, lazy_eval_cutoffs = 0, delta_prunes = 0;
+
+        /* The number of ttable probes, hits, and hits whose best move was illegal (so must have been from another state sharing the key) */
+        unsigned long long ttable_probes = 0, ttable_hits = 0, ttable_collisions = 0;
+
+        /* The number of ttable stores, and those which replaced an entry for another state */
+        unsigned long long ttable_stores = 0, ttable_replacements = 0;
+
+        /* The number of static exchange evaluations */
+        unsigned long long see_calls = 0;
+
+        /* The number of static evaluations and move set collations, and the time taken by each */
+        unsigned long long eval_calls = 0, movegen_calls = 0;
+        chess_clock::duration eval_time {}, movegen_time {};
+
+        /** @name  operator+=
+         * 
+         * @brief  Accumulate the statistics of another search.
+         * @param  other: The statistics to add.
+         * @return A reference to this object.
+         */
+        search_stats_t& operator+= ( const search_stats_t& other ) noexcept;
+
+        /** @name  format, format_json
+         * 
+         * @brief  Format the statistics, either as human-readable lines each beginning with '#' (so they are xboard comments), or as a single-line JSON object.
+         * @return string
+         */
+        std::string format () const;
+        std::string format_json () const;
+    };
 
 
 
@@ -555,7 +1044,10 @@ public:
         int depth = 0; 
         
         /* Number of nodes visited */
-        int num_nodes = 0, num_q_nodes = 0;
+        unsigned long long num_nodes = 0, num_q_nodes = 0;
+
+        /* The number of nodes (including quiescence nodes) of every search. For iterative deepening, this includes every depth, even those repeated after failing low or high and an incomplete last depth. */
+        unsigned long long total_nodes = 0;
 
         /* Average quiescence depth and moves per node */
         double av_q_depth = 0.0, av_moves = 0.0, av_q_moves = 0.0;
@@ -563,19 +1055,25 @@ public:
         /* Maximum quiscence depth */
         int max_q_depth = 0;
 
-        /* The number of ttable hits */
-        int ttable_hits = 0;
+        /* The number of ttable hits and tablebase hits */
+        unsigned long long ttable_hits = 0, tablebase_hits = 0;
 
         /* Boolean flags for if the search was incomplete, failed low or failed high */
         bool incomplete = false, failed_low = false, failed_high = false;
 
+        /* Whether the root moves were valued from the tablebases, so are exact without searching deeper */
+        bool tablebase = false;
+
         /* The time taken for the search */
         chess_clock::duration duration;
 
-        /* The transposition table from the search */
-        ab_ttable_t ttable;
+        /* Detailed statistics, if CHESS_STATS is true. For iterative deepening, these are accumulated over every depth. */
+        search_stats_t stats;
     };
 
+    /* The type of a function which is given thinking info during a search. See alpha_beta_iterative_deepening. */
+    typedef std::function<void ( const ab_result_t& )> ab_thinking_callback_t;
+
 
 
     /* BITBOARD ACCESS */
@@ -639,6 +1137,53 @@ public:
      */
     chess_pure game_state_t get_game_state ( pcolor last_pc ) const noexcept { return game_state_t { * this, last_pc }; };
 
+    /** @name  zobrist_hash
+     * 
+     * @brief  Compute the Zobrist key for the current board from scratch.
+     *         The key of the most recent state is maintained incrementally in game_state_history, so this should only be needed for new states.
+     * @param  last_pc: The player who last moved (to lead to this state)
+     * @return The 64-bit key
+     */
+    chess_pure std::uint64_t zobrist_hash ( pcolor last_pc ) const noexcept;
+
+    /** @name  zobrist_pawn_hash
+     * 
+     * @brief  Compute the pawn-only Zobrist key for the current board from scratch.
+     *         Like the full key, this is maintained incrementally in game_state_history.
+     * @return The 64-bit key
+     */
+    chess_pure std::uint64_t zobrist_pawn_hash () const noexcept;
+
+    /** @name  compute_eval_accumulator
+     * 
+     * @brief  Compute the eval accumulator for the current board from scratch.
+     *         Like the Zobrist keys, this is maintained incrementally in game_state_history.
+     * @return eval_accumulator_t
+     */
+    chess_pure eval_accumulator_t compute_eval_accumulator () const noexcept;
+
+    /** @name  get_eval_accumulator
+     * 
+     * @brief  Get the eval accumulator of the current board.
+     * @return eval_accumulator_t
+     */
+    chess_pure const eval_accumulator_t& get_eval_accumulator () const noexcept { return game_state_history.back ().accumulator; }
+
+    /** @name  get_halfmove_clock
+     * 
+     * @brief  Get the number of plies since the last capture or pawn move, for the fifty-move rule.
+     * @return int
+     */
+    chess_pure int get_halfmove_clock () const noexcept { return game_state_history.back ().halfmove_clock; }
+
+    /** @name  compute_nnue_accumulator
+     * 
+     * @brief  Compute the NNUE accumulator for the current board from scratch.
+     *         While the NNUE is the evaluator, this is maintained incrementally by make_move_internal.
+     * @return nnue::accumulator_t
+     */
+    chess_pure nnue::accumulator_t compute_nnue_accumulator () const noexcept;
+
 
 
     /* BOARD EVALUATION */
@@ -682,10 +1227,22 @@ public:
 
     /** @name  is_draw_state
      * 
-     * @brief  Returns true if this state is a draw state by repetition.
+     * @brief  Returns true if this state is a draw by the fifty-move rule or by repetition.
+     *         The fifty-move rule does not apply if the player to move is in check, since they may be checkmated, which takes precedence.
+     *         Repetitions are found by comparing the Zobrist keys of every other state, back to the last capture, pawn move or null move.
+     *         A state repeated three times is a draw. So is a state repeated once within the most recent search_plies states, since those are part of a search tree, and the repetition could be continued.
+     * @param  search_plies: The number of the most recent states which are part of a search tree, 0 by default.
+     * @return boolean
+     */
+    chess_pure bool is_draw_state ( int search_plies = 0 ) const chess_validate_throw;
+
+    /** @name  is_fifty_move_draw
+     * 
+     * @brief  Returns true if this state is a draw by the fifty-move rule.
+     *         Unlike is_draw_state, a player to move who is in check must have a legal move, since checkmate takes precedence over the rule.
      * @return boolean
      */
-    chess_pure bool is_draw_state () const noexcept { return game_state_history.size () >= 9 && game_state_history.back () == game_state_history.at ( game_state_history.size () - 5 ) && game_state_history.back () == game_state_history.at ( game_state_history.size () - 9 ); }
+    chess_pure bool is_fifty_move_draw () chess_validate_throw { const pcolor pc = other_color ( game_state_history.back ().last_pc ); return game_state_history.back ().halfmove_clock >= 100 && ( !is_in_check ( pc ) || has_mobility ( pc, get_check_info ( pc ) ) ); }
 
     /** @name  get_least_valuable_attacker
      * 
@@ -711,11 +1268,37 @@ public:
 
     /** @name  evaluate
      * 
-     * @brief  Symmetrically evaluate the board state. Note that chess_pure is allowed, as no lasting change is made to the object.
+     * @brief  Evaluate the board state using the current evaluator. Note that chess_pure is allowed, as no lasting change is made to the object.
      * @param  pc: The color whose move it is next
      * @return Integer value, positive for pc, negative for not pc
      */
-    chess_pure chess_hot int evaluate ( pcolor pc );
+    chess_pure int evaluate ( pcolor pc );
+
+    /** @name  evaluate_handcrafted
+     * 
+     * @brief  Symmetrically evaluate the board state using handcrafted terms. Note that chess_pure is allowed, as no lasting change is made to the object.
+     * @param  pc: The color whose move it is next
+     * @return Integer value, positive for pc, negative for not pc
+     */
+    chess_pure chess_hot int evaluate_handcrafted ( pcolor pc );
+
+    /** @name  evaluate_nnue
+     * 
+     * @brief  Evaluate the board state using the loaded NNUE. Note that chess_pure is allowed, as no lasting change is made to the object.
+     * @param  pc: The color whose move it is next
+     * @return Integer value, positive for pc, negative for not pc
+     */
+    chess_pure int evaluate_nnue ( pcolor pc );
+
+    /** @name  set_evaluator, get_evaluator
+     * 
+     * @brief  Set or get the evaluator used by evaluate, and therefore by every search, process-wide.
+     *         Should not be called while a search is running.
+     * @param  _evaluator: The new evaluator.
+     * @throws chess_input_error if the NNUE is chosen but no network is loaded.
+     */
+    static void set_evaluator ( evaluator_t _evaluator );
+    static evaluator_t get_evaluator () noexcept { return evaluator; }
 
 
 
@@ -766,6 +1349,28 @@ public:
      */
     chess_pure bool has_mobility ( pcolor pc, const check_info_t& check_info );
 
+    /** @name  perft
+     * 
+     * @brief  Count the leaf nodes of the tree of legal moves to a given depth (a performance test of move generation).
+     *         The board is left unmodified on return.
+     * @param  pc: The color whose move it is next.
+     * @param  depth: The depth of the tree to count.
+     * @param  bulk_count: If true, the leaf nodes are counted from the move sets at depth 1, rather than by making each move. False by default.
+     * @return The number of leaf nodes.
+     */
+    unsigned long long perft ( pcolor pc, int depth, bool bulk_count = false ) { return perft_internal ( pc, depth, bulk_count, nullptr ); }
+
+    /** @name  perft_divide
+     * 
+     * @brief  Same as perft, but the leaf nodes are counted separately for each root move.
+     * @param  pc: The color whose move it is next.
+     * @param  depth: The depth of the tree to count.
+     * @param  bulk_count: If true, the leaf nodes are counted from the move sets at depth 1, rather than by making each move. False by default.
+     * @return A vector of pairs of root moves and their number of leaf nodes.
+     */
+    std::vector<std::pair<move_t, unsigned long long>> perft_divide ( pcolor pc, int depth, bool bulk_count = false )
+        { std::vector<std::pair<move_t, unsigned long long>> divide; perft_internal ( pc, depth, bulk_count, &divide ); return divide; }
+
     /** @name  get_pawn_move_set
      * 
      * @brief  Gets the move set for a pawn
@@ -810,14 +1415,18 @@ public:
 
     /* SEARCH */
 
+    /* The maximum depth of a search, since nodes deeper than this in the search tables are not searched further */
+    static inline constexpr int MAX_SEARCH_DEPTH = 63;
+
     /** @name  purge_ttable
      * 
-     * @brief  Take a transposition table, and remove entries which are no longer reachable from the current board state.
-     * @param  ttable: The transposition table to erase elements from.
-     * @param  min_bk_depth: The minimum bk_depth for which an entry is allowed to stay.
-     * @return A new ttable with unreachable positions erased.
+     * @brief  Age the entries of a transposition table from previous searches in place, so that they are favoured for replacement.
+     *         This only starts a new generation, so is cheap, and is safe while other searches are using the table.
+     * @param  ttable: The transposition table to age.
+     * @param  min_bk_depth: The minimum bk_depth for which an aged entry is not considered empty.
+     * @return void
      */
-    ab_ttable_t purge_ttable ( ab_ttable_t ttable, int min_bk_depth = 0 ) const;
+    void purge_ttable ( ab_ttable_t& ttable, int min_bk_depth = 0 ) const;
 
     /** @name  alpha_beta_search
      * 
@@ -826,14 +1435,18 @@ public:
      * @param  pc: The color whose move it is next.
      * @param  depth: The number of moves that should be made by individual colors. Returns evaluate () at depth = 0.
      * @param  best_only: If true, the search will be optimised as only the best move is returned.
-     * @param  ttable: The transposition table to use for the search. Empty by default.
+     * @param  ttable: The transposition table to use for the search, which is shared with any other searches using it. If empty, a table of the default size is allocated into it.
      * @param  end_flag: A stop token which will end the search. Can be unspecified.
      * @param  end_point: A time point at which the search will be automatically stopped. Never by default.
      * @param  alpha: The maximum value pc has discovered, defaults to an abitrarily large negative integer.
      * @param  beta:  The minimum value not pc has discovered, defaults to an abitrarily large positive integer.
+     * @param  thinking: A function called whenever the best root move changes during the search, with a partial result (see alpha_beta_iterative_deepening). Not called by default.
+     * @param  max_nodes: The number of nodes (including quiescence nodes) after which the search will be automatically stopped. Unlimited by default.
+     * @param  search_moves: If not empty, only these root moves are searched, so that the root moves can be shared between several searches. Empty by default.
      * @return ab_result_t
      */
-    ab_result_t alpha_beta_search ( pcolor pc, int depth, bool best_only, ab_ttable_t ttable = ab_ttable_t {}, const std::stop_token& end_flag = std::stop_token {}, chess_clock::time_point end_point = chess_clock::time_point::max (), int alpha = -20000, int beta = +20000 );
+    ab_result_t alpha_beta_search ( pcolor pc, int depth, bool best_only, ab_ttable_t& ttable, const std::stop_token& end_flag = std::stop_token {}, chess_clock::time_point end_point = chess_clock::time_point::max (), int alpha = -20000, int beta = +20000,
+        const ab_thinking_callback_t& thinking = {}, unsigned long long max_nodes = std::numeric_limits<unsigned long long>::max (), const std::vector<move_t>& search_moves = {} );
 
     /** @name  alpha_beta_iterative_deepening
      * 
@@ -843,15 +1456,52 @@ public:
      * @param  pc: The color whose move it is next.
      * @param  depths: A list of depth values to search.
      * @param  best_only: If true, the search will be optimised as only the best move is returned.
-     * @param  ttable: The transposition table to use for the search. Empty by default.
+     * @param  ttable: The transposition table to use for the search, which is shared with any other searches using it. If empty, a table of the default size is allocated into it.
      * @param  end_flag: A stop token which will end the search. Can be unspecified.
      * @param  end_point: A time point at which the search will be automatically stopped. Never by default.
-     * @param  cecp_thinking: An atomic boolean, which when set to true will cause information on the search to be printed after each iteration. False by default.
+     * @param  thinking: A function called with the result of each completed depth. It is also called whenever the best root move changes during a depth,
+     *         with a partial result which is marked incomplete and contains only the new best move. Called on the searching thread. Not called by default.
      * @param  finish_first: If true, always wait for the lowest depth search to finish, regardless of end_point or end_flag. True by default.
+     * @param  num_threads: The number of threads to search with. Helper threads search copies of the board, sharing only the ttable (Lazy SMP). 1 by default.
+     * @param  max_nodes: The number of nodes over every depth after which the search will be automatically stopped, like end_point. Since it is independent of the speed of the machine,
+     *         a single-threaded search with a node budget (and a cleared ttable) is reproducible. Helper threads are not counted. Unlimited by default.
+     * @param  time_control: A time manager which is told the result of each depth, and whose soft end point (if earlier than end_point) decides whether to start the next depth.
+     *         end_point should then be its hard end point. None by default.
+     * @param  search_moves: If not empty, only these root moves are searched (see alpha_beta_search). Helper threads search every root move. Empty by default.
      * @return ab_result_t
      */
-    ab_result_t alpha_beta_iterative_deepening ( pcolor pc, const std::vector<int>& depths, bool best_only, ab_ttable_t ttable = ab_ttable_t {}, const std::stop_token& end_flag = std::stop_token {},
-        chess_clock::time_point end_point = chess_clock::time_point::max (), const std::atomic_bool& cecp_thinking = false, bool finish_first = true );
+    ab_result_t alpha_beta_iterative_deepening ( pcolor pc, const std::vector<int>& depths, bool best_only, ab_ttable_t& ttable, const std::stop_token& end_flag = std::stop_token {},
+        chess_clock::time_point end_point = chess_clock::time_point::max (), const ab_thinking_callback_t& thinking = {}, bool finish_first = true, int num_threads = 1,
+        unsigned long long max_nodes = std::numeric_limits<unsigned long long>::max (), time_manager * time_control = nullptr, const std::vector<move_t>& search_moves = {} );
+
+    /** @name  alpha_beta_helper
+     * 
+     * @brief  Run a Lazy SMP helper search, which contributes to any other search of the same position using the same ttable.
+     *         Since helpers share only the ttable, a helper may join a search of the position at any time, even mid-iteration.
+     *         Every other helper searches one ply deeper, so that the helpers are not all searching the same nodes in lockstep.
+     * @throw  If throws, the chessboard is left in an undefined state. Otherwise the state will be unmodified on return.
+     * @param  pc: The color whose move it is next.
+     * @param  depths: The list of depth values of the search being helped.
+     * @param  best_only: Whether the search being helped is optimised to only return the best move.
+     * @param  ttable: The transposition table of the search being helped.
+     * @param  end_flag: A stop token which will end the helper, which should be stopped when the search being helped ends.
+     * @param  end_point: A time point at which the helper will be automatically stopped. Never by default.
+     * @param  helper_index: The index of this helper, starting at 1.
+     * @return void
+     */
+    void alpha_beta_helper ( pcolor pc, std::vector<int> depths, bool best_only, ab_ttable_t& ttable, const std::stop_token& end_flag, chess_clock::time_point end_point, int helper_index );
+
+    /** @name  get_pv
+     * 
+     * @brief  Get the principal variation following a move, by following the best moves stored in a ttable.
+     *         The variation ends at a position with no legal best move stored, or once a position repeats.
+     * @param  pc: The color whose move it is next.
+     * @param  first_move: The first move of the variation.
+     * @param  ttable: The ttable to follow. May be empty, in which case the variation is only first_move.
+     * @param  max_length: The maximum number of moves in the variation. 16 by default.
+     * @return The moves of the variation, starting with first_move.
+     */
+    std::vector<move_t> get_pv ( pcolor pc, const move_t& first_move, const ab_ttable_t& ttable, int max_length = 16 ) const;
 
 
 
@@ -880,6 +1530,16 @@ public:
     chess_pure ptype find_type ( pcolor pc, int pos ) const chess_validate_throw;
     chess_pure ptype find_type ( pcolor pc, int rank, int file ) const chess_validate_throw { return find_type ( pc, rank * 8 + file ); }
 
+    /** @name  unpack_move
+     * 
+     * @brief  Reconstruct a full move from a packed move, using the pieces on the board. The move is not checked for legality.
+     *         A pawn move to the last rank without a promotion type is taken to promote to a queen.
+     * @param  pc: The color whose move it is.
+     * @param  move: The packed move.
+     * @return The move, or an empty move if the packed move is empty or there is no piece of pc at its departure.
+     */
+    chess_pure move_t unpack_move ( pcolor pc, packed_move_t move ) const chess_validate_throw;
+
 
 
     /* FORMATTING */
@@ -940,9 +1600,86 @@ private:
 
     /* TYPES */
 
-    /* A structure containing temporary alpha-beta search data */
+    /* A structure for a pawn hash table entry.
+     * This stores the evaluation terms and bitboards which depend only on the positions of the pawns.
+     * Note that a zeroed entry is correct for the key 0 (a board with no pawns), so the table needs no 'empty' marker.
+     */
+    struct pawn_hash_entry_t
+    {
+        /* The pawn-only Zobrist key of the pawn structure */
+        std::uint64_t key = 0;
+
+        /* The file fills, passed pawns and general attacks of each color's pawns */
+        bitboard white_file_fill, black_file_fill;
+        bitboard white_passed_pawns, black_passed_pawns;
+        bitboard white_attacks, black_attacks;
+
+        /* The value of the pawn-only evaluation terms, positive for white */
+        int value = 0;
+    };
+
+    /* The type of a piece-square table, indexed by color, piece type and cell */
+    typedef std::array<std::array<std::array<int, 64>, 6>, 2> psqt_t;
+
+    /* A structure containing a pawn hash table.
+     * Each chessboard owns its own table, so parallel searches (which search copies of the board) never share one.
+     */
+    struct pawn_hash_table_t
+    {
+        /* The number of entries in the table. Must be a power of 2. */
+        static inline constexpr std::size_t NUM_ENTRIES = 1 << 13;
+
+        /* The entries of the table, indexed by the low bits of the pawn key */
+        std::array<pawn_hash_entry_t, NUM_ENTRIES> entries {};
+    };
+
+    /* A structure containing a fixed-capacity list of move sets for a single ply.
+     * The move sets are stored contiguously, ordered by piece type, with a range for each piece type.
+     * They are generated lazily, a piece type at a time, so the ranges are only valid for the piece types generated so far.
+     */
+    struct ab_move_sets_t
+    {
+        /* The maximum number of pieces a color can have, so the maximum number of move sets */
+        static inline constexpr int MAX_MOVE_SETS = 16;
+
+        /* The array of piece positions and their move sets */
+        std::array<std::pair<int, bitboard>, MAX_MOVE_SETS> move_sets;
+
+        /* The start of the range of move sets for each piece type, where the final element is one past the end of the king's range */
+        std::array<unsigned char, 7> ranges {};
+
+        /** @name  clear
+         * 
+         * @brief  Empty all ranges
+         * @return void
+         */
+        void clear () noexcept { ranges.fill ( 0 ); }
+    };
+
+    /* A structure containing a fixed-capacity list of the remaining moves for a single ply, scored so that they can be ordered.
+     * The scores and moves are stored in separate arrays, so that the scores are contiguous while they are compared.
+     */
+    struct ab_scored_moves_t
+    {
+        /* The maximum number of moves from any position */
+        static inline constexpr int MAX_MOVES = 256;
+
+        /* The ordering scores, where higher scores are searched first, and the moves */
+        std::array<int, MAX_MOVES> scores;
+        std::array<packed_move_t, MAX_MOVES> moves;
+
+        /* The number of moves stored */
+        int num_moves = 0;
+    };
+
+    /* A structure containing alpha-beta search data.
+     * It is kept between searches using the same board, so that it is only allocated once and the move ordering tables stay warm.
+     */
     struct ab_working_t
     {
+        /* The maximum fd_depth of any node, including quiescence. Nodes at fd_depth MAX_FD_DEPTH - 1 will not search further. */
+        static inline constexpr int MAX_FD_DEPTH = MAX_SEARCH_DEPTH + 1;
+
 		/* Whether the search is only looking for the best move, or a ranking */
 		bool best_only;
 
@@ -952,32 +1689,80 @@ private:
 		/* The end point */
 		chess_clock::time_point end_point = chess_clock::time_point::max ();
 
+        /* The node budget, after which the search is stopped */
+        unsigned long long max_nodes = std::numeric_limits<unsigned long long>::max ();
+
+        /* The function to give thinking info to when the best root move changes, or null if there is none */
+        const ab_thinking_callback_t * thinking = nullptr;
+
+        /* The time point at which the search started */
+        chess_clock::time_point start_point;
+
         /* Accumulate the sum of quiescence depth and moves made */
         unsigned long long sum_q_depth = 0, sum_moves = 0, sum_q_moves = 0;
 
         /* Accumulate the number of full nodes and quiescence nodes visited */
-        int num_nodes = 0, num_q_nodes = 0;
+        unsigned long long num_nodes = 0, num_q_nodes = 0;
 
         /* The maximum fowards depth reached */
         int max_q_depth = 0;
 
-        /* The largest fd_depth for which a draw state could occur */
-        int draw_max_fd_depth = 0;
+        /* Accumulate the number of ttable hits and tablebase hits */
+        unsigned long long ttable_hits = 0, tablebase_hits = 0;
 
-        /* Accumulate the number of ttable hits */
-        int ttable_hits = 0;
+        /* Accumulate detailed statistics, if CHESS_STATS is true */
+        search_stats_t stats;
 
-        /* Array of sets of moves */
-        std::vector<std::array<std::vector<std::pair<int, bitboard>>, 6>> move_sets;
+        /* The move sets for each fd_depth */
+        std::array<ab_move_sets_t, MAX_FD_DEPTH> move_sets;
 
         /* An array of root moves and their values */
         std::vector<std::pair<move_t, int>> root_moves;
 
+        /* The root moves to search, or empty if every root move should be searched */
+        std::vector<move_t> search_moves;
+
         /* An array of the two most recent killer moves for each depth */
-        std::vector<std::array<move_t, 2>> killer_moves;
+        std::array<std::array<packed_move_t, 2>, MAX_FD_DEPTH> killer_moves;
+
+        /* The move made at each fd_depth, which is an empty move for a null move */
+        std::array<move_t, MAX_FD_DEPTH> move_stack;
+
+        /* The remaining moves of each fd_depth, once scored for ordering */
+        std::array<ab_scored_moves_t, MAX_FD_DEPTH> scored_moves;
+
+        /* The butterfly history table, indexed by color, departure and destination.
+         * It accumulates the square of bk_depth each time a quiet move causes a beta cutoff.
+         */
+        std::array<std::array<std::array<int, 64>, 64>, 2> history {};
+
+        /* The countermove table, indexed by color, and then the piece type and destination of the opponent's previous move.
+         * It stores the most recent quiet move to cause a beta cutoff in response to that move.
+         */
+        std::array<std::array<std::array<packed_move_t, 64>, 6>, 2> countermoves;
 
-        /* The transposition table */
-        std::unordered_map<game_state_t, ab_ttable_entry_t, hash> ttable;
+        /* The transposition table, owned by the caller of the search */
+        ab_ttable_t * ttable = nullptr;
+
+        /* The length of the game state history and the key of the root of the previous search, or 0 if there has not been one */
+        std::size_t root_ply = 0; std::uint64_t root_key = 0;
+
+        /** @name  new_search
+         * 
+         * @brief  Reset the counters and results of the previous search, and age the move ordering tables.
+         *         The history table is halved. The killer moves are shifted to the same fd_depths from the new root if it follows from the previous root, and cleared otherwise.
+         * @param  game_state_history: The game state history of the board, whose last state is the new root.
+         * @return void
+         */
+        void new_search ( const std::vector<game_state_t>& game_state_history ) noexcept;
+
+        /** @name  is_search_move
+         * 
+         * @brief  Get whether a root move is one of the root moves to search.
+         * @param  move: The root move.
+         * @return boolean
+         */
+        bool is_search_move ( const move_t& move ) const noexcept;
     };
 
     /* A structure that performs an alpha-beta search */
@@ -1005,6 +1790,11 @@ private:
         */
         static inline constexpr int QUIESCENCE_MAX_Q_DEPTH = 10;
 
+        /* The margin by which the lazy (material and piece-square) evaluation of a quiescence node must exceed beta to cause a cutoff without full evaluation.
+        * The full evaluation differs from the lazy evaluation by less than this in over 99% of positions.
+        */
+        static inline constexpr int LAZY_EVAL_MARGIN = 400;
+
         /* The mimumum fd_depth that a null move may be tried.
         * Should be more than or equal to DRAW_MAX_FD_DEPTH.
         * Should not be too low, as this will increase the likelihood of innaccuracies of affecting the search result.
@@ -1017,6 +1807,33 @@ private:
         */
         static inline constexpr int NULL_MOVE_CHANGE_BK_DEPTH = 2, NULL_MOVE_MIN_LEFTOVER_BK_DEPTH = 1, NULL_MOVE_MAX_LEFTOVER_BK_DEPTH = 5;
 
+        /* The minimum bk_depth at which principal variation search is used.
+        * Moves after the first are searched with a null window, and only re-searched with the full window if they beat alpha.
+        */
+        static inline constexpr int PVS_MIN_BK_DEPTH = 2;
+
+        /* Late move reductions: the change in bk_depth for quiet moves ordered after the captures, killers and castling.
+        * Only nodes with at least LMR_MIN_BK_DEPTH are reduced, and only after LMR_MIN_LATE_MOVES late moves have been searched without reduction.
+        * A reduced move which beats alpha is re-searched at the full depth.
+        */
+        static inline constexpr int LMR_CHANGE_BK_DEPTH = 1, LMR_MIN_BK_DEPTH = 3, LMR_MIN_LATE_MOVES = 3;
+
+        /* Reverse futility pruning: at most REVERSE_FUTILITY_MAX_BK_DEPTH, a node returns beta if its static evaluation
+        * exceeds beta by REVERSE_FUTILITY_MARGIN for each remaining bk_depth.
+        */
+        static inline constexpr int REVERSE_FUTILITY_MAX_BK_DEPTH = 3, REVERSE_FUTILITY_MARGIN = 150;
+
+        /* Frontier futility pruning: at most FUTILITY_MAX_BK_DEPTH, quiet moves which do not give check are skipped if the static evaluation
+        * plus FUTILITY_MARGIN for each remaining bk_depth does not reach alpha.
+        */
+        static inline constexpr int FUTILITY_MAX_BK_DEPTH = 2, FUTILITY_MARGIN = 250;
+
+        /* The maximum value of a history table entry. When exceeded, every entry of that color is halved, so that older cutoffs matter less. */
+        static inline constexpr int HISTORY_MAX = 1 << 20;
+
+        /* The ordering score given to the countermove to the previous move, which is larger than any history score */
+        static inline constexpr int COUNTERMOVE_SCORE = HISTORY_MAX + 1;
+
         /* The number of pieces such that if any player has less than this, the game is considered endgame */
         static inline constexpr int ENDGAME_PIECES = 8;
 
@@ -1025,6 +1842,9 @@ private:
         */
         static inline constexpr int END_CUTOFF_MIN_BK_DEPTH = 4;
 
+        /* The effective branching factor assumed by iterative deepening before two depths have been searched, and the range that measured factors are clamped to */
+        static inline constexpr double DEFAULT_EBF = 3.0, MIN_EBF = 1.5, MAX_EBF = 8.0;
+
 
 
         /* CONSTANTS */
@@ -1071,12 +1891,10 @@ private:
          */
         const bool endgame;
 
-        /* Get whether a draw cycle should be detected. All of:
-         * Must not be trying a null move.
+        /* Get whether a draw by repetition or the fifty-move rule should be detected. All of:
          * Must not be quiescing.
-         * Must have fd_depth <= ab_working->draw_max_fd_depth.
          */
-        const bool check_for_draw_cycle;
+        const bool check_for_draw;
 
         /* Get whether the ttable should be read from. All of:
          * Must not be trying a null move.
@@ -1087,15 +1905,9 @@ private:
 
         /* Get whether the value in the ttable should be used. All of:
          * Has fd_depth >= TTABLE_USE_VALUE_MIN_FD_DEPTH.
-         * Has fd_depth >= ab_working->draw_max_fd_depth.
          */
         const bool use_ttable_value;
 
-        /* Whether the value should be written to the ttable. All of:
-         * Has fd_depth >= ab_working->draw_max_fd_depth.
-         */
-        const bool store_ttable_value;
-
         /* Get whether delta pruning should be used. All of:
         * Must not be the endgame.
         */
@@ -1108,10 +1920,30 @@ private:
          * Must not be in check.
          * Must have an fd_depth of at least NULL_MOVE_MIN_FD_DEPTH.
          * Reducing fd_depth by NULL_MOVE_CHANGE_BK_DEPTH must cause a leftover depth within the specified range.
-         * Must not have fd_depth < ab_working->draw_max_fd_depth.
          */
         const bool use_null_move;
 
+        /* Whether principal variation search should be used. All of:
+         * Must have bk_depth >= PVS_MIN_BK_DEPTH.
+         * Must not be the root node, unless only the best move is required (otherwise every root move needs an exact value).
+         */
+        const bool use_pvs;
+
+        /* Whether late move reductions may be applied. All of:
+         * Must be using principal variation search.
+         * Must have bk_depth >= LMR_MIN_BK_DEPTH.
+         * Must not be in check.
+         */
+        const bool use_lmr;
+
+        /* Whether reverse or frontier futility pruning may be applied. All of:
+         * Must not be the root node.
+         * Must not be quiescing or in check.
+         * Must have bk_depth within the maximum depth for that pruning.
+         * Reverse futility pruning must also not be the endgame, since zugzwang is likely.
+         */
+        const bool use_reverse_futility, use_futility;
+
 
 
         /* NON-CONSTANTS */
@@ -1122,6 +1954,9 @@ private:
         /* Store the best move */
         move_t best_move;
 
+        /* The best move from the ttable, which is kept apart from best_move since it must be removed from its move set however best_move changes */
+        move_t ttable_move;
+
         /* The new alpha and beta */
         int alpha, beta;
 
@@ -1131,6 +1966,20 @@ private:
         /* Whether a best move was found from the ttable */
         bool ttable_best_move;
 
+        /* The number of moves searched so far, and the number of those which were late moves */
+        int num_moves_searched, num_late_moves_searched;
+
+        /* Whether the moves now being searched are quiet moves (after the captures), and whether they are late moves (after the killers and castling) */
+        bool searching_quiet_moves, searching_late_moves;
+
+        /* The static evaluation, if computed for futility pruning, and whether quiet moves are futile */
+        int static_eval;
+        bool quiet_moves_futile;
+
+        /* The number of piece types, in the order of ptype, whose move sets have been generated, and whether any of them have a move */
+        int num_generated_pts;
+        bool pc_can_move;
+
 
 
         /* METHODS */
@@ -1158,11 +2007,20 @@ private:
 
         /** @name  access_move_sets
          *
-         * @brief  Returns a reference to the array of moves for this depth
-         * @param  pt: The piece to get the move array for
-         * @return A reference to that array
+         * @brief  Returns the move sets of a piece type for this depth, generating them first if they have not been
+         * @param  pt: The piece to get the move sets for
+         * @return A span over those move sets
          */
-        chess_inline std::vector<std::pair<int, bitboard>>& access_move_sets ( ptype pt );
+        chess_inline std::span<std::pair<int, bitboard>> access_move_sets ( ptype pt );
+
+        /** @name  generate_move_sets
+         *
+         * @brief  Generate the move sets for this depth of every piece type up to and including pt, in the order of ptype, which have not already been generated.
+         *         Move sets are generated in order so that the range for each piece type is contiguous. The best move from the ttable is removed, since it is tried first.
+         * @param  pt: The last piece type to generate the move sets for
+         * @return void
+         */
+        void generate_move_sets ( ptype pt );
 
         /** @name  access_killer_move
          *
@@ -1170,7 +2028,22 @@ private:
          * @param  index: The index of the killer move (0 or 1)
          * @return The killer move
          */
-        chess_inline move_t& access_killer_move ( int index );
+        chess_inline packed_move_t& access_killer_move ( int index );
+
+        /** @name  evaluate
+         *
+         * @brief  Statically evaluate the board for pc, timing the evaluation if CHESS_STATS is true.
+         * @return int
+         */
+        int evaluate ();
+
+        /** @name  store_ttable
+         *
+         * @brief  Store an entry for the current state in the ttable, counting the store if CHESS_STATS is true.
+         * @param  entry: The entry to store.
+         * @return void
+         */
+        void store_ttable ( const ab_ttable_entry_t& entry );
 
         /** @name  apply_move
          *
@@ -1214,9 +2087,17 @@ private:
     /* The game state history */
     std::vector<game_state_t> game_state_history;
 
-    /* A structure containing temporary alpha-beta search data */
+    /* The NNUE accumulators for the most recent states in the game state history, which is empty unless the NNUE is the evaluator.
+     * If this becomes empty on unmaking a move, the accumulator is recomputed when next needed.
+     */
+    std::vector<nnue::accumulator_t> nnue_history;
+
+    /* A structure containing alpha-beta search data, which is allocated by the first search and kept for later searches */
     mutable std::unique_ptr<ab_working_t> ab_working;
 
+    /* The pawn hash table, used by evaluate */
+    std::unique_ptr<pawn_hash_table_t> pawn_hash_table;
+
 
 
     /* STATIC ATTRIBUTES */
@@ -1224,10 +2105,135 @@ private:
     /* The characters used for pieces based on ptype */
     static constexpr char piece_chars [] = "PNBRQK#.";
 
+    /* The evaluator used by evaluate */
+    static inline std::atomic<evaluator_t> evaluator { evaluator_t::handcrafted };
+
+    /* A structure of Zobrist keys */
+    struct zobrist_keys_t
+    {
+        /* Keys for each color, type and position of piece */
+        std::array<std::array<std::array<std::uint64_t, 64>, 6>, 2> pieces;
+
+        /* Keys for each value of the castling rights */
+        std::array<std::uint64_t, 256> castling_rights;
+
+        /* Keys for each en passant target position, used only if there is an en passant color */
+        std::array<std::uint64_t, 64> en_passant_target;
+
+        /* The key for white having moved last. This is equivalent to black being to move. */
+        std::uint64_t white_last_pc;
+    };
+
+    /* The Zobrist keys, generated at compile time by a splitmix64 sequence */
+    static constexpr zobrist_keys_t zobrist_keys = [] () constexpr
+    {
+        /* The keys and the state of the generator */
+        zobrist_keys_t keys {}; std::uint64_t state = 0x2545f4914f6cdd1d;
+
+        /* The splitmix64 generator */
+        auto next = [ &state ] () constexpr
+        {
+            std::uint64_t z = ( state += 0x9e3779b97f4a7c15 );
+            z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9;
+            z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111eb;
+            return z ^ ( z >> 31 );
+        };
+
+        /* Generate the keys */
+        for ( auto& pc_keys : keys.pieces ) for ( auto& pt_keys : pc_keys ) for ( auto& key : pt_keys ) key = next ();
+        for ( auto& key : keys.castling_rights ) key = next ();
+        for ( auto& key : keys.en_passant_target ) key = next ();
+        keys.white_last_pc = next ();
+
+        /* Return the keys */
+        return keys;
+    } ();
+
+    /* The material and piece-square values of evaluate, generated at compile time.
+     * Values for black pieces are negative, so that the sum over all pieces is the eval accumulator's psqt_value.
+     */
+    static constexpr psqt_t psqt = [] () constexpr
+    {
+        /* Material values */
+        constexpr int QUEEN  { 1100 }; // 19
+        constexpr int ROOK   {  600 }; // 10
+        constexpr int BISHOP {  400 }; //  7
+        constexpr int KNIGHT {  400 }; //  7
+        constexpr int PAWN   {  100 }; //  2
+
+        /* Piece-square values */
+        constexpr int STRAIGHT_PIECES_ON_7TH_RANK   {  30 }; // For each piece
+        constexpr int BISHOP_OR_KNIGHT_INITIAL_CELL { -15 }; // For every bishop/knight
+        constexpr int CENTER_KNIGHTS                {  20 }; // For every knight
+
+        /* Masks for white. Black masks are found by flipping the ranks. */
+        constexpr unsigned long long center { 0x0000181818000000 }, rank_7 { bitboard::masks::rank_7 };
+        constexpr unsigned long long bishop_initial_cells { 0x0000000000000024 }, knight_initial_cells { 0x0000000000000042 };
+
+        /* Fill the table for white, then copy to black with flipped ranks and negated values.
+         * cast_penum is not yet defined, so the enums are cast directly.
+         */
+        psqt_t table {};
+        for ( int pos = 0; pos < 64; ++pos )
+        {
+            /* Get whether pos is in each mask */
+            const int in_center = ( center >> pos ) & 1, on_rank_7 = ( rank_7 >> pos ) & 1;
+            const int on_bishop_initial_cell = ( bishop_initial_cells >> pos ) & 1, on_knight_initial_cell = ( knight_initial_cells >> pos ) & 1;
+
+            /* Set the white values */
+            auto& white_table = table [ static_cast<int> ( pcolor::white ) ];
+            white_table [ static_cast<int> ( ptype::pawn   ) ] [ pos ] = PAWN;
+            white_table [ static_cast<int> ( ptype::knight ) ] [ pos ] = KNIGHT + BISHOP_OR_KNIGHT_INITIAL_CELL * on_knight_initial_cell + CENTER_KNIGHTS * in_center;
+            white_table [ static_cast<int> ( ptype::bishop ) ] [ pos ] = BISHOP + BISHOP_OR_KNIGHT_INITIAL_CELL * on_bishop_initial_cell;
+            white_table [ static_cast<int> ( ptype::rook   ) ] [ pos ] = ROOK   + STRAIGHT_PIECES_ON_7TH_RANK * on_rank_7;
+            white_table [ static_cast<int> ( ptype::queen  ) ] [ pos ] = QUEEN  + STRAIGHT_PIECES_ON_7TH_RANK * on_rank_7;
+        }
+        for ( int pt = 0; pt < 6; ++pt ) for ( int pos = 0; pos < 64; ++pos )
+            table [ static_cast<int> ( pcolor::black ) ] [ pt ] [ pos ] = -table [ static_cast<int> ( pcolor::white ) ] [ pt ] [ pos ^ 56 ];
+
+        /* Return the table */
+        return table;
+    } ();
+
 
 
     /* MAKING AND UNMAKING MOVES */
 
+    /** @name  zobrist_piece_key, zobrist_aux_key, zobrist_last_pc_key
+     * 
+     * @brief  Get the Zobrist key for a piece, some aux info, or the player who last moved.
+     * @param  pc: The color of the piece, or who last moved.
+     * @param  pt: The type of the piece.
+     * @param  pos: The position of the piece.
+     * @param  aux: The aux info to get the key for.
+     * @return The 64-bit key
+     */
+    chess_const static std::uint64_t zobrist_piece_key ( pcolor pc, ptype pt, int pos ) noexcept { return zobrist_keys.pieces [ cast_penum ( pc ) ] [ cast_penum ( pt ) ] [ pos ]; }
+    chess_const static std::uint64_t zobrist_aux_key ( const aux_info_t& aux ) noexcept
+        { return zobrist_keys.castling_rights [ aux.castling_rights & 0xff ] ^ ( aux.en_passant_color != pcolor::no_piece ? zobrist_keys.en_passant_target [ aux.en_passant_target ] : 0 ); }
+    chess_const static std::uint64_t zobrist_last_pc_key ( pcolor pc ) noexcept { return pc == pcolor::white ? zobrist_keys.white_last_pc : 0; }
+
+    /** @name  psqt_value
+     * 
+     * @brief  Get the material and piece-square value of a piece, positive for white.
+     * @param  pc: The color of the piece.
+     * @param  pt: The type of the piece.
+     * @param  pos: The position of the piece.
+     * @return int
+     */
+    chess_const static int psqt_value ( pcolor pc, ptype pt, int pos ) noexcept { return psqt [ cast_penum ( pc ) ] [ cast_penum ( pt ) ] [ pos ]; }
+
+    /** @name  perft_internal
+     * 
+     * @brief  Count the leaf nodes of the tree of legal moves to a given depth.
+     * @param  pc: The color whose move it is next.
+     * @param  depth: The depth of the tree to count.
+     * @param  bulk_count: If true, the leaf nodes are counted from the move sets at depth 1, rather than by making each move.
+     * @param  divide: If not null, each root move and its number of leaf nodes will be appended to this vector.
+     * @return The number of leaf nodes.
+     */
+    unsigned long long perft_internal ( pcolor pc, int depth, bool bulk_count, std::vector<std::pair<move_t, unsigned long long>> * divide );
+
     /** @name  make_move_internal
      * 
      * @brief  Apply a move. Assumes all the information about the move is correct and legal.
@@ -1236,6 +2242,14 @@ private:
      */
     void make_move_internal ( const move_t& move ) chess_validate_throw;
 
+    /** @name  push_nnue_accumulator
+     * 
+     * @brief  Push the NNUE accumulator for a new state, by updating the most recent accumulator.
+     * @param  delta: The features changed since the most recent accumulator.
+     * @return void
+     */
+    void push_nnue_accumulator ( const nnue::feature_delta_t& delta );
+
     /** @name  unmake_move
      * 
      * @brief  Unmake the last made move.
@@ -1300,9 +2314,11 @@ private:
      * @brief  Create a string describing an alpha-beta search result, in the CECP format.
      *
      * @param  ab_result: The result to format.
+     * @param  ttable: The ttable the search used, from which the principal variation is read. If empty (the default), only the first move is given.
+     * @param  pv_index: The index of the root move in ab_result to describe. 0 (the best move) by default.
      * @return string
      */
-     std::string get_cecp_thinking ( const ab_result_t& ab_result ) const;
+     std::string get_cecp_thinking ( const ab_result_t& ab_result, const ab_ttable_t& ttable = ab_ttable_t {}, std::size_t pv_index = 0 ) const;
 
 };
 
@@ -103,9 +103,13 @@ inline chess::chessboard::chessboard ( const chessboard& other )
     : bbs                { other.bbs }
     , aux_info           { other.aux_info }
     , game_state_history { other.game_state_history }
+    , nnue_history       { other.nnue_history }
 
     /* Don't create ab_working, since it will be created if a search occurs */
     , ab_working { nullptr }
+
+    /* Don't create the pawn hash table, since it will be created if an evaluation occurs */
+    , pawn_hash_table { nullptr }
 {}
 
 /** @name  copy assignment operator
@@ -118,6 +122,7 @@ inline chess::chessboard& chess::chessboard::operator= ( const chessboard& other
     bbs                = other.bbs;
     aux_info           = other.aux_info;
     game_state_history = other.game_state_history;
+    nnue_history       = other.nnue_history;
 
     /* Return this object */
     return * this;
@@ -150,6 +155,7 @@ inline void chess::chessboard::reset_to_empty ()
 
     /* Reset the history */
     game_state_history = { get_game_state ( pcolor::no_piece ) };
+    nnue_history.clear ();
 }
 
 
@@ -193,6 +199,54 @@ inline chess::ptype chess::chessboard::find_type ( const pcolor pc, const int po
     return ptype::no_piece;
 }
 
+/** @name  unpack_move
+ * 
+ * @brief  Reconstruct a full move from a packed move, using the pieces on the board. The move is not checked for legality.
+ *         A pawn move to the last rank without a promotion type is taken to promote to a queen.
+ * @param  pc: The color whose move it is.
+ * @param  move: The packed move.
+ * @return The move, or an empty move if the packed move is empty or there is no piece of pc at its departure.
+ */
+inline chess::move_t chess::chessboard::unpack_move ( const pcolor pc, const packed_move_t move ) const chess_validate_throw
+{
+    /* Find the moving piece, returning an empty move if there is none */
+    const ptype pt = ( move ? find_type ( pc, move.from () ) : ptype::no_piece );
+    if ( pt == ptype::no_piece ) return move_t {};
+
+    /* Detect en passant captures, otherwise find the captured piece */
+    const bool en_passant = ( pt == ptype::pawn && pc == aux_info.en_passant_color && move.to () == aux_info.en_passant_target );
+    const ptype capture_pt = ( en_passant ? ptype::pawn : find_type ( other_color ( pc ), move.to () ) );
+
+    /* Detect promotions */
+    const ptype promote_pt = ( pt == ptype::pawn && ( move.to () < 8 || move.to () >= 56 ) && move.promote_pt () == ptype::no_piece ? ptype::queen : move.promote_pt () );
+
+    /* Return the move */
+    return move_t { pc, pt, capture_pt, promote_pt, move.from (), move.to () };
+}
+
+/** @name  is_draw_state
+ * 
+ * @brief  Returns true if this state is a draw by the fifty-move rule or by repetition.
+ *         The fifty-move rule is applied by the halfmove clock alone, without first looking for checkmate, which is left to the caller (see is_fifty_move_draw).
+ *         Repetitions are found by comparing the Zobrist keys of every other state, back to the last capture, pawn move or null move.
+ *         A state repeated three times is a draw. So is a state repeated once within the most recent search_plies states, since those are part of a search tree, and the repetition could be continued.
+ * @param  search_plies: The number of the most recent states which are part of a search tree, 0 by default.
+ * @return boolean
+ */
+inline bool chess::chessboard::is_draw_state ( const int search_plies ) const chess_validate_throw
+{
+    /* Get the current state and the number of states before it */
+    const game_state_t& state = game_state_history.back ();
+    const int num_prev_states = game_state_history.size () - 1;
+
+    /* Look for repetitions, by comparing the keys of states with the same player to move. A repetition needs at least four plies. */
+    for ( int i = 4, repetitions = 0; i <= state.reversible_plies && i <= num_prev_states; i += 2 )
+        if ( game_state_history [ num_prev_states - i ].key == state.key && ( i < search_plies || ++repetitions == 2 ) ) return true;
+
+    /* Apply the fifty-move rule */
+    return state.halfmove_clock >= 100;
+}
+
 
 
 /* GAME_STATE_T IMPLEMENTATION */
@@ -204,8 +258,12 @@ inline chess::ptype chess::chessboard::find_type ( const pcolor pc, const int po
  * @brief  Construct from a chessboard state
  * @param  cb: The chessboard to construct from
  * @param  _last_pc: The player who last moved (to lead to this state)
+ * @param  _key: The Zobrist key of the state. If not given, it will be computed from scratch.
+ * @param  _pawn_key: The pawn-only Zobrist key of the state. If not given, it will be computed from scratch.
+ * @param  _accumulator: The eval accumulator of the state. If not given, it will be computed from scratch.
  */
-inline chess::chessboard::game_state_t::game_state_t ( const chessboard& cb, pcolor _last_pc ) chess_validate_throw : last_pc ( _last_pc ), bbs 
+inline chess::chessboard::game_state_t::game_state_t ( const chessboard& cb, const pcolor _last_pc ) chess_validate_throw : game_state_t { cb, _last_pc, cb.zobrist_hash ( _last_pc ), cb.zobrist_pawn_hash (), cb.compute_eval_accumulator () } {}
+inline chess::chessboard::game_state_t::game_state_t ( const chessboard& cb, const pcolor _last_pc, const std::uint64_t _key, const std::uint64_t _pawn_key, const eval_accumulator_t& _accumulator ) chess_validate_throw : last_pc ( _last_pc ), bbs 
 {
     cb.bb ( pcolor::white ),
     cb.bb ( pcolor::black ),
@@ -215,7 +273,76 @@ inline chess::chessboard::game_state_t::game_state_t ( const chessboard& cb, pco
     cb.bb ( ptype_inc_value.at ( 3 ) ),
     cb.bb ( ptype_inc_value.at ( 4 ) ),
     cb.bb ( ptype_inc_value.at ( 5 ) ),
-}, aux_info { cb.aux_info } {}
+}, aux_info { cb.aux_info }, key { _key }, pawn_key { _pawn_key }, accumulator { _accumulator } {}
+
+
+
+/* ZOBRIST HASHING */
+
+
+
+/** @name  zobrist_hash
+ * 
+ * @brief  Compute the Zobrist key for the current board from scratch.
+ *         The key of the most recent state is maintained incrementally in game_state_history, so this should only be needed for new states.
+ * @param  last_pc: The player who last moved (to lead to this state)
+ * @return The 64-bit key
+ */
+inline std::uint64_t chess::chessboard::zobrist_hash ( const pcolor last_pc ) const noexcept
+{
+    /* Start with the aux info and the player who last moved */
+    std::uint64_t key = zobrist_aux_key ( aux_info ) ^ zobrist_last_pc_key ( last_pc );
+
+    /* Incorporate every piece */
+    for ( const pcolor pc : { pcolor::white, pcolor::black } ) for ( const ptype pt : ptype_inc_value ) for ( bitboard pieces = bb ( pc, pt ); pieces; )
+    {
+        /* Get the next piece and add its key */
+        const int pos = pieces.trailing_zeros (); pieces.reset ( pos );
+        key ^= zobrist_piece_key ( pc, pt, pos );
+    }
+
+    /* Return the key */
+    return key;
+}
+
+/** @name  zobrist_pawn_hash
+ * 
+ * @brief  Compute the pawn-only Zobrist key for the current board from scratch.
+ *         Like the full key, this is maintained incrementally in game_state_history.
+ * @return The 64-bit key
+ */
+inline std::uint64_t chess::chessboard::zobrist_pawn_hash () const noexcept
+{
+    /* Incorporate every pawn */
+    std::uint64_t key = 0;
+    for ( const pcolor pc : { pcolor::white, pcolor::black } ) for ( bitboard pawns = bb ( pc, ptype::pawn ); pawns; )
+    {
+        /* Get the next pawn and add its key */
+        const int pos = pawns.trailing_zeros (); pawns.reset ( pos );
+        key ^= zobrist_piece_key ( pc, ptype::pawn, pos );
+    }
+
+    /* Return the key */
+    return key;
+}
+
+
+
+/* BOARD EVALUATION */
+
+
+
+/** @name  evaluate
+ * 
+ * @brief  Evaluate the board state using the current evaluator. Note that chess_pure is allowed, as no lasting change is made to the object.
+ * @param  pc: The color whose move it is next
+ * @return Integer value, positive for pc, negative for not pc
+ */
+inline int chess::chessboard::evaluate ( const pcolor pc )
+{
+    /* Dispatch to the evaluator */
+    return ( get_evaluator () == evaluator_t::nnue ? evaluate_nnue ( pc ) : evaluate_handcrafted ( pc ) );
+}
 
 
 
@@ -232,50 +359,144 @@ inline chess::chessboard::game_state_t::game_state_t ( const chessboard& cb, pco
  */
 inline std::size_t chess::chessboard::hash::operator () ( const chessboard& cb ) const chess_validate_throw
 {
-    /* Set the hash to a random integer initially */
-    bitboard hash_value { 0xc3efe6e59ff050d2 };
-
-    /* Combine all bitboards into the hash */
-    #pragma clang loop unroll ( full )
-    #pragma GCC unroll 6
-    for ( ptype pt : ptype_inc_value ) hash_value ^= cb.bb ( pt ).bit_rotl ( cast_penum ( pt ) * 8 );
-    hash_value ^= cb.bb ( pcolor::white ).bit_rotl ( 48 ) ^ cb.bb ( pcolor::black ).bit_rotl ( 56 );
-
-    /* Incorporate aux info into hash */
-    hash_value ^= bitboard { static_cast<unsigned> ( cb.aux_info.castling_rights   ) };
-    hash_value ^= bitboard { static_cast<unsigned> ( cb.aux_info.en_passant_target ) };
-    hash_value ^= bitboard { static_cast<unsigned> ( cb.aux_info.en_passant_color  ) };
-
-    /* Return the hash */
-    return hash_value.get_value ();
+    /* Return the Zobrist key, ignoring who last moved, since chessboards compare equal regardless */
+    return cb.zobrist_hash ( pcolor::no_piece );
 }
 inline std::size_t chess::chessboard::hash::operator () ( const game_state_t& cb ) const noexcept
 {
-    /* Set the hash to a random integer initially */
-    bitboard hash_value { 0xcf4c987a6b0979 };
+    /* Return the Zobrist key stored in the state */
+    return cb.key;
+}
+inline std::size_t chess::chessboard::hash::operator () ( const move_t& mv ) const noexcept
+{
+    /* Return the hash of the positions */
+    return mv.from ^ mv.to ^ cast_penum ( mv.pc ) ^ cast_penum ( mv.pt ) << 1 ^ cast_penum ( mv.capture_pt ) << 5 ^ cast_penum ( mv.promote_pt ) << 9;
+}
 
-    /* Incorporate last_pc into hash */
-    hash_value ^= bitboard { static_cast<unsigned> ( cast_penum ( cb.last_pc ) ) };
 
-    /* Combine all bitboards into the hash */
-    #pragma clang loop unroll ( full )
-    #pragma GCC unroll 8
-    for ( int i = 0; i < 8; ++i ) hash_value ^= cb.bbs [ i ].bit_rotl ( i * 8 );
 
-    /* Incorporate aux info into hash */
-    hash_value ^= bitboard { static_cast<unsigned> ( cb.aux_info.castling_rights   ) };
-    hash_value ^= bitboard { static_cast<unsigned> ( cb.aux_info.en_passant_target ) };
-    hash_value ^= bitboard { static_cast<unsigned> ( cb.aux_info.en_passant_color  ) };
+/* TTABLE IMPLEMENTATION */
 
-    /* Return the hash */
-    return hash_value.get_value ();
+
+
+/** @name  probe
+ * 
+ * @brief  Look for an entry in the table.
+ * @param  key: The 64-bit key of the state.
+ * @return An entry if found, std::nullopt otherwise.
+ */
+inline std::optional<chess::chessboard::ab_ttable_entry_t> chess::chessboard::ab_ttable_t::probe ( const std::uint64_t key ) const noexcept
+{
+    /* Return if there is no table */
+    if ( !table ) return std::nullopt;
+
+    /* Get the bucket */
+    const bucket_t& bucket = table->buckets [ key & ( table->num_buckets - 1 ) ];
+
+    /* Look through the slots for a valid entry whose check matches the key */
+    for ( const slot_t& slot : bucket.slots )
+    {
+        /* Load the data and check. If a write is torn, the check will fail. */
+        const std::uint64_t data = slot.data.load ( std::memory_order_relaxed );
+        const std::uint64_t check = slot.check.load ( std::memory_order_relaxed );
+
+        /* Return the entry if it matches */
+        if ( ( data & VALID_BIT ) && ( check ^ data ) == key ) return unpack_entry ( data );
+    }
+
+    /* Not found */
+    return std::nullopt;
 }
-inline std::size_t chess::chessboard::hash::operator () ( const move_t& mv ) const noexcept
+
+/** @name  store
+ * 
+ * @brief  Store an entry in the table.
+ *         An entry with the same key is always replaced.
+ *         Otherwise the slot in the bucket with the least bk_depth, after penalizing entries from previous generations, is replaced.
+ * @param  key: The 64-bit key of the state.
+ * @param  entry: The entry to store.
+ * @return True if an entry for another state was replaced.
+ */
+inline bool chess::chessboard::ab_ttable_t::store ( const std::uint64_t key, const ab_ttable_entry_t& entry ) noexcept
 {
-    /* Return the hash of the positions */
-    return mv.from ^ mv.to ^ cast_penum ( mv.pc ) ^ cast_penum ( mv.pt ) << 1 ^ cast_penum ( mv.capture_pt ) << 5 ^ cast_penum ( mv.promote_pt ) << 9;
+    /* Return if there is no table */
+    if ( !table ) return false;
+
+    /* Get the bucket and the current generation */
+    bucket_t& bucket = table->buckets [ key & ( table->num_buckets - 1 ) ];
+    const unsigned generation = table->generation.load ( std::memory_order_relaxed );
+    const int min_keep_bk_depth = table->min_keep_bk_depth.load ( std::memory_order_relaxed );
+
+    /* Choose the slot to replace, its replacement score, and whether it contains an entry for another state */
+    slot_t * replace = nullptr; int replace_score = std::numeric_limits<int>::max (); bool replace_other = false;
+
+    /* Iterate through the slots */
+    for ( slot_t& slot : bucket.slots )
+    {
+        /* Load the data and check */
+        const std::uint64_t data = slot.data.load ( std::memory_order_relaxed );
+        const std::uint64_t check = slot.check.load ( std::memory_order_relaxed );
+
+        /* If the slot is empty or has the same key, use it immediately */
+        if ( !( data & VALID_BIT ) || ( check ^ data ) == key ) { replace = &slot; replace_other = false; break; }
+
+        /* Get the age and bk_depth of the entry */
+        const int age = ( generation - unpack_generation ( data ) ) & 0xff;
+        const int bk_depth = unpack_entry ( data ).bk_depth;
+
+        /* Get the score, treating aged shallow entries as empty */
+        const int score = ( age && bk_depth < min_keep_bk_depth ? std::numeric_limits<int>::min () : bk_depth - age * AGE_REPLACEMENT_PENALTY );
+
+        /* Replace the slot with the lowest score */
+        if ( score < replace_score ) { replace = &slot; replace_score = score; replace_other = true; }
+    }
+
+    /* Pack the data and write to the slot */
+    const std::uint64_t data = pack ( entry, generation );
+    replace->data.store ( data, std::memory_order_relaxed );
+    replace->check.store ( key ^ data, std::memory_order_relaxed );
+
+    /* Return whether another state was replaced */
+    return replace_other;
+}
+
+/** @name  pack
+ * 
+ * @brief  Pack an entry and generation into 64 bits.
+ * @param  entry: The entry to pack.
+ * @param  generation: The generation to store.
+ * @return The packed data.
+ */
+inline constexpr std::uint64_t chess::chessboard::ab_ttable_t::pack ( const ab_ttable_entry_t& entry, const unsigned generation ) noexcept
+{
+    /* Pack the value, bk_depth, bound, best move and generation, then set the valid bit */
+    return static_cast<std::uint64_t> ( static_cast<std::uint16_t> ( entry.value ) )
+        | static_cast<std::uint64_t> ( static_cast<std::uint8_t> ( entry.bk_depth ) ) << 16
+        | static_cast<std::uint64_t> ( static_cast<std::uint8_t> ( entry.bound ) ) << 24
+        | static_cast<std::uint64_t> ( entry.best_move.get_data () ) << 32
+        | static_cast<std::uint64_t> ( generation & 0xff ) << 48
+        | VALID_BIT;
+}
+
+/** @name  unpack_entry
+ * 
+ * @brief  Extract an entry from packed data.
+ * @param  data: The packed data.
+ * @return ab_ttable_entry_t
+ */
+inline constexpr chess::chessboard::ab_ttable_entry_t chess::chessboard::ab_ttable_t::unpack_entry ( const std::uint64_t data ) noexcept
+{
+    /* Unpack the value, bk_depth, bound and best move */
+    return ab_ttable_entry_t
+    {
+        static_cast<std::int16_t> ( data & 0xffff ),
+        static_cast<char> ( static_cast<std::int8_t> ( ( data >> 16 ) & 0xff ) ),
+        static_cast<ab_ttable_entry_t::bound_t> ( ( data >> 24 ) & 0xff ),
+        packed_move_t::from_data ( ( data >> 32 ) & 0xffff )
+    };
 }
 
 
+
 /* HEADER GUARD */
 #endif /* #ifndef CHESS_CHESSBOARD_HPP_INCLUDED */
\ No newline at end of file
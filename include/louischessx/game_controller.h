@@ -21,13 +21,21 @@
 /* INCLUDES */
 #include <atomic>
 #include <louischessx/chessboard.h>
+#include <louischessx/opening_book.h>
+#include <louischessx/tablebase.h>
+#include <louischessx/time_manager.h>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <future>
 #include <iostream>
+#include <limits>
 #include <list>
 #include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
 #include <vector>
 
 
@@ -79,7 +87,7 @@ public:
 
     /** @name  destructor
      * 
-     * @brief  Cancels any precomputation before destructing.
+     * @brief  Cancels any precomputation and stops the search threads before destructing.
      */
     ~game_controller ();
 
@@ -113,11 +121,47 @@ public:
 
     /** @name  set_parallel_searches
      * 
-     * @brief  Set the number of parallel searches.
+     * @brief  Set the number of parallel searches while pondering, which is also the number of threads used to search a single position.
+     *         Stops any searches, and the search threads, which are restarted with the new number when next needed.
      * @param  parallel_searches: The new number of parallel searches.
      * @return void.
      */
-    void set_parallel_searches ( int parallel_searches ) { num_parallel_searches = parallel_searches; }
+    void set_parallel_searches ( int parallel_searches ) { end_searches (); stop_search_threads (); num_parallel_searches = parallel_searches; }
+
+    /** @name  set_ttable_size
+     * 
+     * @brief  Set the size of the cumulative transposition table. Any precomputation must not be running.
+     *         If the table is already this size, it is kept, so that a table loaded from a file is not discarded.
+     * @param  size_mb: The new size of the table in MB.
+     * @return void.
+     */
+    void set_ttable_size ( std::size_t size_mb ) { if ( cumulative_ttable.size_mb () != size_mb ) cumulative_ttable.resize ( size_mb ); }
+
+    /** @name  set_ttable_file
+     * 
+     * @brief  Set a file to persist the cumulative transposition table in between processes. Any precomputation must not be running.
+     *         If the file exists, it is memory-mapped as the cumulative table, replacing the current one.
+     *         The table is then saved back to the file at the start of each new game and on quit, and is aged rather than cleared by a new game.
+     * @param  path: The path of the file.
+     * @return void.
+     */
+    void set_ttable_file ( const std::string& path );
+
+    /** @name  save_ttable_file
+     * 
+     * @brief  Save the cumulative transposition table to the file set by set_ttable_file, if there is one and the table has been searched with since it was last loaded or saved.
+     *         Any precomputation must not be running.
+     * @return void.
+     */
+    void save_ttable_file ();
+
+    /** @name  open_opening_book
+     * 
+     * @brief  Open a Polyglot opening book. While the game is in the book, book moves are played instantly, and pondering is skipped.
+     * @param  path: The path of the book.
+     * @return void.
+     */
+    void open_opening_book ( const std::string& path ) { book = opening_book { path }; }
 
 
 
@@ -149,6 +193,19 @@ private:
         analyze
     };
 
+    /* An enum to store the purpose of a search */
+    enum class search_type_t
+    {
+        /* Pondering a response to an opponent move which may be made, which runs for max_search_duration */
+        ponder,
+
+        /* A response to the position the computer must now move in, which runs for between response_duration and max_response_duration */
+        response,
+
+        /* Analysis of a position, which runs until it is stopped, with multi_pv principal variations */
+        analysis
+    };
+
     /* A struct to store the information for an active search */
     struct search_data_t
     {
@@ -161,14 +218,49 @@ private:
         /* The move that lead to this state */
         move_t opponent_move;
 
+        /* The purpose of the search */
+        search_type_t search_type;
+
+        /* The priority of the search. Waiting searches with higher priorities are started first. */
+        int priority;
+
         /* The end flag for the search */
         std::stop_source end_flag;
 
         /* Whether to output thinking */
         std::atomic_bool cecp_thinking;
 
-        /* A future to the result of the search */
+        /* The time and best move of the most recent thinking output, which are only accessed by the search thread running the search */
+        chess_clock::time_point last_thinking_point = chess_clock::time_point::min ();
+        move_t last_thinking_move;
+
+        /* The end flag for helper threads which join the search, which is set when the search finishes */
+        std::stop_source helper_end_flag;
+
+        /* A promise and future to the result of the search */
+        std::promise<chessboard::ab_result_t> ab_result_promise;
         std::future<chessboard::ab_result_t> ab_result_future;
+
+        /* The following variables must be protected by search_mx when accessing */
+
+        /* Whether the search has been started and finished by a search thread */
+        bool started = false, finished = false;
+
+        /* The number of helper threads which have joined the search */
+        int num_helpers = 0;
+
+        /* Whether the search was pondering the move the opponent then made, so is now the response */
+        bool ponder_hit = false;
+
+        /* The time point at which the search will be automatically stopped, set when it is started */
+        chess_clock::time_point end_point;
+
+        /* The time manager, which is given the search's limits when it is started. Its limits may also be reset (without search_mx) once a pondered move is made. */
+        time_manager time_control;
+
+        /* The depths of the search and its node budget, set when it is started */
+        std::vector<int> depths;
+        unsigned long long max_nodes;
     };
 
     /* An enum to store the type of clock being used */
@@ -218,8 +310,17 @@ private:
     /* Whether to output thinking info. False by default, */
     bool output_post = false;
 
-    /* The cumulative transposition table */
-    chessboard::ab_ttable_t cumulative_ttable;
+    /* The opening book, which is empty unless one is opened */
+    opening_book book;
+
+    /* The cumulative transposition table, which every search uses by reference */
+    chessboard::ab_ttable_t cumulative_ttable { chessboard::ab_ttable_t::DEFAULT_SIZE_MB };
+
+    /* The path of the file to persist the cumulative transposition table in, or empty if it should not be persisted */
+    std::string ttable_file_path;
+
+    /* Whether a search has been started since the cumulative transposition table was last loaded or saved */
+    std::atomic_bool ttable_file_outdated = false;
 
     /* The input, output and log streams to use */
     std::istream& chess_in = std::cin;
@@ -262,21 +363,32 @@ private:
      * 
      * A list of depths that will be searched in iterative deepening.
      * A list of depths that will be searched to determine the opponent's best moves.
-     * The number of parallel searches to make. If a search finishes, further searches will be started keeping a maximum of 6 simultaneous searches.
+     * The number of parallel searches to make, which is the number of search threads. If a search finishes, its thread starts the waiting search for the next most likely opponent move. This is also the number of threads used for a search which is not pondered.
      * Whether pondering is allowed.
      * The maximum time duration an search can take, at which point other opponent responses will be tried. See above about what happens if the opponent moves before or after this time us up.
-     * The maximum time AFTER the opponent has moved that the computer should take searching before making a move.
+     * The optimum and maximum time AFTER the opponent has moved that the computer should take searching before making a move. Between these, a time manager decides when to stop based on the stability of the search.
+     * The time to allow for the communication of a move, which is kept back from the maximum response time.
      * The minimum bk_depth for an entry in the cumulative ttable entry to be considered worth keeping.
      * The value of latest_best_value for a draw offer to be considered a good idea.
+     * A list of depths that will be searched in analyze mode, and the number of principal variations to output.
+     * The minimum time between thinking outputs of a search, unless a new best move has been found.
+     * The maximum depth of any search, and the number of nodes after which any search is stopped (set by the sd and nodes commands), which are unlimited by default.
      */
     std::vector<int> search_depths = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
     std::vector<int> opponent_search_depths = { 3, 4, 5, 6 };
     int num_parallel_searches = 4;
     bool pondering = true;
     chess_clock::duration max_search_duration = std::chrono::seconds { 30 };
+    chess_clock::duration response_duration = std::chrono::seconds { 15 };
     chess_clock::duration max_response_duration = std::chrono::seconds { 15 };
+    chess_clock::duration move_overhead = std::chrono::milliseconds { 50 };
     int ttable_min_bk_depth = 4;
     int draw_offer_acceptance_value = -100;
+    std::vector<int> analysis_depths = [] () { std::vector<int> depths ( 38 ); std::iota ( depths.begin (), depths.end (), 3 ); return depths; } ();
+    int multi_pv = 1;
+    chess_clock::duration thinking_interval = std::chrono::milliseconds { 100 };
+    int max_depth = std::numeric_limits<int>::max ();
+    unsigned long long max_nodes = std::numeric_limits<unsigned long long>::max ();
 
 
 
@@ -294,23 +406,57 @@ private:
     /* The thread that contols the parallel searches */
     std::thread search_controller;
 
+    /* The persistent threads which run searches, started when first needed */
+    std::vector<std::thread> search_threads;
+
     /* A mutex and condition variable for protecting shared resources of the search */
     std::mutex search_mx;
     std::condition_variable search_cv;
 
-    /* The following three variables must be protected by search_mx when accessing */
+    /* The following variables must be protected by search_mx when accessing */
 
-    /* A vector of iterators of elements in active_searches to notify the controller which searches have completed */
-    std::vector<search_data_it_t> completed_searches;
+    /* Iterators of elements in active_searches which have been started but not yet picked up by a search thread */
+    std::vector<search_data_it_t> waiting_searches;
+
+    /* The number of searches and helpers being run by search threads */
+    int num_running_searches = 0;
+
+    /* A search which search threads should join as helpers if there are no waiting searches, since it is the only search still needed */
+    std::optional<search_data_it_t> assisted_search;
+
+    /* A boolean acting as an end flag for the search threads */
+    bool search_threads_end_flag = false;
+
+    /* The statistics of every search since they were last reset, if CHESS_STATS is true */
+    chessboard::search_stats_t search_stats;
 
     /* A boolean acting as an end flag for the entirety of the search controller */
     bool search_end_flag;
 
-    /* A move_t, which gives the known opponent response to cancel other searches in the search controller */
+    /* A move_t, which gives the known opponent response, the search for which is not cancelled when precomputation stops */
     move_t known_opponent_move; 
 
 
 
+    /* INPUT THREAD ATTRIBUTES */
+
+    /* The thread which reads commands from chess_in into input_queue, run during xboard_loop */
+    std::thread input_thread;
+
+    /* A mutex and condition variable protecting input_queue.
+     * The queue only has a single producer, input_thread, and a single consumer, the thread running xboard_loop.
+     */
+    std::mutex input_mx;
+    std::condition_variable input_cv;
+
+    /* The commands which have been read but not yet handled */
+    std::deque<std::string> input_queue;
+
+    /* A mutex protecting chess_out and chess_log, since input_thread logs commands as they are read */
+    std::mutex output_mx;
+
+
+
     /* INPUT AND OUTPUT */
 
     /** @name  read_chess_in
@@ -321,6 +467,21 @@ private:
      */
     std::string read_chess_in ();
 
+    /** @name  input_thread_loop
+     * 
+     * @brief  The function run by input_thread. Repeatedly reads commands from chess_in into input_queue, until a quit command.
+     *         If chess_in ends, a quit command is queued.
+     * @return void.
+     */
+    void input_thread_loop ();
+
+    /** @name  next_command
+     * 
+     * @brief  Pops the next command from input_queue, blocking until there is one.
+     * @return String, with the newline stripped.
+     */
+    std::string next_command ();
+
     /** @name  write_chess_out
      * 
      * @brief  Write a command or response to chess_out.
@@ -332,6 +493,16 @@ private:
     template<class... Ts>
     void write_chess_out ( const Ts&... outputs );
 
+    /** @name  write_chess_log
+     * 
+     * @brief  Write information to chess_log only, if enabled by output_log.
+     *         A newline will be added and the stream will be flushed.
+     * @param  outputs...: Parameters of printable types to send to chess_log.
+     * @return void.
+     */
+    template<class... Ts>
+    void write_chess_log ( const Ts&... outputs );
+
 
 
     /* COMMAND HANDLING METHODS */
@@ -354,6 +525,14 @@ private:
      */
     int safe_stoi ( const std::string& str ) const;
 
+    /** @name  safe_stoull
+     * 
+     * @brief  Call std::stoull, but rethrow an exception as a chess_input_error. Unlike std::stoull, negative numbers are rejected rather than wrapped.
+     * @param  str: The string to convert
+     * @return The converted integer.
+     */
+    unsigned long long safe_stoull ( const std::string& str ) const;
+
     /** @name  make_and_output_move
      * 
      * @brief  Takes an ab_result and performs, then outputs the best move, if there is one, as well as a result if the game has ended.
@@ -363,6 +542,26 @@ private:
      */
     void make_and_output_move ( chessboard::ab_result_t& ab_result );
 
+    /** @name  make_and_output_book_move
+     * 
+     * @brief  If the current position is in the opening book, performs and outputs a book move.
+     *         Precomputation is not started, since the opponent's reply is also likely to be in the book.
+     * @return True if a book move was made, false if the position is not in the book.
+     */
+    bool make_and_output_book_move ();
+
+    /** @name  wait_for_search
+     * 
+     * @brief  Wait for a search to finish, while answering commands which xboard expects a reply to during a search.
+     *         '?' stops the search, so that its best move so far is played, and ping, time, otim, post and nopost are handled immediately.
+     *         Other commands are left queued to be handled after the search, but those which end or change the game (quit, new, force, result, setboard, undo and remove) stop the search early.
+     *         So that the order of replies is kept, commands after one which is left queued are also left queued, other than '?'.
+     * @param  search_data_it: The search to wait for.
+     * @param  end_point: A time point at which to stop the search, if it has not finished. Never by default.
+     * @return The result of the search, or nothing if a command which ends or changes the game was left queued, in which case the result must not be played.
+     */
+    std::optional<chessboard::ab_result_t> wait_for_search ( search_data_it_t search_data_it, chess_clock::time_point end_point = chess_clock::time_point::max () );
+
 
 
     /* TIME CONTROL */
@@ -412,25 +611,59 @@ private:
 
     /** @name  start_search
      * 
-     * @brief  Start a search, pushing the search data to the bottom of active_searches.
-     *         When the search finishes, the iterator to the active search will be pushed to completed_searches.
-     *         search_cv will then be notified and the thread will exit.
+     * @brief  Start a search, pushing the search data to the bottom of active_searches and queueing it for the search threads.
+     *         The next free search thread will run the waiting search with the highest priority, then set its result and notify search_cv.
      *         The game state will be stored, so can be safely modified after this function returns.
+     *         search_mx must not be held by the caller.
      * @param  cb: The chessboard state to run the search on.
      * @param  pc: The player color to search.
      * @param  opponent_move: The opponent move which lead to this state, empty move by default.
-     * @param  ttable: The transposition table from previous searches. Empty by default.
-     * @param  direct_response: If true, then this search is in response to an opponent move, so max_response_duration should be used instead of max_search_duration. False by default.
+     * @param  search_type: The purpose of the search, which determines its duration. Unless pondering, no other searches will be running,
+     *         so the search becomes the assisted search, such that every free search thread joins it. Pondering by default.
      * @param  output_thinking: If true, then thinking is printed. False by default.
+     * @param  priority: The priority of the search over other waiting searches. Defaults to the highest priority.
      * @return An iterator to the search data in active_searches.
      */
-    search_data_it_t start_search ( const chessboard& cb, pcolor pc, const move_t& opponent_move = move_t {}, chessboard::ab_ttable_t ttable = chessboard::ab_ttable_t {}, bool direct_response = false, bool output_thinking = false );
+    search_data_it_t start_search ( const chessboard& cb, pcolor pc, const move_t& opponent_move = move_t {}, search_type_t search_type = search_type_t::ponder, bool output_thinking = false, int priority = std::numeric_limits<int>::max () );
+
+    /** @name  start_analysis
+     * 
+     * @brief  Stop any searches, then start an analysis of game_cb for next_pc, which outputs its thinking.
+     * @return void
+     */
+    void start_analysis ();
+
+    /** @name  output_thinking
+     * 
+     * @brief  Called by a search thread with thinking info from a search, which is output if enabled for the search.
+     *         The output is rate-limited: a new best move is always output, but otherwise thinking is output at most once every thinking_interval.
+     *         An analysis outputs a line for each of up to multi_pv principal variations.
+     * @param  search_data: The search.
+     * @param  ab_result: The thinking info.
+     * @return void
+     */
+    void output_thinking ( search_data_t& search_data, const chessboard::ab_result_t& ab_result );
+
+    /** @name  search_thread_loop
+     * 
+     * @brief  The function run by each search thread. Repeatedly runs the waiting search with the highest priority, until search_threads_end_flag is set.
+     *         If there are no waiting searches, joins the assisted search as a helper, if it is running and does not have a helper for every other search thread.
+     * @return void
+     */
+    void search_thread_loop ();
+
+    /** @name  stop_search_threads
+     * 
+     * @brief  Stop and join the search threads. There must be no running or waiting searches.
+     * @return void
+     */
+    void stop_search_threads ();
 
     /** @name  start_precomputation
      * 
      * @brief  Start a thread to precompute searches for possible opponent responses. The thread will be stored in search_controller.
-     *         Setting search_end_flag to true then notifying search_cv will cancel all active searches and the controller thread will prompty finish execution.
-     *         Setting known_opponent_move before doing the above will cause the controller thread to not stop the search based on known_opponent_move (but will not start it if not already started).
+     *         The thread runs a shallow search for the opponent's best moves, then starts a search for each, prioritized by the value of the opponent move.
+     *         Setting search_end_flag to true then notifying search_cv causes the controller thread to start no further searches and prompty finish execution.
      *         The game state will be stored, so can be safely modified after this function returns.
      * @return void
      */
@@ -438,12 +671,22 @@ private:
 
     /** @name  stop_precomputation
      * 
-     * @brief  Stop precomputation, if it's running.
-     * @param  oppponent_move: The now known opponent move. Defaults to no move, but if provided will set known_opponent_move which has an effect described by start_precomputation.
+     * @brief  Stop precomputation, if it's running, and cancel every search except one based on opponent_move.
+     *         If that search is still waiting, it is left queued, so that it is run by the next free search thread.
+     *         That search then becomes the assisted search, so the threads of the cancelled searches join it as they become free.
+     * @param  oppponent_move: The now known opponent move, which is stored in known_opponent_move. Defaults to no move.
      * @return Iterator to a search which was made based on opponent_move, or one past the end iterator if not found.
      */
     search_data_it_t stop_precomputation ( const move_t& opponent_move = {} );
 
+    /** @name  end_searches
+     * 
+     * @brief  Stop precomputation and every search, and wait for them to finish.
+     *         Since searches use the cumulative transposition table by reference, this must be called before the table is cleared or replaced.
+     * @return void
+     */
+    void end_searches ();
+
 };
 
 
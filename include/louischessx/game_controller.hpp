@@ -29,15 +29,13 @@
 
 /** @name  destructor
  * 
- * @brief  Cancels any precomputation before destructing.
+ * @brief  Cancels any precomputation and stops the search threads before destructing.
  */
 inline chess::game_controller::~game_controller ()
 {
-    /* Stop any precomputation */
-    stop_precomputation ();
-
-    /* Empty active_searches and completed_searches */
-    active_searches.clear (); completed_searches.clear ();
+    /* Stop and wait for any searches, then stop the search threads */
+    end_searches ();
+    stop_search_threads ();
 }
 
 
@@ -50,11 +48,8 @@ inline chess::game_controller::~game_controller ()
  */
 inline void chess::game_controller::reset_game ()
 {
-    /* Stop any precomputation */
-    stop_precomputation ();
-
-    /* Reset active and complete searches */
-    active_searches.clear (); completed_searches.clear ();
+    /* Stop and wait for any searches */
+    end_searches ();
 
     /* Reset the game state and color to move */
     game_cb = {}; next_pc = pcolor::white;
@@ -86,6 +81,46 @@ inline void chess::game_controller::open_log_file ( const std::string& path )
 
 
 
+/** @name  set_ttable_file
+ * 
+ * @brief  Set a file to persist the cumulative transposition table in between processes. Any precomputation must not be running.
+ *         If the file exists, it is memory-mapped as the cumulative table, replacing the current one.
+ *         The table is then saved back to the file at the start of each new game and on quit, and is aged rather than cleared by a new game.
+ * @param  path: The path of the file.
+ * @return void.
+ */
+inline void chess::game_controller::set_ttable_file ( const std::string& path )
+{
+    /* Set the path */
+    ttable_file_path = path;
+
+    /* If the file exists, try to load it. Otherwise the current table will be saved to it later. */
+    if ( std::ifstream { path } ) try
+    {
+        /* Map the table */
+        cumulative_ttable = chessboard::ab_ttable_t { path };
+        ttable_file_outdated = false;
+    } catch ( const chess_input_error& e )
+    {
+        /* Keep the current table, and output the error as a comment */
+        write_chess_out ( "# Could not load transposition table file (", e.what (), "), so it will be overwritten." );
+    }
+}
+
+/** @name  save_ttable_file
+ * 
+ * @brief  Save the cumulative transposition table to the file set by set_ttable_file, if there is one and the table has been searched with since it was last loaded or saved.
+ *         Any precomputation must not be running.
+ * @return void.
+ */
+inline void chess::game_controller::save_ttable_file ()
+{
+    /* Save the table if there is a file and it is outdated */
+    if ( ttable_file_path.size () && ttable_file_outdated ) { cumulative_ttable.save ( ttable_file_path ); ttable_file_outdated = false; }
+}
+
+
+
 /* XBOARD INTERFACE */
 
 
@@ -100,17 +135,29 @@ inline void chess::game_controller::xboard_loop ()
     /* Store incomming commands */
     std::string cmd;
 
+    /* Start the input thread, which reads commands while they are being handled */
+    input_thread = std::thread { &game_controller::input_thread_loop, this };
+
     /* Loop until quit command */
-    do
+    try
     {
-        /* Get the next command */
-        cmd = read_chess_in ();
+        do
+        {
+            /* Get the next command */
+            cmd = next_command ();
 
-        /* Handle the command */
-        handle_command ( cmd );
+            /* Handle the command */
+            handle_command ( cmd );
 
-        /* Break on a quit command */
-    } while ( !cmd.starts_with ( "quit" ) );
+            /* Break on a quit command */
+        } while ( !cmd.starts_with ( "quit" ) );
+    }
+
+    /* If an exception is thrown, the input thread may still be waiting for input, so detach it before rethrowing */
+    catch ( ... ) { input_thread.detach (); throw; }
+
+    /* Join the input thread, which finishes after reading the quit command */
+    input_thread.join ();
 }
 
 
@@ -131,15 +178,56 @@ inline std::string chess::game_controller::read_chess_in ()
     std::string cmd; std::getline ( chess_in, cmd );
         
     /* Remove the endline, if present */
-    if ( cmd.back () == '\n' ) cmd.pop_back ();
+    if ( cmd.size () && cmd.back () == '\n' ) cmd.pop_back ();
 
     /* Output log if required */
-    if ( output_log ) chess_log << ">  " << cmd << std::endl;
+    if ( output_log ) { std::unique_lock output_lock { output_mx }; chess_log << ">  " << cmd << std::endl; }
 
     /* Return the command */
     return cmd;
 }
 
+/** @name  input_thread_loop
+ * 
+ * @brief  The function run by input_thread. Repeatedly reads commands from chess_in into input_queue, until a quit command.
+ *         If chess_in ends, a quit command is queued.
+ * @return void.
+ */
+inline void chess::game_controller::input_thread_loop ()
+{
+    /* Loop until quit command */
+    std::string cmd;
+    do
+    {
+        /* Get the next command, replacing it with quit if there is no more input */
+        cmd = read_chess_in ();
+        if ( !chess_in ) cmd = "quit";
+
+        /* Push the command and notify */
+        std::unique_lock input_lock { input_mx };
+        input_queue.push_back ( cmd );
+        input_lock.unlock (); input_cv.notify_all ();
+
+        /* Break on a quit command */
+    } while ( !cmd.starts_with ( "quit" ) );
+}
+
+/** @name  next_command
+ * 
+ * @brief  Pops the next command from input_queue, blocking until there is one.
+ * @return String, with the newline stripped.
+ */
+inline std::string chess::game_controller::next_command ()
+{
+    /* Wait for a command */
+    std::unique_lock input_lock { input_mx };
+    input_cv.wait ( input_lock, [ this ] () { return input_queue.size (); } );
+
+    /* Pop and return the command */
+    std::string cmd = std::move ( input_queue.front () ); input_queue.pop_front ();
+    return cmd;
+}
+
 
 
 /** @name  write_chess_out
@@ -153,13 +241,29 @@ inline std::string chess::game_controller::read_chess_in ()
 template<class... Ts>
 inline void chess::game_controller::write_chess_out ( const Ts&... outputs )
 {
-    /* Send to chess_out */
+    /* Lock the output mutex, then send to chess_out */
+    std::unique_lock output_lock { output_mx };
     ( chess_out << ... << outputs ) << std::endl;
 
     /* Output log if required */
     if ( output_log ) ( chess_log << " < " << ... << outputs ) << std::endl;
 }
 
+/** @name  write_chess_log
+ * 
+ * @brief  Write information to chess_log only, if enabled by output_log.
+ *         A newline will be added and the stream will be flushed.
+ * @param  outputs...: Parameters of printable types to send to chess_log.
+ * @return void.
+ */
+template<class... Ts>
+inline void chess::game_controller::write_chess_log ( const Ts&... outputs )
+{
+    /* Lock the output mutex, then output log if required */
+    std::unique_lock output_lock { output_mx };
+    if ( output_log ) ( chess_log << " # " << ... << outputs ) << std::endl;
+}
+
 
 
 /* HEADER GUARD */
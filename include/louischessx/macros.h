@@ -28,6 +28,75 @@
 
 
 
+/* CHESS_USE_PEXT
+ *
+ * If true, sliding attack lookups will be indexed using the BMI2 PEXT instruction rather than magic multiplication.
+ * Defaults to true only if BMI2 is enabled for the target (e.g. -march=native on a CPU which supports it).
+ * CPUs with microcoded PEXT (AMD before Zen 3) should define this to 0.
+ */
+#ifndef CHESS_USE_PEXT
+    #ifdef __BMI2__
+        #define CHESS_USE_PEXT 1
+    #else
+        #define CHESS_USE_PEXT 0
+    #endif
+#endif
+
+
+
+/* CHESS_USE_AVX512, CHESS_USE_AVX2
+ *
+ * If true, NNUE inference will use AVX-512 (with VNNI if enabled too) or AVX2 instructions respectively, rather than scalar code.
+ * Each defaults to true only if enabled for the target (e.g. -march=native on a CPU which supports it). AVX-512 requires the BW extension.
+ */
+#ifndef CHESS_USE_AVX512
+    #ifdef __AVX512BW__
+        #define CHESS_USE_AVX512 1
+    #else
+        #define CHESS_USE_AVX512 0
+    #endif
+#endif
+#ifndef CHESS_USE_AVX2
+    #ifdef __AVX2__
+        #define CHESS_USE_AVX2 1
+    #else
+        #define CHESS_USE_AVX2 0
+    #endif
+#endif
+
+/* CHESS_USE_SSE2
+ *
+ * If true, bitboard pairs (used to evaluate white and black together) are stored in 128-bit SSE2 registers, rather than as two separate bitboards.
+ * Defaults to true only if enabled for the target (which is always the case on x86-64).
+ */
+#ifndef CHESS_USE_SSE2
+    #ifdef __SSE2__
+        #define CHESS_USE_SSE2 1
+    #else
+        #define CHESS_USE_SSE2 0
+    #endif
+#endif
+
+/* CHESS_STATS
+ *
+ * If true, searches gather detailed statistics (see chessboard::search_stats_t), at some cost to their speed.
+ * Defaults to false, in which case the statistics are compiled out.
+ */
+#ifndef CHESS_STATS
+    #define CHESS_STATS 0
+#endif
+
+/* CHESS_USE_SYZYGY
+ *
+ * If true, Syzygy endgame tablebases can be probed using Fathom, which must then be linked against.
+ * Defaults to false.
+ */
+#ifndef CHESS_USE_SYZYGY
+    #define CHESS_USE_SYZYGY 0
+#endif
+
+
+
 /** @name  CHESS_GCC_VERSION
  * 
  * @brief  Evaluates to if GCC is greater or equal to the version specified
@@ -82,6 +151,16 @@
  */
 #define chess_pure [[ using gnu : pure ]]
 
+/* chess_stats
+ *
+ * Evaluates to its arguments only if CHESS_STATS is true, so that statements gathering search statistics are compiled out otherwise
+ */
+#if CHESS_STATS
+    #define chess_stats( ... ) __VA_ARGS__
+#else
+    #define chess_stats( ... )
+#endif
+
 /* chess_pure_validate
  *
  * Same as chess_pure, but evaluates no nothing if CHESS_VALIDATE is true
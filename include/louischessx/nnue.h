@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * include/chess/nnue.h
+ *
+ * Header file for an efficiently updatable neural network evaluation
+ *
+ */
+
+
+
+/* HEADER GUARD */
+#ifndef NNUE_H_INCLUDED
+#define NNUE_H_INCLUDED
+
+
+
+/* INCLUDES */
+#include <array>
+#include <louischessx/macros.h>
+#include <cstdint>
+#include <string>
+
+
+
+/* DECLARATIONS */
+
+namespace chess
+{
+
+    /* PIECE ENUMS */
+
+    /* Declared fully in chessboard.h, which includes this header */
+    enum class pcolor;
+    enum class ptype;
+
+
+
+    /* NNUE CLASS */
+
+    /* class nnue
+     *
+     * Process-wide access to an efficiently updatable neural network
+     */
+    class nnue;
+
+}
+
+
+
+/* NNUE DEFINITION */
+
+/* class nnue
+ *
+ * Process-wide access to an efficiently updatable neural network, used by chessboard to evaluate positions when selected as its evaluator.
+ *
+ * The network has one input feature for each color, type and position of piece (768 in total), from each player's perspective.
+ * From black's perspective, colors are swapped and the board flipped vertically, so that the same weights are used by both players.
+ * These are fully connected to a hidden layer of HIDDEN_SIZE neurons, with the same weights for each perspective.
+ * The hidden layers of both perspectives, the player to move's first, are clipped to [0, QA] and fully connected to a single output.
+ *
+ * Since only a few features change with each move, the hidden layers (accumulators) are updated incrementally as moves are made.
+ * All arithmetic is on 16-bit quantized weights, using AVX-512 or AVX2 when enabled for the target (see CHESS_USE_AVX512 and CHESS_USE_AVX2).
+ *
+ * A network file is the following arrays of little-endian 16-bit signed integers, optionally padded to a multiple of 64 bytes:
+ *  - The feature weights, in the order [color][type][position][neuron], quantized by QA.
+ *  - The hidden layer biases, quantized by QA.
+ *  - The output weights, in the order [perspective][neuron], quantized by QB.
+ *  - The output bias, quantized by QA * QB.
+ * Colors and types are in the order of pcolor and ptype, and color 0 is the color of the perspective.
+ */
+class chess::nnue
+{
+public:
+
+    /* CONSTEXPRS */
+
+    /* The number of input features */
+    static inline constexpr int NUM_FEATURES = 768;
+
+    /* The number of hidden neurons for each perspective */
+    static inline constexpr int HIDDEN_SIZE = 256;
+
+    /* The quantization of the hidden layer and output weights */
+    static inline constexpr int QA = 255, QB = 64;
+
+    /* The scale from the output to centipawns */
+    static inline constexpr int EVAL_SCALE = 400;
+
+    /* The maximum absolute value of an evaluation, which is less than any tablebase or checkmate value */
+    static inline constexpr int MAX_VALUE = 4000;
+
+
+
+    /* TYPES */
+
+    /* struct accumulator_t
+     *
+     * The hidden layer for white's and black's perspectives
+     */
+    struct alignas ( 64 ) accumulator_t
+    {
+        /** @name  default constructor
+         *
+         * @brief  Does not initialize the values, since they are always overwritten.
+         */
+        accumulator_t () noexcept {}
+
+        /** @name  operator==
+         *
+         * @brief  Compares if two accumulators are equal.
+         */
+        bool operator== ( const accumulator_t& other ) const noexcept = default;
+
+        /* The values, indexed by perspective then neuron */
+        std::array<std::array<std::int16_t, HIDDEN_SIZE>, 2> values;
+    };
+
+    /* struct feature_delta_t
+     *
+     * The features added and removed by a move, from white's perspective.
+     * No move adds or removes more than two: a castle moves two pieces, and a capture removes two but adds one.
+     */
+    struct feature_delta_t
+    {
+        /** @name  add, remove
+         *
+         * @brief  Record a piece being added or removed.
+         * @param  pc: The color of the piece.
+         * @param  pt: The type of the piece.
+         * @param  pos: The position of the piece.
+         * @return void
+         */
+        void add    ( pcolor pc, ptype pt, int pos ) noexcept { added   [ num_added++   ] = feature_index ( pc, pt, pos ); }
+        void remove ( pcolor pc, ptype pt, int pos ) noexcept { removed [ num_removed++ ] = feature_index ( pc, pt, pos ); }
+
+        /* The features */
+        std::array<int, 2> added, removed;
+
+        /* The number of features */
+        int num_added = 0, num_removed = 0;
+    };
+
+
+
+    /* CONSTRUCTORS */
+
+    /** @name  default constructor
+     *
+     * @brief  Deleted, since the network is process-wide.
+     */
+    nnue () = delete;
+
+
+
+    /* LOADING */
+
+    /** @name  load
+     *
+     * @brief  Load a network file, replacing any network previously loaded.
+     *         Should not be called while a search is running.
+     * @param  path: The path of the network file.
+     * @throws chess_input_error if the file cannot be read, or is the wrong size.
+     * @return void
+     */
+    static void load ( const std::string& path );
+
+    /** @name  is_loaded
+     *
+     * @brief  Get whether a network has been loaded.
+     * @return boolean
+     */
+    static bool is_loaded () noexcept { return loaded; }
+
+
+
+    /* ACCUMULATORS */
+
+    /** @name  reset_accumulator
+     *
+     * @brief  Set an accumulator to the hidden layer biases, as if there were no pieces.
+     * @param  acc: The accumulator to reset.
+     * @return void
+     */
+    static void reset_accumulator ( accumulator_t& acc ) noexcept;
+
+    /** @name  add_feature
+     *
+     * @brief  Add a piece to an accumulator.
+     * @param  acc: The accumulator.
+     * @param  pc: The color of the piece.
+     * @param  pt: The type of the piece.
+     * @param  pos: The position of the piece.
+     * @return void
+     */
+    static void add_feature ( accumulator_t& acc, pcolor pc, ptype pt, int pos ) noexcept;
+
+    /** @name  update_accumulator
+     *
+     * @brief  Incrementally update an accumulator after a move.
+     * @param  prev: The accumulator before the move.
+     * @param  next: The accumulator to set for after the move, which may be prev to update in place.
+     * @param  delta: The features changed by the move.
+     * @return void
+     */
+    static void update_accumulator ( const accumulator_t& prev, accumulator_t& next, const feature_delta_t& delta ) noexcept;
+
+
+
+    /* EVALUATION */
+
+    /** @name  evaluate
+     *
+     * @brief  Compute the output of the network.
+     * @param  acc: The accumulator for the position.
+     * @param  pc: The color whose move it is next.
+     * @return Integer value in centipawns, positive for pc, negative for not pc.
+     */
+    chess_pure static int evaluate ( const accumulator_t& acc, pcolor pc ) noexcept;
+
+
+
+private:
+
+    /* TYPES */
+
+    /* The weights of the network */
+    struct network_t
+    {
+        /* The feature weights, indexed by feature then neuron */
+        alignas ( 64 ) std::array<std::array<std::int16_t, HIDDEN_SIZE>, NUM_FEATURES> feature_weights;
+
+        /* The hidden layer biases */
+        alignas ( 64 ) std::array<std::int16_t, HIDDEN_SIZE> feature_biases;
+
+        /* The output weights, indexed by perspective (the player to move first) then neuron */
+        alignas ( 64 ) std::array<std::array<std::int16_t, HIDDEN_SIZE>, 2> output_weights;
+
+        /* The output bias */
+        std::int16_t output_bias;
+    };
+
+
+
+    /* STATIC ATTRIBUTES */
+
+    /* The network */
+    static network_t network;
+
+    /* Whether a network has been loaded */
+    static inline bool loaded = false;
+
+
+
+    /* FEATURES */
+
+    /** @name  feature_index
+     *
+     * @brief  Get the index of a piece's feature from white's perspective.
+     * @param  pc: The color of the piece.
+     * @param  pt: The type of the piece.
+     * @param  pos: The position of the piece.
+     * @return The index.
+     */
+    chess_const static int feature_index ( pcolor pc, ptype pt, int pos ) noexcept { return static_cast<int> ( pc ) * 384 + static_cast<int> ( pt ) * 64 + pos; }
+
+    /** @name  flip_feature
+     *
+     * @brief  Convert a feature index from white's perspective to black's, by swapping the color and flipping the position vertically.
+     * @param  feature: The index from white's perspective.
+     * @return The index from black's perspective.
+     */
+    chess_const static int flip_feature ( const int feature ) noexcept { return ( feature ^ 56 ) + ( feature < 384 ? 384 : -384 ); }
+
+};
+
+
+
+/* HEADER GUARD */
+#endif /* #ifndef NNUE_H_INCLUDED */
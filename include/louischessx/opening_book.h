@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * include/chess/opening_book.h
+ *
+ * Header file for reading Polyglot opening books
+ *
+ */
+
+
+
+/* HEADER GUARD */
+#ifndef OPENING_BOOK_H_INCLUDED
+#define OPENING_BOOK_H_INCLUDED
+
+
+
+/* INCLUDES */
+#include <array>
+#include <louischessx/chessboard.h>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+
+
+
+/* DECLARATIONS */
+
+namespace chess
+{
+
+    /* OPENING BOOK CLASS */
+
+    /* class opening_book
+     *
+     * A read-only, memory-mapped Polyglot opening book
+     */
+    class opening_book;
+
+}
+
+
+
+/* OPENING BOOK DEFINITION */
+
+/* class opening_book
+ *
+ * A read-only, memory-mapped Polyglot opening book.
+ * A Polyglot book is a file of 16-byte big-endian entries, sorted by the Polyglot key of the position they are for.
+ * Each entry contains the key, a move, a weight and some learning data (which is ignored).
+ */
+class chess::opening_book
+{
+public:
+
+    /* CONSTRUCTORS */
+
+    /** @name  default constructor
+     *
+     * @brief  Constructs an empty book, which contains no moves.
+     */
+    opening_book () = default;
+
+    /** @name  path constructor
+     *
+     * @brief  Memory-maps a Polyglot book file.
+     * @param  path: The path of the book.
+     * @throws chess_input_error if the file cannot be mapped, or is not a whole number of entries.
+     */
+    explicit opening_book ( const std::string& path );
+
+    /** @name  copy constructor
+     *
+     * @brief  Deleted, since the book owns its mapping.
+     */
+    opening_book ( const opening_book& other ) = delete;
+
+    /** @name  move constructor
+     *
+     * @brief  Takes the mapping of another book, leaving it empty.
+     */
+    opening_book ( opening_book&& other ) noexcept { * this = std::move ( other ); }
+
+    /** @name  copy assignment operator
+     *
+     * @brief  Deleted, since the book owns its mapping.
+     */
+    opening_book& operator= ( const opening_book& other ) = delete;
+
+    /** @name  move assignment operator
+     *
+     * @brief  Takes the mapping of another book, leaving it empty.
+     */
+    opening_book& operator= ( opening_book&& other ) noexcept;
+
+    /** @name  destructor
+     *
+     * @brief  Unmaps the book.
+     */
+    ~opening_book ();
+
+
+
+    /* OPERATORS */
+
+    /** @name  operator bool
+     *
+     * @brief  Returns true if the book contains any entries.
+     */
+    explicit operator bool () const noexcept { return num_entries; }
+
+
+
+    /* BOOK ACCESS */
+
+    /** @name  size
+     *
+     * @brief  Get the number of entries in the book.
+     * @return std::size_t
+     */
+    std::size_t size () const noexcept { return num_entries; }
+
+    /** @name  probe
+     *
+     * @brief  Look for a book move in a position.
+     *         If there are several, one is chosen randomly, with probability proportional to its weight.
+     *         Moves in the book which are not legal in the position (which is only possible after a key collision) are ignored.
+     * @param  cb: The position to look up.
+     * @param  pc: The color who is to move.
+     * @return A legal move, or std::nullopt if the position is not in the book.
+     */
+    std::optional<move_t> probe ( const chessboard& cb, pcolor pc );
+
+    /** @name  polyglot_key
+     *
+     * @brief  Compute the Polyglot key of a position.
+     *         This is a Zobrist key using Polyglot's own random numbers, and is unrelated to the keys used by chessboard.
+     * @param  cb: The position.
+     * @param  pc: The color who is to move.
+     * @return The 64-bit key.
+     */
+    chess_pure static std::uint64_t polyglot_key ( const chessboard& cb, pcolor pc ) noexcept;
+
+
+
+private:
+
+    /* TYPES */
+
+    /* A decoded book entry */
+    struct entry_t
+    {
+        /* The key of the position */
+        std::uint64_t key;
+
+        /* The move, encoded as Polyglot does, and its weight */
+        std::uint16_t move, weight;
+    };
+
+
+
+    /* CONSTEXPRS */
+
+    /* The size of each entry in the file */
+    static inline constexpr std::size_t ENTRY_SIZE = 16;
+
+    /* The offsets of the castling, en passant and turn random numbers in random64 */
+    static inline constexpr int RANDOM_CASTLE_OFFSET = 768, RANDOM_EN_PASSANT_OFFSET = 772, RANDOM_TURN_OFFSET = 780;
+
+
+
+    /* ATTRIBUTES */
+
+    /* The mapping of the file, and its size */
+    void * mapping = nullptr; std::size_t mapping_size = 0;
+
+    /* The number of entries */
+    std::size_t num_entries = 0;
+
+    /* The random number generator for choosing between moves */
+    std::minstd_rand rng { std::random_device {} () };
+
+
+
+    /* STATIC ATTRIBUTES */
+
+    /* Polyglot's random numbers for each piece on each square, the castling rights, the en passant file and the turn */
+    static const std::array<std::uint64_t, 781> random64;
+
+
+
+    /* ENTRY ACCESS */
+
+    /** @name  read_entry
+     *
+     * @brief  Decode an entry from the file.
+     * @param  index: The index of the entry.
+     * @return entry_t
+     */
+    chess_pure entry_t read_entry ( std::size_t index ) const noexcept;
+
+    /** @name  decode_move
+     *
+     * @brief  Convert a Polyglot move to a move for a position, checking that it is legal.
+     * @param  cb: The position.
+     * @param  pc: The color who is to move.
+     * @param  move: The Polyglot move.
+     * @return The move, or std::nullopt if it is not legal.
+     */
+    static std::optional<move_t> decode_move ( const chessboard& cb, pcolor pc, std::uint16_t move );
+
+};
+
+
+
+/* HEADER GUARD */
+#endif /* #ifndef OPENING_BOOK_H_INCLUDED */
@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * include/chess/remote_search.h
+ *
+ * Header file for sharing searches between machines over TCP
+ *
+ */
+
+
+
+/* HEADER GUARD */
+#ifndef REMOTE_SEARCH_H_INCLUDED
+#define REMOTE_SEARCH_H_INCLUDED
+
+
+
+/* INCLUDES */
+#include <atomic>
+#include <chrono>
+#include <louischessx/chessboard.h>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+
+/* DECLARATIONS */
+
+namespace chess
+{
+
+    /* REMOTE SEARCH CLASSES */
+
+    /* class remote_worker
+     *
+     * A connection to a worker, which searches positions on another machine
+     */
+    class remote_worker;
+
+    /* class remote_server
+     *
+     * Listens for connections from coordinators, and searches the positions they send
+     */
+    class remote_server;
+
+
+
+    /* REMOTE SEARCH FUNCTIONS */
+
+    /** @name  remote_search
+     *
+     * @brief  Search a position by splitting its root moves between workers, then merge their results.
+     *         Each worker searches its share of the root moves to a fixed depth with its own transposition table, so only the root move values are shared.
+     *         The root moves are ordered by a depth 1 search, then dealt to the workers in turn, so that each share has a mix of good and bad moves.
+     *         Given a single worker, the whole position is sent without splitting.
+     * @param  cb: The position to search.
+     * @param  pc: The color whose move it is next.
+     * @param  depth: The depth to search to.
+     * @param  max_nodes: The node budget of each worker.
+     * @param  workers: The workers to search on, which are each used by one thread.
+     * @throws chess_input_error if there are no workers, or a worker fails.
+     * @return An ab_result_t containing the best move of each share, ordered by value. Only the depth, total node count, duration and incomplete flag are also set.
+     *         The depth is that of the shallowest share, and the total node count includes every share.
+     */
+    chessboard::ab_result_t remote_search ( const chessboard& cb, pcolor pc, int depth, unsigned long long max_nodes, std::span<remote_worker> workers );
+
+}
+
+
+
+/* REMOTE WORKER DEFINITION */
+
+/* class remote_worker
+ *
+ * A connection to a worker, which searches positions on another machine.
+ *
+ * The protocol is line based. Each request is a single line:
+ *
+ *     search <depth> <max nodes> <fen> [moves <move> ...]
+ *
+ * where the moves are in FIDE notation, and restrict the root moves searched.
+ * The worker replies with a single line, either:
+ *
+ *     result <depth> <nodes> <microseconds> <incomplete> [<move> <value>]
+ *     error <message>
+ *
+ * where the move is the best root move found, which is absent if there are no root moves.
+ * Lines longer than MAX_LINE_LENGTH are not read, and close the connection.
+ */
+class chess::remote_worker
+{
+public:
+
+    /* TYPES */
+
+    /* struct result_t
+     *
+     * The result of a search by a worker
+     */
+    struct result_t
+    {
+        /* The best root move in FIDE notation and its value, or empty if there are no root moves */
+        std::vector<std::pair<std::string, int>> moves;
+
+        /* The deepest complete depth, and the number of nodes visited over every depth */
+        int depth = 0;
+        unsigned long long nodes = 0;
+
+        /* The time taken by the worker */
+        std::chrono::duration<double> duration {};
+
+        /* Whether the node budget was used before the requested depth was complete */
+        bool incomplete = false;
+    };
+
+
+
+    /* CONSTRUCTORS */
+
+    /** @name  address constructor
+     *
+     * @brief  Connects to a worker.
+     * @param  address: The address of the worker, as host:port.
+     * @throws chess_input_error if the address is invalid, or the worker cannot be connected to.
+     */
+    explicit remote_worker ( const std::string& address );
+
+    /** @name  copy constructor
+     *
+     * @brief  Deleted, since the worker owns its connection.
+     */
+    remote_worker ( const remote_worker& other ) = delete;
+
+    /** @name  move constructor
+     *
+     * @brief  Moves the connection to a new worker.
+     */
+    remote_worker ( remote_worker&& other ) noexcept : address { std::move ( other.address ) }, fd { std::exchange ( other.fd, -1 ) }, buffer { std::move ( other.buffer ) }, connected { other.connected } {}
+
+    /** @name  destructor
+     *
+     * @brief  Closes the connection.
+     */
+    ~remote_worker ();
+
+
+
+    /* SEARCH */
+
+    /** @name  search
+     *
+     * @brief  Search a position on the worker, waiting for the result.
+     * @param  fen: The FEN of the position.
+     * @param  depth: The depth to search to.
+     * @param  max_nodes: The node budget of the search.
+     * @param  search_moves: The root moves to search in FIDE notation, or empty to search every root move.
+     * @throws chess_input_error if the connection fails, after which is_connected is false, or the worker could not search the position.
+     * @return The result.
+     */
+    result_t search ( const std::string& fen, int depth, unsigned long long max_nodes, const std::vector<std::string>& search_moves = {} );
+
+    /** @name  get_address
+     *
+     * @brief  Get the address of the worker.
+     * @return The address, as host:port.
+     */
+    const std::string& get_address () const noexcept { return address; }
+
+    /** @name  is_connected
+     *
+     * @brief  Get whether the connection is still usable, which is false once it has failed or given a malformed response.
+     * @return boolean
+     */
+    bool is_connected () const noexcept { return connected; }
+
+
+
+private:
+
+    /* ATTRIBUTES */
+
+    /* The address of the worker */
+    std::string address;
+
+    /* The socket, or -1 if moved from */
+    int fd = -1;
+
+    /* Data received after the end of the last line */
+    std::string buffer;
+
+    /* Whether the connection is still usable */
+    bool connected = true;
+
+    /* Allow the server to use the line helpers */
+    friend class remote_server;
+
+    /* The maximum length of a line, which is far longer than any valid request or response */
+    static inline constexpr std::size_t MAX_LINE_LENGTH = 1 << 16;
+
+
+
+    /* HELPERS */
+
+    /** @name  read_line
+     *
+     * @brief  Read a line from a socket.
+     * @param  fd: The socket.
+     * @param  buffer: Data received after the end of the last line, which is updated.
+     * @param  line: Set to the line read, without a newline.
+     * @return False if the connection closed or failed before a whole line was read, or the line is longer than MAX_LINE_LENGTH.
+     */
+    static bool read_line ( int fd, std::string& buffer, std::string& line );
+
+    /** @name  write_line
+     *
+     * @brief  Write a line to a socket.
+     * @param  fd: The socket.
+     * @param  line: The line to write, to which a newline is added.
+     * @return False if the connection closed or failed.
+     */
+    static bool write_line ( int fd, const std::string& line );
+
+};
+
+
+
+/* REMOTE SERVER DEFINITION */
+
+/* class remote_server
+ *
+ * Listens for connections from coordinators, and searches the positions they send (see remote_worker for the protocol).
+ * Each connection is served by its own thread with its own transposition table, which is cleared before each search so that results do not depend on earlier requests.
+ * There is no authentication, so the server should only listen on trusted networks, and the number of connections served at once is limited, since each has its own table and search threads.
+ */
+class chess::remote_server
+{
+public:
+
+    /* CONSTRUCTORS */
+
+    /** @name  address constructor
+     *
+     * @brief  Starts listening for connections.
+     * @param  bind_address: The address to listen on, such as 127.0.0.1 for this machine only, or :: for every interface.
+     * @param  port: The TCP port to listen on.
+     * @throws chess_input_error if the address is invalid, or the port cannot be listened on.
+     */
+    remote_server ( const std::string& bind_address, int port );
+
+    /** @name  copy constructor
+     *
+     * @brief  Deleted, since the server owns its socket.
+     */
+    remote_server ( const remote_server& other ) = delete;
+
+    /** @name  destructor
+     *
+     * @brief  Stops listening.
+     */
+    ~remote_server ();
+
+
+
+    /* SERVING */
+
+    /** @name  serve
+     *
+     * @brief  Accept and serve connections forever.
+     *         Once max_connections are being served, no more are accepted until one closes, so the rest wait to be served.
+     * @param  hash_mb: The size of the transposition table of each connection in MB.
+     * @param  num_threads: The number of threads to search each position with (see alpha_beta_iterative_deepening).
+     * @param  max_connections: The maximum number of connections to serve at once.
+     * @throws chess_input_error if max_connections is not positive.
+     * @return Never returns.
+     */
+    [[noreturn]] void serve ( std::size_t hash_mb, int num_threads, int max_connections );
+
+
+
+private:
+
+    /* ATTRIBUTES */
+
+    /* The listening socket */
+    int fd = -1;
+
+    /* The number of connections being served */
+    std::atomic<int> num_connections { 0 };
+
+    /* HELPERS */
+
+    /** @name  serve_connection
+     *
+     * @brief  Serve requests from a connection until it is closed.
+     * @param  connection_fd: The socket of the connection, which is closed on return.
+     * @param  hash_mb: The size of the transposition table in MB.
+     * @param  num_threads: The number of threads to search each position with.
+     * @param  num_connections: The number of connections being served, which is decremented and notified on return.
+     * @return void
+     */
+    static void serve_connection ( int connection_fd, std::size_t hash_mb, int num_threads, std::atomic<int>& num_connections );
+
+    /** @name  handle_request
+     *
+     * @brief  Handle a single request line.
+     * @param  request: The request, without a newline.
+     * @param  ttable: The transposition table to search with.
+     * @param  num_threads: The number of threads to search each position with.
+     * @return The response, without a newline.
+     */
+    static std::string handle_request ( const std::string& request, chessboard::ab_ttable_t& ttable, int num_threads );
+
+};
+
+
+
+/* HEADER GUARD */
+#endif /* #ifndef REMOTE_SEARCH_H_INCLUDED */
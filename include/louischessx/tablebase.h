@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * include/chess/tablebase.h
+ *
+ * Header file for probing Syzygy endgame tablebases
+ *
+ */
+
+
+
+/* HEADER GUARD */
+#ifndef TABLEBASE_H_INCLUDED
+#define TABLEBASE_H_INCLUDED
+
+
+
+/* INCLUDES */
+#include <atomic>
+#include <louischessx/chessboard.h>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+
+/* DECLARATIONS */
+
+namespace chess
+{
+
+    /* TABLEBASE CLASS */
+
+    /* class tablebase
+     *
+     * Process-wide access to Syzygy endgame tablebases
+     */
+    class tablebase;
+
+}
+
+
+
+/* TABLEBASE DEFINITION */
+
+/* class tablebase
+ *
+ * Process-wide access to Syzygy endgame tablebases.
+ * The tables are memory-mapped when first used, and shared between every search thread.
+ * Probing is done by Fathom (https://github.com/jdart1/Fathom), so is only available if CHESS_USE_SYZYGY is true.
+ * Otherwise, no tables can be loaded, and every probe fails.
+ */
+class chess::tablebase
+{
+public:
+
+    /* CONSTEXPRS */
+
+    /* The value of a tablebase win. This is less than any checkmate value, but larger than any static evaluation. */
+    static inline constexpr int WIN_VALUE = 5000;
+
+    /* The default minimum bk_depth at which a search node will probe */
+    static inline constexpr int DEFAULT_PROBE_DEPTH = 1;
+
+
+
+    /* CONSTRUCTORS */
+
+    /** @name  default constructor
+     *
+     * @brief  Deleted, since the tablebases are process-wide.
+     */
+    tablebase () = delete;
+
+
+
+    /* INITIALIZATION */
+
+    /** @name  init
+     *
+     * @brief  Load the tablebases in a set of directories, replacing any tablebases previously loaded.
+     *         Should not be called while a search is running.
+     * @param  path: The directories containing the tables, separated by colons.
+     * @throws chess_input_error if tablebase support is not compiled in, or no tables could be loaded.
+     * @return void
+     */
+    static void init ( const std::string& path );
+
+    /** @name  max_pieces
+     *
+     * @brief  Get the largest number of pieces (including kings) of any loaded table.
+     * @return 0 if no tables are loaded.
+     */
+    static int max_pieces () noexcept { return largest; }
+
+    /** @name  set_probe_depth, get_probe_depth
+     *
+     * @brief  Set or get the minimum bk_depth at which a search node will probe the WDL tables.
+     *         Increasing this reduces the number of probes, so bounds the time spent reading the tables from disk.
+     * @param  depth: The new probe depth.
+     */
+    static void set_probe_depth ( const int depth ) noexcept { probe_depth.store ( depth, std::memory_order_relaxed ); }
+    static int  get_probe_depth () noexcept { return probe_depth.load ( std::memory_order_relaxed ); }
+
+
+
+    /* PROBING */
+
+    /** @name  can_probe
+     *
+     * @brief  Cheaply check whether a position could be in the loaded tables.
+     *         The tables do not store positions with castling rights.
+     * @param  cb: The position.
+     * @return boolean
+     */
+    chess_pure static bool can_probe ( const chessboard& cb ) noexcept
+        { return cb.bb ().popcount () <= largest && !cb.has_any_castling_rights ( pcolor::white ) && !cb.has_any_castling_rights ( pcolor::black ); }
+
+    /** @name  probe_wdl
+     *
+     * @brief  Probe the WDL tables for the value of a position.
+     *         Cursed wins and blessed losses, which are decided by the fifty-move rule, are given as draws.
+     *         This only reads the tables, so may be called from any search thread.
+     * @param  cb: The position.
+     * @param  pc: The color who is to move.
+     * @param  fd_depth: The number of moves made since the root, so that nearer wins are preferred.
+     * @return The value of the position for pc, or std::nullopt if it is not in the tables.
+     */
+    static std::optional<int> probe_wdl ( const chessboard& cb, pcolor pc, int fd_depth ) noexcept;
+
+    /** @name  probe_root
+     *
+     * @brief  Probe the DTZ tables for the value of every legal move in a position.
+     *         Wins are valued higher the sooner they zero the fifty-move counter, and losses higher the later.
+     * @param  cb: The position.
+     * @param  pc: The color who is to move.
+     * @return Each legal move and its value for pc, or std::nullopt if the position is not in the tables.
+     */
+    static std::optional<std::vector<std::pair<move_t, int>>> probe_root ( const chessboard& cb, pcolor pc );
+
+
+
+private:
+
+    /* STATIC ATTRIBUTES */
+
+    /* The largest number of pieces of any loaded table */
+    static inline int largest = 0;
+
+    /* The minimum bk_depth at which to probe */
+    static inline std::atomic_int probe_depth { DEFAULT_PROBE_DEPTH };
+
+};
+
+
+
+/* HEADER GUARD */
+#endif /* #ifndef TABLEBASE_H_INCLUDED */
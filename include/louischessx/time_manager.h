@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * include/chess/time_manager.h
+ *
+ * Header file for deciding how long searches should run for
+ *
+ */
+
+
+
+/* HEADER GUARD */
+#ifndef TIME_MANAGER_H_INCLUDED
+#define TIME_MANAGER_H_INCLUDED
+
+
+
+/* INCLUDES */
+#include <atomic>
+#include <louischessx/chessboard.h>
+
+
+
+/* TIME MANAGER DEFINITION */
+
+/* class time_manager
+ *
+ * Decides how long a search should run for, given an optimum and a maximum duration.
+ *
+ * The maximum duration gives the hard end point, at which the search is stopped mid-depth.
+ * The optimum duration is scaled to give the soft end point, after which no new depth is started:
+ *  - It is stretched when the best move has changed in recent depths, since the search is still unsure of its move.
+ *  - It is stretched when the score has dropped since the previous depth, or the search has failed low, since the search may be finding a problem with its move.
+ *  - It is shrunk when the best move has been the same for several depths, since a deeper search is unlikely to change it.
+ * If the optimum is not less than the maximum, there is no time to save for later moves, so the soft end point is the hard end point.
+ *
+ * The results of depths are given by the searching thread, but the limits may be reset by another thread while the search runs.
+ */
+class chess::time_manager
+{
+public:
+
+    /* CONSTEXPRS */
+
+    /* How much each recent change of best move stretches the soft end point. The number of recent changes is halved after each depth. */
+    static inline constexpr double BEST_MOVE_CHANGE_FACTOR = 0.5;
+
+    /* The number of depths for which the best move must be unchanged before the soft end point shrinks, how much it shrinks by for each further depth, and the least it shrinks to */
+    static inline constexpr int STABLE_MIN_DEPTHS = 2;
+    static inline constexpr double STABLE_FACTOR = 0.15, STABLE_MIN_SCALE = 0.5;
+
+    /* The drop in score below which the soft end point is not stretched, the drop at which it is stretched the most, and that most */
+    static inline constexpr int SCORE_DROP_MARGIN = 20, SCORE_DROP_MAX = 100;
+    static inline constexpr double SCORE_DROP_FACTOR = 0.5;
+
+    /* How much failing low stretches the soft end point, until the depth is complete */
+    static inline constexpr double FAILED_LOW_FACTOR = 1.5;
+
+    /* The most that the optimum duration can be stretched by */
+    static inline constexpr double MAX_SCALE = 3.0;
+
+
+
+    /* CONSTRUCTORS */
+
+    /** @name  default constructor
+     *
+     * @brief  Constructs a time manager with no limits, so both end points are never.
+     */
+    time_manager () noexcept : time_manager { chess_clock::time_point::min (), chess_clock::duration::max (), chess_clock::duration::max () } {}
+
+    /** @name  limits constructor
+     *
+     * @brief  Constructs a time manager for a search.
+     * @param  start: The time that the search started.
+     * @param  optimum: The duration the search should take when the best move is neither stable nor unstable.
+     * @param  maximum: The duration after which the search must stop.
+     */
+    time_manager ( chess_clock::time_point start, chess_clock::duration optimum, chess_clock::duration maximum ) noexcept
+        : start_point { start }, optimum_duration { optimum }, maximum_duration { maximum } {}
+
+
+
+    /* LIMITS */
+
+    /** @name  restart
+     *
+     * @brief  Set new limits, keeping what has been learnt from the depths searched so far. May be called while a search is running.
+     * @param  start: The time to measure the durations from.
+     * @param  optimum: The duration the search should take when the best move is neither stable nor unstable.
+     * @param  maximum: The duration after which the search must stop.
+     * @return void
+     */
+    void restart ( chess_clock::time_point start, chess_clock::duration optimum, chess_clock::duration maximum ) noexcept;
+
+    /** @name  hard_end_point
+     *
+     * @brief  Get the time point at which the search must stop.
+     * @return chess_clock::time_point
+     */
+    chess_clock::time_point hard_end_point () const noexcept;
+
+    /** @name  soft_end_point
+     *
+     * @brief  Get the time point after which no new depth should be started (or expected to finish).
+     *         Only the searching thread should call this.
+     * @return chess_clock::time_point
+     */
+    chess_clock::time_point soft_end_point () const noexcept;
+
+
+
+    /* SEARCH RESULTS */
+
+    /** @name  depth_complete
+     *
+     * @brief  Consider the result of a complete depth. Only the searching thread should call this.
+     * @param  ab_result: The result, which must contain at least one move.
+     * @return void
+     */
+    void depth_complete ( const chessboard::ab_result_t& ab_result ) noexcept;
+
+    /** @name  failed_low
+     *
+     * @brief  Consider the search of a depth to have failed low, so it will be searched again. Only the searching thread should call this.
+     * @return void
+     */
+    void failed_low () noexcept { has_failed_low = true; }
+
+
+
+private:
+
+    /* ATTRIBUTES */
+
+    /* The limits, which may be changed while a search is running */
+    std::atomic<chess_clock::time_point> start_point;
+    std::atomic<chess_clock::duration> optimum_duration, maximum_duration;
+
+    /* The following attributes are only accessed by the searching thread */
+
+    /* The best move and its value from the previous depth, and whether there was a previous depth */
+    move_t best_move; int best_value = 0; bool has_best_move = false;
+
+    /* The number of recent changes of best move, which is halved after each depth */
+    double best_move_changes = 0.0;
+
+    /* The number of depths for which the best move has been unchanged */
+    int stable_depths = 0;
+
+    /* The drop in score from the previous depth */
+    int score_drop = 0;
+
+    /* Whether the current depth has failed low */
+    bool has_failed_low = false;
+
+};
+
+
+
+/* HEADER GUARD */
+#endif /* #ifndef TIME_MANAGER_H_INCLUDED */
@@ -45,7 +45,22 @@ int main ( const int argc, const char ** argv )
         ( "debug,d", po::value<std::string> (), "path to write debug info to" )
 
         /* Threading options */
-        ( "threads,t", po::value<int> ()->default_value ( 4 ), "the number of threads while pondering" );
+        ( "threads,t", po::value<int> ()->default_value ( 4 ), "the number of threads while pondering or searching" )
+
+        /* Transposition table options */
+        ( "hash,m", po::value<std::size_t> ()->default_value ( chess::chessboard::ab_ttable_t::DEFAULT_SIZE_MB ), "the size of the transposition table in MB" )
+        ( "ttable-file", po::value<std::string> (), "a file to keep the transposition table in between runs, which is loaded on startup and saved at the start of each game and on quit" )
+
+        /* Opening book options */
+        ( "book,b", po::value<std::string> (), "a Polyglot opening book to play moves from" )
+
+        /* Tablebase options */
+        ( "syzygy-path", po::value<std::string> (), "the directories containing Syzygy tablebases, separated by colons" )
+        ( "syzygy-probe-depth", po::value<int> ()->default_value ( chess::tablebase::DEFAULT_PROBE_DEPTH ), "the minimum remaining depth at which the search probes the tablebases" )
+
+        /* Evaluation options */
+        ( "nnue", po::value<std::string> (), "an NNUE network file to evaluate positions with" )
+        ( "eval", po::value<std::string> (), "the evaluator to use, either 'handcrafted' or 'nnue' (defaults to 'nnue' only if a network is given)" );
 
     /* Create a variables map and extract the command line arguments from argc and argv */
     po::variables_map variables_map;
@@ -73,6 +88,26 @@ int main ( const int argc, const char ** argv )
     /* Set the number of parallel searches */
     game_controller.set_parallel_searches ( variables_map.at ( "threads" ).as<int> () );
 
+    /* Set the size of the transposition table */
+    game_controller.set_ttable_size ( variables_map.at ( "hash" ).as<std::size_t> () );
+
+    /* If a transposition table file is specified, load from and save to it */
+    if ( variables_map.count ( "ttable-file" ) ) game_controller.set_ttable_file ( variables_map.at ( "ttable-file" ).as<std::string> () );
+
+    /* If an opening book is specified, open it */
+    if ( variables_map.count ( "book" ) ) game_controller.open_opening_book ( variables_map.at ( "book" ).as<std::string> () );
+
+    /* If a tablebase path is specified, load the tables, and set the probe depth */
+    if ( variables_map.count ( "syzygy-path" ) ) chess::tablebase::init ( variables_map.at ( "syzygy-path" ).as<std::string> () );
+    chess::tablebase::set_probe_depth ( variables_map.at ( "syzygy-probe-depth" ).as<int> () );
+
+    /* If a network is specified, load it, then choose the evaluator */
+    if ( variables_map.count ( "nnue" ) ) chess::nnue::load ( variables_map.at ( "nnue" ).as<std::string> () );
+    const std::string evaluator = ( variables_map.count ( "eval" ) ? variables_map.at ( "eval" ).as<std::string> () : chess::nnue::is_loaded () ? "nnue" : "handcrafted" );
+    if ( evaluator == "nnue" ) chess::chessboard::set_evaluator ( chess::chessboard::evaluator_t::nnue ); else
+    if ( evaluator == "handcrafted" ) chess::chessboard::set_evaluator ( chess::chessboard::evaluator_t::handcrafted ); else
+    throw chess::chess_input_error { "Unknown evaluator '" + evaluator + "'." };
+
     /* Start the xboard communication loop */
     game_controller.xboard_loop ();
 
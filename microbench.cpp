@@ -0,0 +1,521 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * microbench.cpp
+ *
+ * Entry file for micro-benchmarks of the bitboard primitives, static exchange evaluation and evaluation,
+ * and for a check that the paired bitboard operations match the single bitboard operations, and that evaluation is unchanged by them
+ *
+ */
+
+
+
+/* INCLUDES */
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <louischessx/chess.h>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+
+/* PROGRAM OPTIONS NAMESPACE */
+namespace po = boost::program_options;
+
+
+
+/* CORPUS */
+
+/* Realistic positions from the opening, middlegame and endgame: the perft suite, and positions from the Bratko-Kopec test */
+constexpr const char * corpus_fens [] =
+{
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "1k1r4/pp1b1R2/3q2pp/4p3/2B5/4Q3/PPP2B2/2K5 b - - 0 1",
+    "3r1k2/4npp1/1ppr3p/p6P/P2PPPP1/1NR5/5K2/2R5 w - - 0 1",
+    "2q1rr1k/3bbnnp/p2p1pp1/2pPp3/PpP1P1P1/1P2BNNP/2BQ1PRK/7R b - - 0 1",
+    "rnbqkb1r/p3pppp/1p6/2ppP3/3N4/2P5/PPP1QPPP/R1B1KB1R w KQkq - 0 1",
+    "r1b2rk1/2q1b1pp/p2ppn2/1p6/3QP3/1BN1B3/PPP3PP/R4RK1 w - - 0 1",
+    "2r3k1/pppR1pp1/4p3/4P1P1/5P2/1P4K1/P1P5/8 w - - 0 1",
+    "1nk1r1r1/pp2n1pp/4p3/q2pPp1N/b1pP1P2/B1P2R2/2P1B1PP/R2Q2K1 w - - 0 1",
+    "4b3/p3kp2/6p1/3pP2p/2pP1P2/4K1P1/P3N2P/8 w - - 0 1",
+    "2kr1bnr/pbpq4/2n1pp2/3p3p/3P1P1B/2N2N1Q/PPP3PP/2KR1B1R w - - 0 1",
+    "3rr1k1/pp3pp1/1qn2np1/8/3p4/PP1R1P2/2P1NQPP/R1B3K1 b - - 0 1"
+};
+
+/* The handcrafted evaluation of each corpus position for the color to move, then the sum of the evaluations of every position one move later for the other color.
+ * These were given by the evaluation before the attacks of sliding pieces were computed for both colors at once, so that the paired evaluation can be checked against it.
+ */
+constexpr std::pair<int, long long> corpus_evaluations [] =
+{
+    { 0, -55 },
+    { 126, -7336 },
+    { -111, 1073 },
+    { -175, 288 },
+    { 54, -6805 },
+    { 0, -184 },
+    { -187, 7979 },
+    { -15, 212 },
+    { -60, 1357 },
+    { 90, -3018 },
+    { 216, -10917 },
+    { 57, -1368 },
+    { -28, 207 },
+    { 3, -215 },
+    { 279, -11146 },
+    { 176, -7067 }
+};
+static_assert ( std::size ( corpus_evaluations ) == std::size ( corpus_fens ), "There must be an evaluation for each corpus position." );
+
+/* struct corpus_position_t
+ *
+ * A position of the corpus, with the color to move
+ */
+struct corpus_position_t
+{
+    chess::chessboard cb;
+    chess::pcolor pc;
+};
+
+
+
+/* BENCHMARKS */
+
+/** @name  do_not_optimize
+ *
+ * @brief  Force a value to be computed, and stop the compiler from assuming anything about it afterwards, so that benchmarked calls are not removed or hoisted.
+ * @param  value: The value.
+ * @return void
+ */
+template<class T> inline void do_not_optimize ( T& value ) noexcept { asm volatile ( "" : "+m" ( value ) : : "memory" ); }
+
+/* struct benchmark_t
+ *
+ * A benchmark, which runs an operation over every position of the corpus
+ */
+struct benchmark_t
+{
+    /* The name of the benchmark */
+    const char * name;
+
+    /* Run one pass over the corpus, returning the number of operations performed */
+    unsigned long long ( * pass ) ( std::vector<corpus_position_t>& corpus );
+};
+
+/* The benchmarks. Each passes over the corpus, applying an operation for each color or piece as it would be in move generation or evaluation. */
+const benchmark_t benchmarks [] =
+{
+    /* Fill a color's pieces in every direction, through empty cells */
+    { "bitboard::fill", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) for ( const chess::pcolor pc : { chess::pcolor::white, chess::pcolor::black } )
+        {
+            const chess::bitboard empty = ~position.cb.bb ();
+            for ( const chess::compass dir : chess::compass_array ) { chess::bitboard fill = position.cb.bb ( pc ).fill ( dir, empty ); do_not_optimize ( fill ); ++ops; }
+        }
+        return ops;
+    } },
+
+    /* The attacks of every rook and queen of a color, through empty cells and capturing the other color */
+    { "bitboard::rook_all_attack", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) for ( const chess::pcolor pc : { chess::pcolor::white, chess::pcolor::black } )
+        {
+            const chess::bitboard rooks = position.cb.bb ( pc, chess::ptype::rook ) | position.cb.bb ( pc, chess::ptype::queen );
+            chess::bitboard attacks = rooks.rook_all_attack ( ~position.cb.bb (), position.cb.bb ( other_color ( pc ) ) ); do_not_optimize ( attacks ); ++ops;
+        }
+        return ops;
+    } },
+
+    /* The attacks of every bishop and queen of a color, through empty cells and capturing the other color */
+    { "bitboard::bishop_all_attack", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) for ( const chess::pcolor pc : { chess::pcolor::white, chess::pcolor::black } )
+        {
+            const chess::bitboard bishops = position.cb.bb ( pc, chess::ptype::bishop ) | position.cb.bb ( pc, chess::ptype::queen );
+            chess::bitboard attacks = bishops.bishop_all_attack ( ~position.cb.bb (), position.cb.bb ( other_color ( pc ) ) ); do_not_optimize ( attacks ); ++ops;
+        }
+        return ops;
+    } },
+
+    /* The attacks of every knight of a color, onto cells not occupied by that color */
+    { "bitboard::knight_any_attack", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) for ( const chess::pcolor pc : { chess::pcolor::white, chess::pcolor::black } )
+            { chess::bitboard attacks = position.cb.bb ( pc, chess::ptype::knight ).knight_any_attack ( ~position.cb.bb ( pc ) ); do_not_optimize ( attacks ); ++ops; }
+        return ops;
+    } },
+
+    /* Magic bitboard lookups of the attacks of each single rook and queen */
+    { "bitboard::straight_sliding_attack_lookup", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) for ( chess::bitboard rooks = position.cb.bb ( chess::ptype::rook ) | position.cb.bb ( chess::ptype::queen ); rooks; )
+        {
+            const int pos = rooks.trailing_zeros (); rooks.reset ( pos );
+            chess::bitboard attacks = chess::bitboard::straight_sliding_attack_lookup ( pos, position.cb.bb () ); do_not_optimize ( attacks ); ++ops;
+        }
+        return ops;
+    } },
+
+    /* Magic bitboard lookups of the attacks of each single bishop and queen */
+    { "bitboard::diagonal_sliding_attack_lookup", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) for ( chess::bitboard bishops = position.cb.bb ( chess::ptype::bishop ) | position.cb.bb ( chess::ptype::queen ); bishops; )
+        {
+            const int pos = bishops.trailing_zeros (); bishops.reset ( pos );
+            chess::bitboard attacks = chess::bitboard::diagonal_sliding_attack_lookup ( pos, position.cb.bb () ); do_not_optimize ( attacks ); ++ops;
+        }
+        return ops;
+    } },
+
+    /* The check info of each color's king */
+    { "chessboard::get_check_info", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) for ( const chess::pcolor pc : { chess::pcolor::white, chess::pcolor::black } )
+            { chess::chessboard::check_info_t check_info = position.cb.get_check_info ( pc ); do_not_optimize ( check_info ); ++ops; }
+        return ops;
+    } },
+
+    /* The least valuable attacker of every piece, by the other color */
+    { "chessboard::get_least_valuable_attacker", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) for ( const chess::pcolor pc : { chess::pcolor::white, chess::pcolor::black } )
+            for ( chess::bitboard targets = position.cb.bb ( other_color ( pc ) ); targets; )
+            {
+                const int pos = targets.trailing_zeros (); targets.reset ( pos );
+                std::pair<chess::ptype, int> attacker = position.cb.get_least_valuable_attacker ( pc, pos ); do_not_optimize ( attacker ); ++ops;
+            }
+        return ops;
+    } },
+
+    /* The static exchange evaluation of capturing every piece other than the king, by the other color */
+    { "chessboard::static_exchange_evaluation", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) for ( const chess::pcolor pc : { chess::pcolor::white, chess::pcolor::black } )
+            for ( chess::bitboard targets = position.cb.bb ( other_color ( pc ) ) & ~position.cb.bb ( chess::ptype::king ); targets; )
+            {
+                const int pos = targets.trailing_zeros (); targets.reset ( pos );
+                int gain = position.cb.static_exchange_evaluation ( pc, pos ); do_not_optimize ( gain ); ++ops;
+            }
+        return ops;
+    } },
+
+    /* The evaluation of each position by the current evaluator. The pawn hash table is warm after the first pass, as it would be during a search. */
+    { "chessboard::evaluate", [] ( std::vector<corpus_position_t>& corpus )
+    {
+        unsigned long long ops = 0;
+        for ( corpus_position_t& position : corpus ) { int value = position.cb.evaluate ( position.pc ); do_not_optimize ( value ); ++ops; }
+        return ops;
+    } }
+};
+
+
+
+/* EQUIVALENCE CHECK */
+
+/** @name  check_bitboard_pairs
+ *
+ * @brief  Check that each operation on a bitboard_pair gives the same results as the bitboard operation applied to each bitboard in turn, over the corpus.
+ *         The operands are the sets of pieces which evaluation pairs, with propagators which differ between the two bitboards, so that a mixed up half is caught.
+ * @param  corpus: The corpus to check over.
+ * @return The number of mismatches, each of which is also output.
+ */
+int check_bitboard_pairs ( const std::vector<corpus_position_t>& corpus )
+{
+    /* Compare a pair against the expected bitboards, outputting any mismatch */
+    int mismatches = 0; unsigned long long checks = 0;
+    auto check = [ & ] ( const std::string& name, const std::size_t position, const chess::bitboard_pair pair, const chess::bitboard first, const chess::bitboard second )
+    {
+        ++checks;
+        if ( pair.first () != first || pair.second () != second ) { ++mismatches; std::cout << "mismatch: " << name << " on corpus position " << position << std::endl; }
+    };
+
+    /* Iterate over the corpus */
+    for ( std::size_t i = 0; i < corpus.size (); ++i )
+    {
+        /* Get the paired operands and propagators, white being first */
+        const chess::chessboard& cb = corpus.at ( i ).cb;
+        const chess::bitboard white = cb.bb ( chess::pcolor::white ), black = cb.bb ( chess::pcolor::black ), empty = ~cb.bb ();
+        const std::pair<chess::bitboard, chess::bitboard> operands []
+        {
+            { white, black },
+            { cb.bb ( chess::pcolor::white, chess::ptype::pawn ), cb.bb ( chess::pcolor::black, chess::ptype::pawn ) },
+            { cb.bb ( chess::pcolor::white, chess::ptype::queen ) | cb.bb ( chess::pcolor::white, chess::ptype::rook ), cb.bb ( chess::pcolor::black, chess::ptype::queen ) | cb.bb ( chess::pcolor::black, chess::ptype::rook ) },
+            { cb.bb ( chess::pcolor::white, chess::ptype::queen ) | cb.bb ( chess::pcolor::white, chess::ptype::bishop ), cb.bb ( chess::pcolor::black, chess::ptype::queen ) | cb.bb ( chess::pcolor::black, chess::ptype::bishop ) }
+        };
+        const chess::bitboard pp_first = empty | cb.bb ( chess::pcolor::white, chess::ptype::queen ), pp_second = empty | cb.bb ( chess::pcolor::black, chess::ptype::queen );
+        const chess::bitboard_pair pp { pp_first, pp_second }, sp { black, white };
+
+        /* Check each operation on each operand, the next operand being the other operand of binary operations */
+        for ( std::size_t j = 0; j < std::size ( operands ); ++j )
+        {
+            const auto [ x_first, x_second ] = operands [ j ];
+            const auto [ y_first, y_second ] = operands [ ( j + 1 ) % std::size ( operands ) ];
+            const chess::bitboard_pair x { x_first, x_second }, y { y_first, y_second };
+
+            /* Access and set operators */
+            check ( "bitboard_pair::bitboard_pair", i, x, x_first, x_second );
+            check ( "bitboard_pair::bitboard_pair (broadcast)", i, chess::bitboard_pair { x_first }, x_first, x_first );
+            check ( "bitboard_pair::swap", i, x.swap (), x_second, x_first );
+            check ( "bitboard_pair::operator&", i, x & y, x_first & y_first, x_second & y_second );
+            check ( "bitboard_pair::operator|", i, x | y, x_first | y_first, x_second | y_second );
+            check ( "bitboard_pair::operator^", i, x ^ y, x_first ^ y_first, x_second ^ y_second );
+            check ( "bitboard_pair::operator~", i, ~x, ~x_first, ~x_second );
+
+            /* Bit counting */
+            ++checks;
+            if ( x.popcount_diff () != x_first.popcount () - x_second.popcount () ) { ++mismatches; std::cout << "mismatch: bitboard_pair::popcount_diff on corpus position " << i << std::endl; }
+
+            /* Shifts, fills and spans in every direction */
+            for ( const chess::compass dir : chess::compass_array )
+            {
+                const std::string dir_name = " (direction " + std::to_string ( chess::cast_compass ( dir ) ) + ")";
+                check ( "bitboard_pair::shift" + dir_name, i, x.shift ( dir ), x_first.shift ( dir ), x_second.shift ( dir ) );
+                check ( "bitboard_pair::fill" + dir_name, i, x.fill ( dir, pp ), x_first.fill ( dir, pp_first ), x_second.fill ( dir, pp_second ) );
+                check ( "bitboard_pair::span" + dir_name, i, x.span ( dir, pp, sp ), x_first.span ( dir, pp_first, black ), x_second.span ( dir, pp_second, white ) );
+            }
+
+            /* Sliding attacks as used by evaluation */
+            for ( const chess::straight_compass dir : chess::straight_compass_array )
+                check ( "bitboard_pair::rook_attack (direction " + std::to_string ( chess::cast_compass ( dir ) ) + ")", i, x.rook_attack ( dir, pp, sp ), x_first.rook_attack ( dir, pp_first, black ), x_second.rook_attack ( dir, pp_second, white ) );
+            for ( const chess::diagonal_compass dir : chess::diagonal_compass_array )
+                check ( "bitboard_pair::bishop_attack (direction " + std::to_string ( chess::cast_compass ( dir ) ) + ")", i, x.bishop_attack ( dir, pp, sp ), x_first.bishop_attack ( dir, pp_first, black ), x_second.bishop_attack ( dir, pp_second, white ) );
+        }
+    }
+
+    /* Output the summary and return the number of mismatches */
+    std::cout << "bitboard_pair check: " << checks << " checks over " << corpus.size () << " positions, " << mismatches << " mismatches" << std::endl;
+    return mismatches;
+}
+
+/** @name  check_evaluations
+ *
+ * @brief  Check the handcrafted evaluation of each position of the corpus, and of every position one move later, against corpus_evaluations.
+ *         This sets the evaluator to handcrafted.
+ * @param  corpus: The corpus to check over, which is unmodified on return.
+ * @return The number of mismatches, each of which is also output.
+ */
+int check_evaluations ( std::vector<corpus_position_t>& corpus )
+{
+    /* Use the handcrafted evaluator, since that is what the expected values are from */
+    chess::chessboard::set_evaluator ( chess::chessboard::evaluator_t::handcrafted );
+
+    /* Iterate over the corpus */
+    int mismatches = 0; unsigned long long checks = 0;
+    for ( std::size_t i = 0; i < corpus.size (); ++i )
+    {
+        /* Evaluate the position, then sum the evaluations after each legal move */
+        chess::chessboard& cb = corpus.at ( i ).cb; const chess::pcolor pc = corpus.at ( i ).pc;
+        const int value = cb.evaluate ( pc ); ++checks;
+        long long child_sum = 0;
+        for ( const auto& [ move, nodes ] : cb.perft_divide ( pc, 1 ) ) { cb.make_move ( move ); child_sum += cb.evaluate ( chess::other_color ( pc ) ); cb.unmake_move (); ++checks; }
+
+        /* Compare against the expected values */
+        if ( value != corpus_evaluations [ i ].first || child_sum != corpus_evaluations [ i ].second )
+        {
+            ++mismatches;
+            std::cout << "mismatch: chessboard::evaluate on corpus position " << i << " gave " << value << " and " << child_sum << " after each move, rather than "
+                      << corpus_evaluations [ i ].first << " and " << corpus_evaluations [ i ].second << std::endl;
+        }
+    }
+
+    /* Output the summary and return the number of mismatches */
+    std::cout << "evaluation check: " << checks << " positions, " << mismatches << " mismatches" << std::endl;
+    return mismatches;
+}
+
+
+
+/* RUNNING */
+
+/* struct measurement_t
+ *
+ * The nanoseconds per operation of a benchmark
+ */
+struct measurement_t
+{
+    /* The least and median nanoseconds per operation over every repetition */
+    double min_ns = 0.0, median_ns = 0.0;
+
+    /* The number of operations of each repetition */
+    unsigned long long ops = 0;
+};
+
+/** @name  run_benchmark
+ *
+ * @brief  Run a benchmark for several repetitions, each repeating passes over the corpus for at least a minimum time.
+ * @param  benchmark: The benchmark to run.
+ * @param  corpus: The corpus to run over.
+ * @param  min_time: The minimum duration of each repetition.
+ * @param  repetitions: The number of repetitions.
+ * @return The measurement.
+ */
+measurement_t run_benchmark ( const benchmark_t& benchmark, std::vector<corpus_position_t>& corpus, const std::chrono::duration<double> min_time, const int repetitions )
+{
+    /* Warm up with a single pass */
+    benchmark.pass ( corpus );
+
+    /* Run each repetition, passing over the corpus until the minimum time has elapsed */
+    std::vector<double> ns_per_op;
+    measurement_t measurement;
+    for ( int i = 0; i < repetitions; ++i )
+    {
+        unsigned long long ops = 0;
+        const auto t0 = std::chrono::steady_clock::now ();
+        std::chrono::duration<double> duration {};
+        do { do_not_optimize ( corpus ); ops += benchmark.pass ( corpus ); duration = std::chrono::steady_clock::now () - t0; } while ( duration < min_time );
+        ns_per_op.push_back ( std::chrono::duration<double, std::nano> ( duration ).count () / std::max ( ops, 1ull ) );
+        measurement.ops = ops;
+    }
+
+    /* Find the least and median time per operation */
+    std::sort ( ns_per_op.begin (), ns_per_op.end () );
+    measurement.min_ns = ns_per_op.front ();
+    measurement.median_ns = ns_per_op.at ( ns_per_op.size () / 2 );
+    return measurement;
+}
+
+/** @name  read_baseline
+ *
+ * @brief  Read the least nanoseconds per operation of each benchmark from the CSV output of an earlier run.
+ * @param  path: The path of the CSV file.
+ * @return A map from benchmark name to nanoseconds per operation.
+ */
+std::map<std::string, double> read_baseline ( const std::string& path )
+{
+    /* Open the file */
+    std::ifstream file { path };
+    if ( !file ) throw chess::chess_input_error { "Failed to open baseline file." };
+
+    /* Read each row after the header, taking the name and least nanoseconds per operation */
+    std::map<std::string, double> baseline;
+    std::string line; std::getline ( file, line );
+    for ( std::smatch row_match; std::getline ( file, line ); ) if ( std::regex_match ( line, row_match, std::regex { "^([^,]+),([^,]+),.*$" } ) ) baseline [ row_match.str ( 1 ) ] = std::stod ( row_match.str ( 2 ) );
+    return baseline;
+}
+
+
+
+/** @name  main
+ *
+ * @brief  Main function
+ * @param  argc: The number of command line parameters
+ * @param  argv: The command line parameters.
+ * @return 0, unless an error occured.
+ */
+int main ( const int argc, const char ** argv )
+{
+    /* Create a complete options description for the executable */
+    po::options_description options_desc;
+    options_desc.add_options ()
+
+        /* Help option */
+        ( "help,h", "produce help message" )
+
+        /* Check option */
+        ( "check", "instead of benchmarking, check that the bitboard_pair operations match the bitboard operations, and that the handcrafted evaluation matches that from before sliding piece attacks were paired, over the corpus, failing on any mismatch" )
+
+        /* Benchmark options */
+        ( "filter", po::value<std::string> (), "only run the benchmarks whose names match this regular expression" )
+        ( "min-time", po::value<double> ()->default_value ( 0.2 ), "the minimum time of each repetition in seconds" )
+        ( "repetitions,r", po::value<int> ()->default_value ( 5 ), "the number of repetitions of each benchmark, of which the least and median times are reported" )
+
+        /* Output options */
+        ( "format,f", po::value<std::string> ()->default_value ( "text" ), "the format of the results, either 'text' or 'csv'" )
+        ( "compare,c", po::value<std::string> (), "the CSV output of an earlier run, which the least times are compared against" )
+
+        /* Evaluation options */
+        ( "nnue", po::value<std::string> (), "an NNUE network file to evaluate positions with" )
+        ( "eval", po::value<std::string> (), "the evaluator to use, either 'handcrafted' or 'nnue' (defaults to 'nnue' only if a network is given)" );
+
+    /* Create a variables map and extract the command line arguments from argc and argv */
+    po::variables_map variables_map;
+    po::store ( po::parse_command_line ( argc, argv, options_desc ), variables_map );
+    po::notify ( variables_map );
+
+    /* If the help option was given, output the help and return */
+    if ( variables_map.count ( "help" ) )
+    {
+        /* Output the help */
+        std::cout << "Usage: louischessx_microbench [options]" << std::endl << options_desc << std::endl;
+
+        /* Return 0 */
+        return 0;
+    }
+
+    /* Get the options, and throw if invalid */
+    const std::chrono::duration<double> min_time { variables_map.at ( "min-time" ).as<double> () };
+    const int repetitions = variables_map.at ( "repetitions" ).as<int> ();
+    const std::string format = variables_map.at ( "format" ).as<std::string> ();
+    const std::regex filter { variables_map.count ( "filter" ) ? variables_map.at ( "filter" ).as<std::string> () : ".*" };
+    if ( repetitions < 1 ) throw chess::chess_input_error { "Number of repetitions must be positive." };
+    if ( format != "text" && format != "csv" ) throw chess::chess_input_error { "Unknown format '" + format + "'." };
+    const std::map<std::string, double> baseline = ( variables_map.count ( "compare" ) ? read_baseline ( variables_map.at ( "compare" ).as<std::string> () ) : std::map<std::string, double> {} );
+
+    /* If a network is specified, load it, then choose the evaluator */
+    if ( variables_map.count ( "nnue" ) ) chess::nnue::load ( variables_map.at ( "nnue" ).as<std::string> () );
+    const std::string evaluator = ( variables_map.count ( "eval" ) ? variables_map.at ( "eval" ).as<std::string> () : chess::nnue::is_loaded () ? "nnue" : "handcrafted" );
+    if ( evaluator == "nnue" ) chess::chessboard::set_evaluator ( chess::chessboard::evaluator_t::nnue ); else
+    if ( evaluator == "handcrafted" ) chess::chessboard::set_evaluator ( chess::chessboard::evaluator_t::handcrafted ); else
+    throw chess::chess_input_error { "Unknown evaluator '" + evaluator + "'." };
+
+    /* Set up the corpus */
+    std::vector<corpus_position_t> corpus;
+    for ( const char * fen : corpus_fens ) { chess::chessboard cb; const chess::pcolor pc = cb.fen_deserialize_board ( fen ); corpus.push_back ( { std::move ( cb ), pc } ); }
+
+    /* If checking, check the paired bitboard operations and the evaluation, and return 1 on any mismatch */
+    if ( variables_map.count ( "check" ) ) { const int mismatches = check_bitboard_pairs ( corpus ) + check_evaluations ( corpus ); return ( mismatches ? 1 : 0 ); }
+
+    /* Output the header */
+    if ( format == "csv" ) std::cout << "name,min_ns_per_op,median_ns_per_op,ops" << ( baseline.size () ? ",baseline_ns_per_op,change" : "" ) << std::endl;
+    else std::cout << std::left << std::setw ( 44 ) << "benchmark" << std::right << std::setw ( 12 ) << "ns/op" << std::setw ( 12 ) << "median" << std::setw ( 12 ) << "ops" << ( baseline.size () ? "    baseline   change" : "" ) << std::endl;
+
+    /* Run each benchmark which matches the filter */
+    for ( const benchmark_t& benchmark : benchmarks ) if ( std::regex_search ( benchmark.name, filter ) )
+    {
+        /* Run the benchmark, and find its baseline */
+        const measurement_t measurement = run_benchmark ( benchmark, corpus, min_time, repetitions );
+        const auto baseline_it = baseline.find ( benchmark.name );
+
+        /* Output the measurement, and its change from the baseline as a percentage, where negative is faster */
+        std::ostringstream ss; ss << std::fixed << std::setprecision ( 2 );
+        if ( format == "csv" ) ss << benchmark.name << ',' << measurement.min_ns << ',' << measurement.median_ns << ',' << measurement.ops;
+        else ss << std::left << std::setw ( 44 ) << benchmark.name << std::right << std::setw ( 12 ) << measurement.min_ns << std::setw ( 12 ) << measurement.median_ns << std::setw ( 12 ) << measurement.ops;
+        if ( baseline_it != baseline.end () )
+        {
+            const double change = 100.0 * ( measurement.min_ns / baseline_it->second - 1.0 );
+            if ( format == "csv" ) ss << ',' << baseline_it->second << ',' << change; else ss << std::setw ( 12 ) << baseline_it->second << std::setw ( 8 ) << std::showpos << change << std::noshowpos << '%';
+        } else if ( baseline.size () && format == "csv" ) ss << ",,";
+        std::cout << ss.str () << std::endl;
+    }
+
+
+
+    /* Return 0 */
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * perft.cpp
+ *
+ * Entry file for the perft move generation test and benchmark
+ *
+ */
+
+
+
+/* INCLUDES */
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <louischessx/chess.h>
+
+
+
+/* PROGRAM OPTIONS NAMESPACE */
+namespace po = boost::program_options;
+
+
+
+/* PERFT SUITE */
+
+/* struct perft_position_t
+ *
+ * A position with a known number of leaf nodes at a given depth
+ */
+struct perft_position_t
+{
+    /* The name and FEN of the position */
+    const char * name, * fen;
+
+    /* The depth to search to, and the expected number of leaf nodes */
+    int depth;
+    unsigned long long nodes;
+};
+
+/* The standard perft positions (see https://www.chessprogramming.org/Perft_Results) */
+constexpr perft_position_t perft_suite [] =
+{
+    { "initial",   "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",                 6, 119060324 },
+    { "kiwipete",  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",     5, 193690690 },
+    { "position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",                                 6, 11030083 },
+    { "position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",         5, 15833292 },
+    { "position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",                4, 2103487 },
+    { "position6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594 }
+};
+
+
+
+/** @name  run_perft
+ *
+ * @brief  Run perft on a position, outputting the number of nodes and nodes per second
+ * @param  name: The name of the position to output.
+ * @param  fen: The FEN of the position.
+ * @param  depth: The depth to search to.
+ * @param  bulk_count: Whether to bulk count leaf nodes.
+ * @param  divide: Whether to output the number of leaf nodes for each root move.
+ * @return The number of leaf nodes.
+ */
+unsigned long long run_perft ( const std::string& name, const std::string& fen, const int depth, const bool bulk_count, const bool divide )
+{
+    /* Set up the board */
+    chess::chessboard cb;
+    const chess::pcolor pc = cb.fen_deserialize_board ( fen );
+
+    /* Run and time perft */
+    const auto t0 = std::chrono::steady_clock::now ();
+    unsigned long long nodes = 0;
+    if ( divide )
+    {
+        /* Get the nodes for each move, output them and sum them */
+        for ( const auto& [ move, move_nodes ] : cb.perft_divide ( pc, depth, bulk_count ) )
+        {
+            std::cout << cb.fide_serialize_move ( move ) << ": " << move_nodes << std::endl;
+            nodes += move_nodes;
+        }
+    } else nodes = cb.perft ( pc, depth, bulk_count );
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now () - t0;
+
+    /* Output the result */
+    std::cout << std::left << std::setw ( 12 ) << name << std::right
+              << " depth " << depth
+              << " nodes " << std::setw ( 10 ) << nodes
+              << " time "  << std::fixed << std::setprecision ( 3 ) << duration.count () << "s"
+              << " nps "   << static_cast<unsigned long long> ( nodes / duration.count () ) << std::endl;
+
+    /* Return the number of nodes */
+    return nodes;
+}
+
+
+
+/** @name  main
+ *
+ * @brief  Main function
+ * @param  argc: The number of command line parameters
+ * @param  argv: The command line parameters.
+ * @return 0, unless an error occured or the suite failed.
+ */
+int main ( const int argc, const char ** argv )
+{
+    /* Create a complete options description for the executable */
+    po::options_description options_desc;
+    options_desc.add_options ()
+
+        /* Help option */
+        ( "help,h", "produce help message" )
+
+        /* Position options */
+        ( "fen,f", po::value<std::string> (), "the position to run perft on, otherwise the built-in suite is run" )
+        ( "depth,d", po::value<int> (), "the depth to run perft to, overriding the suite depths" )
+
+        /* Counting options */
+        ( "divide", "output the number of leaf nodes for each root move" )
+        ( "bulk,b", "count leaf nodes from move sets, rather than making each leaf move" );
+
+    /* Create a variables map and extract the command line arguments from argc and argv */
+    po::variables_map variables_map;
+    po::store ( po::parse_command_line ( argc, argv, options_desc ), variables_map );
+    po::notify ( variables_map );
+
+    /* If the help option was given, output the help and return */
+    if ( variables_map.count ( "help" ) )
+    {
+        /* Output the help */
+        std::cout << options_desc << std::endl;
+
+        /* Return 0 */
+        return 0;
+    }
+
+    /* Get the counting flags */
+    const bool bulk_count = variables_map.count ( "bulk" ), divide = variables_map.count ( "divide" );
+
+    /* If a FEN was given, run perft on that position and return */
+    if ( variables_map.count ( "fen" ) )
+    {
+        /* Run perft, defaulting to depth 5 */
+        run_perft ( "position", variables_map.at ( "fen" ).as<std::string> (), ( variables_map.count ( "depth" ) ? variables_map.at ( "depth" ).as<int> () : 5 ), bulk_count, divide );
+
+        /* Return 0 */
+        return 0;
+    }
+
+
+
+    /* Run the suite, counting the total nodes and time, and whether any position failed */
+    unsigned long long total_nodes = 0;
+    bool failed = false;
+    const auto t0 = std::chrono::steady_clock::now ();
+    for ( const perft_position_t& position : perft_suite )
+    {
+        /* Run perft, only checking the node count if the depth was not overridden */
+        const bool check_nodes = !variables_map.count ( "depth" );
+        const unsigned long long nodes = run_perft ( position.name, position.fen, ( check_nodes ? position.depth : variables_map.at ( "depth" ).as<int> () ), bulk_count, divide );
+        total_nodes += nodes;
+
+        /* Report a failure */
+        if ( check_nodes && nodes != position.nodes ) { std::cout << "FAILED: " << position.name << " expected " << position.nodes << " nodes" << std::endl; failed = true; }
+    }
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now () - t0;
+
+    /* Output the totals */
+    std::cout << "total nodes " << total_nodes << " time " << std::fixed << std::setprecision ( 3 ) << duration.count () << "s nps " << static_cast<unsigned long long> ( total_nodes / duration.count () ) << std::endl;
+
+
+
+    /* Return 1 if any position failed, 0 otherwise */
+    return failed;
+}
@@ -14,6 +14,8 @@
 
 /* INCLUDES */
 #include <louischessx/bitboard.h>
+#include <cstdint>
+#include <vector>
 
 
 
@@ -42,3 +44,111 @@ std::string chess::bitboard::format_board ( const char zero, const char one ) co
     /* Return the formatted board */
     return out;
 }
+
+
+
+/* MAGIC SLIDING ATTACKS */
+
+/* The sliding attack tables, initialised with the library */
+const chess::bitboard::sliding_attack_tables_t chess::bitboard::sliding_attack_tables;
+
+/** @name  sliding_attack_tables_t default constructor
+ * 
+ * @brief  Computes the relevant occupancy masks, searches for magics (unless PEXT is used), and fills the attack tables
+ */
+chess::bitboard::sliding_attack_tables_t::sliding_attack_tables_t ()
+{
+#if !CHESS_USE_PEXT
+    /* Xorshift state for the magic search, seeded depending on the rank with seeds known to find magics quickly */
+    std::uint64_t seed = 0;
+    constexpr std::uint64_t rank_seeds [ 8 ] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
+
+    /* A lambda to generate a sparse random number, which are much more likely to be good magics */
+    auto sparse_random = [ & ] () -> unsigned long long
+    {
+        unsigned long long r = ~0ull;
+        for ( int i = 0; i < 3; ++i ) { seed ^= seed >> 12; seed ^= seed << 25; seed ^= seed >> 27; r &= seed * 2685821657736338717ull; }
+        return r;
+    };
+#endif
+
+    /* A lambda to fill the magics and attack table for either straight or diagonal pieces */
+    auto fill_table = [ & ] ( std::array<magic_t, 64>& magics, unsigned long long * attacks, const bool straight )
+    {
+        /* Storage for each occupancy permutation and its attacks */
+        std::vector<unsigned long long> occupancies ( 4096 ), references ( 4096 );
+
+#if !CHESS_USE_PEXT
+        /* The magic attempt at which each table entry was last set */
+        std::vector<int> epochs ( 4096, 0 );
+        int attempt = 0;
+#endif
+
+        /* The current offset into the table */
+        unsigned offset = 0;
+
+        /* Iterate over cells */
+        for ( int pos = 0; pos < 64; ++pos )
+        {
+            /* Get the singleton bitboard for this position */
+            const bitboard pos_bb = singleton_bitboard ( pos );
+
+            /* The relevant occupancy mask is each ray from pos, except for the final cell on the ray (since the attacks do not depend on whether it is occupied) */
+            bitboard mask;
+            for ( const compass dir : compass_array ) if ( straight == ( dir == compass::s || dir == compass::w || dir == compass::e || dir == compass::n ) )
+            {
+                bitboard ray = omnidir_attack_lookup ( dir, pos );
+                if ( ray ) ray.reset ( shift_val ( dir ) > 0 ? 63 - ray.leading_zeros () : ray.trailing_zeros () );
+                mask |= ray;
+            }
+
+            /* Set up the magic */
+            magic_t& m = magics [ pos ];
+            m.mask   = mask.bits;
+            m.shift  = 64 - mask.popcount ();
+            m.offset = offset;
+            m.magic  = 0;
+
+            /* Enumerate all subsets of the mask with the Carry-Rippler trick, and find the attacks for each */
+            int size = 0;
+            unsigned long long occ = 0;
+            do
+            {
+                occupancies [ size ] = occ;
+                references  [ size ] = ( straight ? pos_bb.rook_all_attack ( bitboard { ~occ }, bitboard { occ } ) : pos_bb.bishop_all_attack ( bitboard { ~occ }, bitboard { occ } ) ).bits;
+                occ = ( occ - m.mask ) & m.mask;
+                ++size;
+            } while ( occ );
+
+#if CHESS_USE_PEXT
+            /* PEXT gives a perfect index, so simply fill the table */
+            for ( int i = 0; i < size; ++i ) attacks [ magic_index ( m, bitboard { occupancies [ i ] } ) ] = references [ i ];
+#else
+            /* Reseed depending on the rank */
+            seed = rank_seeds [ pos / 8 ];
+
+            /* Try random magics until one maps every occupancy to an entry without a destructive collision */
+            for ( int i = 0; i < size; )
+            {
+                /* Get a new magic, skipping ones which will obviously not spread the high bits well */
+                do m.magic = sparse_random (); while ( bitboard { ( m.mask * m.magic ) >> 56 }.popcount () < 6 );
+
+                /* Try to fill the table, counting entries set in older attempts as empty */
+                for ( ++attempt, i = 0; i < size; ++i )
+                {
+                    const unsigned index = magic_index ( m, bitboard { occupancies [ i ] } );
+                    if ( epochs [ index - offset ] < attempt ) { epochs [ index - offset ] = attempt; attacks [ index ] = references [ i ]; }
+                    else if ( attacks [ index ] != references [ i ] ) break;
+                }
+            }
+#endif
+
+            /* Increment the offset */
+            offset += size;
+        }
+    };
+
+    /* Fill both tables */
+    fill_table ( straight_magics, straight_attacks.data (), true  );
+    fill_table ( diagonal_magics, diagonal_attacks.data (), false );
+}
@@ -49,13 +49,6 @@ chess::chessboard::check_info_t chess::chessboard::get_check_info ( pcolor pc )
     const bitboard op_straight = bb ( npc, ptype::queen ) | bb ( npc, ptype::rook   );
     const bitboard op_diagonal = bb ( npc, ptype::queen ) | bb ( npc, ptype::bishop );
 
-    /* Get the primary propagator.
-     * Primary propagator of not opposing means that spans will overlook friendly pieces.
-     * The secondary propagator will be universe.
-     */
-    const bitboard pp = ~opposing;
-    const bitboard sp = ~bitboard {};
-
 
 
     /* KING, KNIGHTS AND PAWNS */
@@ -78,48 +71,33 @@ chess::chessboard::check_info_t chess::chessboard::get_check_info ( pcolor pc )
 
     /* SLIDING PIECES */
 
-    /* Iterate through the straight compass to see if those sliding pieces could be attacking */
-    if ( bitboard::straight_attack_lookup ( king_pos ) & op_straight )
-    #pragma clang loop unroll ( full )
-    #pragma GCC unroll 4
-    for ( const straight_compass dir : straight_compass_array )
-    {
-        /* Only continue if this is a possibly valid direction */
-        if ( bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), king_pos ) & op_straight )
-        {
-            /* Span the king in the current direction */
-            const bitboard king_span = king.rook_attack ( dir, pp, sp );
-
-            /* Get the checking and blocking pieces */
-            const bitboard checking = king_span & op_straight;
-            const bitboard blocking = king_span & friendly;
-
-            /* Add check info */
-            check_info.check_vectors |= king_span.only_if ( checking.is_nonempty () & blocking.is_empty () );
-            check_info.pin_vectors   |= king_span.only_if ( checking.is_nonempty () & blocking.is_singleton () );
-        }
-    }
+    /* Lookup the sliding attacks from the king, with only opposing pieces considered occupied.
+     * This way the attacks overlook friendly pieces and stop at the first opposing piece in each direction, which may be checking or pinning.
+     */
+    const bitboard straight_attackers = bitboard::straight_sliding_attack_lookup ( king_pos, opposing ) & op_straight;
+    const bitboard diagonal_attackers = bitboard::diagonal_sliding_attack_lookup ( king_pos, opposing ) & op_diagonal;
 
-    /* Iterate through the diagonal compass to see if those sliding pieces could be attacking */
-    if ( bitboard::diagonal_attack_lookup ( king_pos ) & op_diagonal )
-    #pragma clang loop unroll ( full )
-    #pragma GCC unroll 4
-    for ( const diagonal_compass dir : diagonal_compass_array )
+    /* Iterate through the attackers */
+    for ( bitboard attackers = straight_attackers | diagonal_attackers; attackers; )
     {
-        /* Only continue if this is a possibly valid direction */
-        if ( bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), king_pos ) & op_diagonal ) 
-        {
-            /* Span the king in the current direction */
-            const bitboard king_span = king.bishop_attack ( dir, pp, sp );
+        /* Get the position of the next attacker and reset it */
+        const int attacker_pos = attackers.trailing_zeros ();
+        attackers.reset ( attacker_pos );
 
-            /* Get the checking and blocking pieces */
-            const bitboard checking = king_span & op_diagonal;
-            const bitboard blocking = king_span & friendly;
+        /* Get the vector from the king to the attacker.
+         * The cells in between are the intersection of the attacks from each of the two pieces, with the other being the only piece on the board.
+         */
+        const bitboard attacker = singleton_bitboard ( attacker_pos );
+        const bitboard king_span = attacker | ( straight_attackers.test ( attacker_pos ) ?
+            bitboard::straight_sliding_attack_lookup ( king_pos, attacker ) & bitboard::straight_sliding_attack_lookup ( attacker_pos, king ) :
+            bitboard::diagonal_sliding_attack_lookup ( king_pos, attacker ) & bitboard::diagonal_sliding_attack_lookup ( attacker_pos, king ) );
 
-            /* Add check info */
-            check_info.check_vectors |= king_span.only_if ( checking.is_nonempty () & blocking.is_empty () );
-            check_info.pin_vectors   |= king_span.only_if ( checking.is_nonempty () & blocking.is_singleton () );
-        }
+        /* Get the blocking pieces */
+        const bitboard blocking = king_span & friendly;
+
+        /* Add check info */
+        check_info.check_vectors |= king_span.only_if ( blocking.is_empty () );
+        check_info.pin_vectors   |= king_span.only_if ( blocking.is_singleton () );
     }
 
 
@@ -165,16 +143,6 @@ bool chess::chessboard::is_protected ( pcolor pc, int pos ) const chess_validate
     const bitboard fr_straight = bb ( pc, ptype::queen ) | bb ( pc, ptype::rook );
     const bitboard fr_diagonal = bb ( pc, ptype::queen ) | bb ( pc, ptype::bishop );
 
-    /* Get the propagators.
-     * Primary propagator of not non-occupied will mean the span will stop at the first piece.
-     * The secondary propagator of friendly pieces means the span will include a friendly piece if found.
-     */
-    const bitboard pp = ~bb ();
-    const bitboard sp = bb ( pc );
-
-    /* Get the adjacent open cells. These are the cells which don't contain an enemy piece or a friendly pawn, knight or king (and protection from a sliding piece could be blocked) */
-    const bitboard adj_open_cells = bitboard::king_attack_lookup ( pos ) & ~bb ( other_color ( pc ) ) & ~bb ( pc, ptype::pawn ) & ~bb ( pc, ptype::knight ) & ~bb ( pc, ptype::king );
-
 
 
     /* KING, KNIGHTS AND PAWNS */
@@ -195,27 +163,9 @@ bool chess::chessboard::is_protected ( pcolor pc, int pos ) const chess_validate
 
     /* SLIDING PIECES */
 
-    /* Iterate through the straight compass to see if those sliding pieces could be defending */
-    if ( bitboard::straight_attack_lookup ( pos ).has_common ( adj_open_cells ) & bitboard::straight_attack_lookup ( pos ).has_common ( fr_straight ) )
-    #pragma clang loop unroll ( full )
-    #pragma GCC unroll 4
-    for ( const straight_compass dir : straight_compass_array )
-    {
-        /* Only continue if this is a possibly valid direction, then return if is protected */
-        if ( bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), pos ).has_common ( adj_open_cells ) & bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), pos ).has_common ( fr_straight ) )
-            if ( pos_bb.rook_attack ( dir, pp, sp ) & fr_straight ) return true;      
-    }
-
-    /* Iterate through the diagonal compass to see if those sliding pieces could be defending */
-    if ( bitboard::diagonal_attack_lookup ( pos ).has_common ( adj_open_cells ) & bitboard::diagonal_attack_lookup ( pos ).has_common ( fr_diagonal ) )
-    #pragma clang loop unroll ( full )
-    #pragma GCC unroll 4
-    for ( const diagonal_compass dir : diagonal_compass_array )
-    {
-        /* Only continue if this is a possibly valid direction, then return if is protected  */
-        if ( bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), pos ).has_common ( adj_open_cells ) & bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), pos ).has_common ( fr_diagonal ) )
-            if ( pos_bb.bishop_attack ( dir, pp, sp ) & fr_diagonal ) return true;
-    }
+    /* Lookup the sliding attacks from pos, which include the first piece in each direction, and return if any is a friendly sliding piece of the right type */
+    if ( bitboard::straight_sliding_attack_lookup ( pos, bb () ) & fr_straight ) return true;
+    if ( bitboard::diagonal_sliding_attack_lookup ( pos, bb () ) & fr_diagonal ) return true;
 
 
 
@@ -249,18 +199,6 @@ std::pair<chess::ptype, int> chess::chessboard::get_least_valuable_attacker ( pc
     const bitboard fr_straight = ( bb ( pc, ptype::queen ) | bb ( pc, ptype::rook   ) ) & ~check_info.diagonal_pin_vectors;
     const bitboard fr_diagonal = ( bb ( pc, ptype::queen ) | bb ( pc, ptype::bishop ) ) & ~check_info.straight_pin_vectors;
 
-    /* Get the propagators.
-     * Primary propagator of not non-occupied will mean the span will stop at the first piece.
-     * The secondary propagator of friendly pieces means the span will include a friendly piece if found.
-     */
-    const bitboard pp = ~bb ();
-    const bitboard sp = bb ( pc );
-
-    /* Get the adjacent open cells. These are the cells which don't contain an enemy piece or a friendly pawn, knight or king (and protection from a sliding piece could be blocked) */
-    const bitboard adj_open_cells = bitboard::king_attack_lookup ( pos ) & ~bb ( other_color ( pc ) ) & ~bb ( pc, ptype::pawn ) & ~bb ( pc, ptype::knight ) & ~bb ( pc, ptype::king );
-
-
-
     /* PAWNS */
 
     {
@@ -296,63 +234,17 @@ std::pair<chess::ptype, int> chess::chessboard::get_least_valuable_attacker ( pc
 
     /* SLIDING PIECES */
 
-    /* If an attacking queen is found, the rest of the directions must be checked for lower value pieces.
-     * Hence keep a variable storing the position of a queen, if found.
+    /* Get the attacking diagonal and straight pieces.
+     * Since the sliding attacks from pos include the first piece in each direction, there is at most one attacker per direction.
+     * Attackers on a pin vector can only capture if pos is also on a pin vector of the same type.
      */
-    int attacking_queen_pos = -1;
+    const bitboard diagonal_attackers = bitboard::diagonal_sliding_attack_lookup ( pos, bb () ) & fr_diagonal & ~check_info.diagonal_pin_vectors.only_if_not ( check_info.diagonal_pin_vectors.test ( pos ) );
+    const bitboard straight_attackers = bitboard::straight_sliding_attack_lookup ( pos, bb () ) & fr_straight & ~check_info.straight_pin_vectors.only_if_not ( check_info.straight_pin_vectors.test ( pos ) );
 
-    /* Iterate through diagonal sliding pieces first, since this way finding a bishop or rook can cause immediate return */
-
-    /* Iterate through the diagonal compass to see if those sliding pieces could be defending */
-    if ( bitboard::diagonal_attack_lookup ( pos ).has_common ( adj_open_cells ) & bitboard::diagonal_attack_lookup ( pos ).has_common ( fr_diagonal ) )
-    #pragma clang loop unroll ( full )
-    #pragma GCC unroll 4
-    for ( const diagonal_compass dir : diagonal_compass_array )
-    {
-        /* Only continue if this is a possibly valid direction, then return if is protected  */
-        if ( bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), pos ).has_common ( adj_open_cells ) & bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), pos ).has_common ( fr_diagonal ) )
-        {
-            /* Get the attacker */
-            bitboard attacker = pos_bb.bishop_attack ( dir, pp, sp ) & fr_diagonal;
-
-            /* Get if there is an attacker, and it does not move off of a pin vector */
-            if ( attacker && !( attacker.contains ( check_info.diagonal_pin_vectors ) && !check_info.diagonal_pin_vectors.test ( pos ) ) )
-            {
-                /* Get the position */
-                const int attacker_pos = attacker.trailing_zeros ();
-
-                /* If is a bishop, return now, else set attacking_queen_pos */
-                if ( bb ( pc, ptype::bishop ).test ( attacker_pos ) ) return { ptype::bishop, attacker_pos }; else attacking_queen_pos = attacker_pos;
-            }
-        }
-    }
-
-    /* Iterate through the straight compass to see if those sliding pieces could be attacking */
-    if ( bitboard::straight_attack_lookup ( pos ).has_common ( adj_open_cells ) & bitboard::straight_attack_lookup ( pos ).has_common ( fr_straight ) )
-    #pragma clang loop unroll ( full )
-    #pragma GCC unroll 4
-    for ( const straight_compass dir : straight_compass_array )
-    {
-        /* Only continue if this is a possibly valid direction, then return if is protected */
-        if ( bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), pos ).has_common ( adj_open_cells ) & bitboard::omnidir_attack_lookup ( static_cast<compass> ( dir ), pos ).has_common ( fr_straight ) )
-        {
-            /* Get the attackers */
-            bitboard attacker = pos_bb.rook_attack ( dir, pp, sp ) & fr_straight;
-
-            /* Get if there is an attacker, and it does not move off of a pin vector */
-            if ( attacker && !( attacker.contains ( check_info.straight_pin_vectors ) && !check_info.straight_pin_vectors.test ( pos ) ) )
-            {
-                /* Get the position */
-                const int attacker_pos = attacker.trailing_zeros ();
-
-                /* If is a rook, return now, else set attacking_queen_pos */
-                if ( bb ( pc, ptype::rook ).test ( attacker_pos ) ) return { ptype::rook, attacker_pos }; else attacking_queen_pos = attacker_pos;
-            }
-        }
-    }
-
-    /* If an attacking queen was found, return that */
-    if ( attacking_queen_pos != -1 ) return { ptype::queen, attacking_queen_pos };
+    /* Look for bishops, then rooks, then queens */
+    if ( diagonal_attackers & bb ( pc, ptype::bishop ) ) return { ptype::bishop, ( diagonal_attackers & bb ( pc, ptype::bishop ) ).trailing_zeros () };
+    if ( straight_attackers & bb ( pc, ptype::rook   ) ) return { ptype::rook,   ( straight_attackers & bb ( pc, ptype::rook   ) ).trailing_zeros () };
+    if ( diagonal_attackers | straight_attackers ) return { ptype::queen, ( diagonal_attackers | straight_attackers ).trailing_zeros () };
 
 
 
@@ -435,14 +327,101 @@ int chess::chessboard::static_exchange_evaluation ( pcolor pc, int attacked_pos,
 
 
 
-/** @name  evaluate
+/** @name  compute_eval_accumulator
  * 
- * @brief  Symmetrically evaluate the board state.
+ * @brief  Compute the eval accumulator for the current board from scratch.
+ *         Like the Zobrist keys, this is maintained incrementally in game_state_history.
+ * @return eval_accumulator_t
+ */
+chess::chessboard::eval_accumulator_t chess::chessboard::compute_eval_accumulator () const noexcept
+{
+    /* Create the accumulator */
+    eval_accumulator_t accumulator;
+
+    /* Iterate through the colors, and the types and positions of their pieces */
+    for ( const pcolor pc : { pcolor::white, pcolor::black } )
+    {
+        for ( const ptype pt : ptype_inc_value ) for ( bitboard pieces = bb ( pc, pt ); pieces; )
+        {
+            /* Get the position of the next piece and add its value */
+            const int pos = pieces.trailing_zeros (); pieces.reset ( pos );
+            accumulator.psqt_value += psqt_value ( pc, pt, pos );
+        }
+
+        /* Count the pieces and restrictives */
+        accumulator.num_pieces [ cast_penum ( pc ) ] = bb ( pc ).popcount ();
+        accumulator.num_restrictives [ cast_penum ( pc ) ] = ( bb ( pc ) & ~bb ( pc, ptype::pawn ) & ~bb ( pc, ptype::king ) ).popcount ();
+    }
+
+    /* Return the accumulator */
+    return accumulator;
+}
+
+
+
+/** @name  compute_nnue_accumulator
+ * 
+ * @brief  Compute the NNUE accumulator for the current board from scratch.
+ *         While the NNUE is the evaluator, this is maintained incrementally by make_move_internal.
+ * @return nnue::accumulator_t
+ */
+chess::nnue::accumulator_t chess::chessboard::compute_nnue_accumulator () const noexcept
+{
+    /* Create the accumulator, starting from no pieces */
+    nnue::accumulator_t accumulator;
+    nnue::reset_accumulator ( accumulator );
+
+    /* Iterate through the colors, and the types and positions of their pieces, adding each one */
+    for ( const pcolor pc : { pcolor::white, pcolor::black } ) for ( const ptype pt : ptype_inc_value ) for ( bitboard pieces = bb ( pc, pt ); pieces; )
+    {
+        const int pos = pieces.trailing_zeros (); pieces.reset ( pos );
+        nnue::add_feature ( accumulator, pc, pt, pos );
+    }
+
+    /* Return the accumulator */
+    return accumulator;
+}
+
+
+
+/** @name  set_evaluator
+ * 
+ * @brief  Set the evaluator used by evaluate, and therefore by every search, process-wide.
+ *         Should not be called while a search is running.
+ * @param  _evaluator: The new evaluator.
+ * @throws chess_input_error if the NNUE is chosen but no network is loaded.
+ * @return void
+ */
+void chess::chessboard::set_evaluator ( const evaluator_t _evaluator )
+{
+    /* Throw if there is no network to use */
+    if ( _evaluator == evaluator_t::nnue && !nnue::is_loaded () ) throw chess_input_error { "Cannot use the NNUE evaluator, since no network is loaded, in set_evaluator ()." };
+
+    /* Set the evaluator */
+    evaluator = _evaluator;
+}
+
+/** @name  evaluate_nnue
+ * 
+ * @brief  Evaluate the board state using the loaded NNUE.
+ * @param  pc: The color whose move it is next
+ * @return Integer value, positive for pc, negative for not pc
+ */
+int chess::chessboard::evaluate_nnue ( const pcolor pc )
+{
+    /* Compute the accumulator if it is not known, then evaluate */
+    if ( nnue_history.empty () ) nnue_history.push_back ( compute_nnue_accumulator () );
+    return nnue::evaluate ( nnue_history.back (), pc );
+}
+
+/** @name  evaluate_handcrafted
+ * 
+ * @brief  Symmetrically evaluate the board state using handcrafted terms.
  *         Note that although is non-const, a call to this function will leave the board unmodified.
  * @param  pc: The color who's move it is next
  * @return Integer value, positive for pc, negative for not pc
  */
-int chess::chessboard::evaluate ( pcolor pc )
+int chess::chessboard::evaluate_handcrafted ( pcolor pc )
 {
     /* TERMINOLOGY */
 
@@ -467,15 +446,10 @@ int chess::chessboard::evaluate ( pcolor pc )
 
     /* Masks */
     constexpr bitboard white_center { 0x0000181818000000 }, black_center { 0x0000001818180000 };
-    constexpr bitboard white_bishop_initial_cells { 0x0000000000000024 }, black_bishop_initial_cells { 0x2400000000000000 };
-    constexpr bitboard white_knight_initial_cells { 0x0000000000000042 }, black_knight_initial_cells { 0x4200000000000000 };
 
-    /* Material values */
-    constexpr int QUEEN  { 1100 }; // 19
-    constexpr int ROOK   {  600 }; // 10
-    constexpr int BISHOP {  400 }; //  7
-    constexpr int KNIGHT {  400 }; //  7
-    constexpr int PAWN   {  100 }; //  2
+    /* Material values, and the values of bishops and knights on their initial cells, knights in the center and straight pieces on the 7th rank,
+     * are in the piece-square table psqt, since they are summed incrementally into the eval accumulator.
+     */
 
     /* Pawns */
     constexpr int PAWN_GENERAL_ATTACKS                      {   1 }; // For every generally attacked cell
@@ -493,7 +467,6 @@ int chess::chessboard::evaluate ( pcolor pc )
     constexpr int LEGAL_ATTACKS_ON_PASSED_PAWN_TRAJECTORIES {   5 }; // For each attack
 
     /* Sliding pieces */
-    constexpr int STRAIGHT_PIECES_ON_7TH_RANK                      { 30 }; // For each piece
     constexpr int DOUBLE_BISHOP                                    { 20 }; // If true
     constexpr int STRAIGHT_PIECES_ON_OPEN_FILE                     { 35 }; // For each piece
     constexpr int STRAIGHT_PIECES_ON_SEMIOPEN_FILE                 { 25 }; // For each piece
@@ -503,11 +476,7 @@ int chess::chessboard::evaluate ( pcolor pc )
     constexpr int DIAGONAL_PIECE_RESTRICTED_CAPTURES               { 15 }; // For every restricted capture on enemy pieces (not including pawns or kings)
     constexpr int RESTRICTIVES_LEGALLY_ATTACKED_BY_DIAGONAL_PIECES { 15 }; // For every restrictive, white and black (pieces not including pawns or kings)
 
-    /* Knights */
-    constexpr int CENTER_KNIGHTS { 20 }; // For every knight
-
     /* Bishops and knights */
-    constexpr int BISHOP_OR_KNIGHT_INITIAL_CELL                 { -15 }; // For every bishop/knight
     constexpr int DIAGONAL_OR_KNIGHT_CAPTURE_ON_STRAIGHT_PIECES {  10 }; // For every capture
     constexpr int BISHOP_OR_KNIGHT_ON_STRONG_SQUARE             {  20 }; // For each piece
 
@@ -556,13 +525,108 @@ int chess::chessboard::evaluate ( pcolor pc )
     /* Set the primary propagator such that all empty cells are set */
     const bitboard pp = ~bb ();
 
-    /* Get the white pawn rear span */
-    const bitboard white_pawn_rear_span = bb ( pcolor::white, ptype::pawn ).span ( compass::s );
-    const bitboard black_pawn_rear_span = bb ( pcolor::black, ptype::pawn ).span ( compass::n );
+    /* Allocate the pawn hash table, if it does not already exist */
+    if ( !pawn_hash_table ) pawn_hash_table = std::make_unique<pawn_hash_table_t> ();
+
+    /* Get the pawn hash table entry for the current pawn structure */
+    const std::uint64_t pawn_key = game_state_history.back ().pawn_key;
+    pawn_hash_entry_t& pawn_entry = pawn_hash_table->entries [ pawn_key & ( pawn_hash_table_t::NUM_ENTRIES - 1 ) ];
+
+    /* If the entry is for a different pawn structure, recompute it */
+    if ( pawn_entry.key != pawn_key )
+    {
+        /* Get the pawn rear spans */
+        const bitboard white_pawn_rear_span = bb ( pcolor::white, ptype::pawn ).span ( compass::s );
+        const bitboard black_pawn_rear_span = bb ( pcolor::black, ptype::pawn ).span ( compass::n );
+
+        /* Get the pawn file fills (from the rear span and forwards fill) */
+        const bitboard white_pawn_file_fill = white_pawn_rear_span | bb ( pcolor::white, ptype::pawn ).fill ( compass::n );
+        const bitboard black_pawn_file_fill = black_pawn_rear_span | bb ( pcolor::black, ptype::pawn ).fill ( compass::s );
+
+        /* Get the semiopen files. White semiopen files contain no white pawns. */
+        const bitboard white_semiopen_files = ~white_pawn_file_fill & black_pawn_file_fill;
+        const bitboard black_semiopen_files = ~black_pawn_file_fill & white_pawn_file_fill;
+
+        /* Get the passed pawns */
+        const bitboard white_passed_pawns = bb ( pcolor::white, ptype::pawn ) & ~white_pawn_rear_span & black_semiopen_files & black_semiopen_files.shift ( compass::e ) & black_semiopen_files.shift ( compass::w );
+        const bitboard black_passed_pawns = bb ( pcolor::black, ptype::pawn ) & ~black_pawn_rear_span & white_semiopen_files & white_semiopen_files.shift ( compass::e ) & white_semiopen_files.shift ( compass::w );
+
+        /* Get general pawn attacks */
+        const bitboard white_pawn_attacks = bb ( pcolor::white, ptype::pawn ).pawn_attack ( diagonal_compass::ne ) | bb ( pcolor::white, ptype::pawn ).pawn_attack ( diagonal_compass::nw );
+        const bitboard black_pawn_attacks = bb ( pcolor::black, ptype::pawn ).pawn_attack ( diagonal_compass::se ) | bb ( pcolor::black, ptype::pawn ).pawn_attack ( diagonal_compass::sw );
+
+        /* Get the strong squares.
+         * These are the squares attacked by a friendly pawn, but not by an enemy pawn.
+         */
+        const bitboard white_strong_squares = white_pawn_attacks & ~black_pawn_attacks;
+        const bitboard black_strong_squares = black_pawn_attacks & ~white_pawn_attacks;
+
+        /* Accumulate the value of the pawn structure */
+        int pawn_value = 0;
+
+        /* Incorporate the number of cells generally attacked by pawns into value */
+        pawn_value += PAWN_GENERAL_ATTACKS * ( white_pawn_attacks.popcount () - black_pawn_attacks.popcount () );
+
+        /* Incorporate strong squares into value */
+        pawn_value += STRONG_SQUARES * ( white_strong_squares.popcount () - black_strong_squares.popcount () );
+
+        /* Incorperate the number of pawns in the center to value */
+        {
+            const bitboard white_center_pawns = bb ( pcolor::white, ptype::pawn ) & white_center;
+            const bitboard black_center_pawns = bb ( pcolor::black, ptype::pawn ) & black_center;
+            pawn_value += CENTER_PAWNS * ( white_center_pawns.popcount () - black_center_pawns.popcount () );
+        }
+
+        /* Incororate the number of center cells generally attacked by pawns into value */
+        {
+            const bitboard white_center_defence = white_pawn_attacks & white_center;
+            const bitboard black_center_defence = black_pawn_attacks & black_center;
+            pawn_value += PAWN_CENTER_GENERAL_ATTACKS * ( white_center_defence.popcount () - black_center_defence.popcount () );
+        }
+
+        /* Incorporate isolated pawns, and those on semiopen files, into value */
+        {
+            const bitboard white_isolated_pawns = bb ( pcolor::white, ptype::pawn ) & ~( white_pawn_file_fill.shift ( compass::e ) | white_pawn_file_fill.shift ( compass::w ) );
+            const bitboard black_isolated_pawns = bb ( pcolor::black, ptype::pawn ) & ~( black_pawn_file_fill.shift ( compass::e ) | black_pawn_file_fill.shift ( compass::w ) );
+            pawn_value += ISOLATED_PAWNS * ( white_isolated_pawns.popcount () - black_isolated_pawns.popcount () );
+            pawn_value += ISOLATED_PAWNS_ON_SEMIOPEN_FILES * ( ( white_isolated_pawns & white_semiopen_files ).popcount () - ( black_isolated_pawns & black_semiopen_files ).popcount () );
+        }
+
+        /* Incorporate the number of doubled pawns into value */
+        {
+            const bitboard white_doubled_pawns = bb ( pcolor::white, ptype::pawn ) & white_pawn_rear_span;
+            const bitboard black_doubled_pawns = bb ( pcolor::black, ptype::pawn ) & black_pawn_rear_span;
+            pawn_value += DOUBLED_PAWNS * ( white_doubled_pawns.popcount () - black_doubled_pawns.popcount () );
+        }
+
+        /* Incorporate phalanga into value */
+        {
+            const bitboard white_phalanga = bb ( pcolor::white, ptype::pawn ) & bb ( pcolor::white, ptype::pawn ).shift ( compass::e );
+            const bitboard black_phalanga = bb ( pcolor::black, ptype::pawn ) & bb ( pcolor::black, ptype::pawn ).shift ( compass::e );
+            pawn_value += PHALANGA * ( white_phalanga.popcount () - black_phalanga.popcount () );
+        }
+
+        /* Incorporate backwards pawns into value */
+        {
+            const bitboard white_backward_pawns = white_strong_squares.shift ( compass::s ) & bb ( pcolor::white, ptype::pawn );
+            const bitboard black_backward_pawns = black_strong_squares.shift ( compass::n ) & bb ( pcolor::black, ptype::pawn );
+            pawn_value += BACKWARD_PAWNS * ( white_backward_pawns.popcount () - black_backward_pawns.popcount () );
+        }
+
+        /* Incorporate passed pawns into value */
+        {
+            const bitboard white_passed_pawns_distance = white_passed_pawns.fill ( compass::s );
+            const bitboard black_passed_pawns_distance = black_passed_pawns.fill ( compass::n );
+            pawn_value += PASSED_PAWNS_DISTANCE * ( white_passed_pawns_distance.popcount () - black_passed_pawns_distance.popcount () );
+        }
+
+        /* Store the entry */
+        pawn_entry = pawn_hash_entry_t { pawn_key, white_pawn_file_fill, black_pawn_file_fill, white_passed_pawns, black_passed_pawns, white_pawn_attacks, black_pawn_attacks, pawn_value };
+    }
 
-    /* Get the pawn file fills (from the rear span and forwards fill) */
-    const bitboard white_pawn_file_fill = white_pawn_rear_span | bb ( pcolor::white, ptype::pawn ).fill ( compass::n );
-    const bitboard black_pawn_file_fill = black_pawn_rear_span | bb ( pcolor::black, ptype::pawn ).fill ( compass::s );
+    /* Get the pawn file fills */
+    const bitboard white_pawn_file_fill = pawn_entry.white_file_fill;
+    const bitboard black_pawn_file_fill = pawn_entry.black_file_fill;
 
     /* Get the open and semiopen files. White semiopen files contain no white pawns. */
     const bitboard open_files = ~( white_pawn_file_fill | black_pawn_file_fill );
@@ -570,8 +634,8 @@ int chess::chessboard::evaluate ( pcolor pc )
     const bitboard black_semiopen_files = ~black_pawn_file_fill & white_pawn_file_fill;
 
     /* Get the passed pawns */
-    const bitboard white_passed_pawns = bb ( pcolor::white, ptype::pawn ) & ~white_pawn_rear_span & black_semiopen_files & black_semiopen_files.shift ( compass::e ) & black_semiopen_files.shift ( compass::w );
-    const bitboard black_passed_pawns = bb ( pcolor::black, ptype::pawn ) & ~black_pawn_rear_span & white_semiopen_files & white_semiopen_files.shift ( compass::e ) & white_semiopen_files.shift ( compass::w );
+    const bitboard white_passed_pawns = pawn_entry.white_passed_pawns;
+    const bitboard black_passed_pawns = pawn_entry.black_passed_pawns;
 
     /* Get the cells behind passed pawns. 
      * This is the span between the passed pawns and the next piece back, including the next piece back but not the pawn.
@@ -589,8 +653,8 @@ int chess::chessboard::evaluate ( pcolor pc )
 
     /* ACCUMULATORS */
 
-    /* The value of the evaluation function */
-    int value = 0;
+    /* The value of the evaluation function, starting with the material and piece-square values from the eval accumulator */
+    int value = game_state_history.back ().accumulator.psqt_value;
 
     /* Mobilities */
     int white_mobility = 0, black_mobility = 0;
@@ -623,17 +687,38 @@ int chess::chessboard::evaluate ( pcolor pc )
 
     /* NON-PINNED SLIDING PIECES */
 
-    /* Deal with non-pinned sliding pieces of both colors in one go.
+    /* Deal with non-pinned sliding pieces of both colors in one go, using bitboard pairs so that each operation is applied to white and black together.
      * If in double check, check_vectors_dep_check_count will remove all attacks the attacks.
      */ 
 
     /* Scope new bitboards */
     {        
-        /* Set straight and diagonal pieces */
-        const bitboard white_straight_pieces = ( bb ( pcolor::white, ptype::queen ) | bb ( pcolor::white, ptype::rook   ) ) & ~white_check_info.pin_vectors;
-        const bitboard white_diagonal_pieces = ( bb ( pcolor::white, ptype::queen ) | bb ( pcolor::white, ptype::bishop ) ) & ~white_check_info.pin_vectors;
-        const bitboard black_straight_pieces = ( bb ( pcolor::black, ptype::queen ) | bb ( pcolor::black, ptype::rook   ) ) & ~black_check_info.pin_vectors;
-        const bitboard black_diagonal_pieces = ( bb ( pcolor::black, ptype::queen ) | bb ( pcolor::black, ptype::bishop ) ) & ~black_check_info.pin_vectors;
+        /* Set straight and diagonal pieces, as pairs of white then black */
+        const bitboard_pair straight_pieces
+        {
+            ( bb ( pcolor::white, ptype::queen ) | bb ( pcolor::white, ptype::rook ) ) & ~white_check_info.pin_vectors,
+            ( bb ( pcolor::black, ptype::queen ) | bb ( pcolor::black, ptype::rook ) ) & ~black_check_info.pin_vectors
+        };
+        const bitboard_pair diagonal_pieces
+        {
+            ( bb ( pcolor::white, ptype::queen ) | bb ( pcolor::white, ptype::bishop ) ) & ~white_check_info.pin_vectors,
+            ( bb ( pcolor::black, ptype::queen ) | bb ( pcolor::black, ptype::bishop ) ) & ~black_check_info.pin_vectors
+        };
+
+        /* Pair the sets that the attacks of each color are intersected with.
+         * The sets of enemy pieces are in the opposite order, so that each color's attacks meet the other color's pieces.
+         */
+        const bitboard_pair legalize_attacks { white_legalize_attacks, black_legalize_attacks };
+        const bitboard_pair paired_open_files { open_files };
+        const bitboard_pair semiopen_files { white_semiopen_files, black_semiopen_files };
+        const bitboard_pair center { white_center, black_center };
+        const bitboard_pair paired_restrictives { restrictives };
+        const bitboard_pair enemy_restrictives { black_restrictives, white_restrictives };
+        const bitboard_pair enemy_straight_pieces { bb ( pcolor::black, ptype::queen ) | bb ( pcolor::black, ptype::rook ), bb ( pcolor::white, ptype::queen ) | bb ( pcolor::white, ptype::rook ) };
+        const bitboard_pair enemy_passed_pawn_trajectories { black_passed_pawn_trajectories, white_passed_pawn_trajectories };
+
+        /* The pairs to accumulate the defence unions and restrictives attacked by diagonal pieces into */
+        bitboard_pair partial_defence_union, restrictives_legally_attacked_by_diagonal_pieces;
 
         /* Start compasses */
         straight_compass straight_dir;
@@ -651,53 +736,45 @@ int chess::chessboard::evaluate ( pcolor pc )
             /* Apply all shifts to get straight and diagonal general attacks (note that sp is universe to get general attacks)
              * This allows us to union to the defence set first.
              */
-            bitboard white_straight_attacks = white_straight_pieces.rook_attack   ( straight_dir, pp, ~bitboard {} );
-            bitboard white_diagonal_attacks = white_diagonal_pieces.bishop_attack ( diagonal_dir, pp, ~bitboard {} );
-            bitboard black_straight_attacks = black_straight_pieces.rook_attack   ( straight_dir, pp, ~bitboard {} );
-            bitboard black_diagonal_attacks = black_diagonal_pieces.bishop_attack ( diagonal_dir, pp, ~bitboard {} );
+            bitboard_pair straight_attacks = straight_pieces.rook_attack   ( straight_dir, bitboard_pair { pp }, bitboard_pair { ~bitboard {} } );
+            bitboard_pair diagonal_attacks = diagonal_pieces.bishop_attack ( diagonal_dir, bitboard_pair { pp }, bitboard_pair { ~bitboard {} } );
 
             /* Union defence */
-            white_partial_defence_union |= white_straight_attacks | white_diagonal_attacks;
-            black_partial_defence_union |= black_straight_attacks | black_diagonal_attacks;
+            partial_defence_union |= straight_attacks | diagonal_attacks;
 
             /* Legalize the attacks */
-            white_straight_attacks &= white_legalize_attacks;
-            white_diagonal_attacks &= white_legalize_attacks;
-            black_straight_attacks &= black_legalize_attacks;
-            black_diagonal_attacks &= black_legalize_attacks;
+            straight_attacks &= legalize_attacks;
+            diagonal_attacks &= legalize_attacks;
 
             /* Sum mobility */
-            white_mobility += white_straight_attacks.popcount () + white_diagonal_attacks.popcount ();
-            black_mobility += black_straight_attacks.popcount () + black_diagonal_attacks.popcount ();
+            white_mobility += straight_attacks.first  ().popcount () + diagonal_attacks.first  ().popcount ();
+            black_mobility += straight_attacks.second ().popcount () + diagonal_attacks.second ().popcount ();
 
-            /* Sum rook attacks on open files */
-            straight_legal_attacks_open_diff += ( white_straight_attacks & open_files ).popcount ();
-            straight_legal_attacks_open_diff -= ( black_straight_attacks & open_files ).popcount ();
-
-            /* Sum rook attacks on semiopen files */
-            straight_legal_attacks_semiopen_diff += ( white_straight_attacks & white_semiopen_files ).popcount ();
-            straight_legal_attacks_semiopen_diff -= ( black_straight_attacks & black_semiopen_files ).popcount ();
+            /* Sum rook attacks on open and semiopen files */
+            straight_legal_attacks_open_diff     += ( straight_attacks & paired_open_files ).popcount_diff ();
+            straight_legal_attacks_semiopen_diff += ( straight_attacks & semiopen_files    ).popcount_diff ();
 
             /* Sum attacks on the center */
-            center_legal_attacks_by_restrictives_diff += ( white_straight_attacks & white_center ).popcount () + ( white_diagonal_attacks & white_center ).popcount ();
-            center_legal_attacks_by_restrictives_diff -= ( black_straight_attacks & black_center ).popcount () + ( black_diagonal_attacks & black_center ).popcount ();
+            center_legal_attacks_by_restrictives_diff += ( straight_attacks & center ).popcount_diff () + ( diagonal_attacks & center ).popcount_diff ();
 
             /* Union restrictives attacked by diagonal pieces */
-            restrictives_legally_attacked_by_white_diagonal_pieces |= restrictives & white_diagonal_attacks;
-            restrictives_legally_attacked_by_black_diagonal_pieces |= restrictives & black_diagonal_attacks;
+            restrictives_legally_attacked_by_diagonal_pieces |= paired_restrictives & diagonal_attacks;
 
             /* Sum the restricted captures by diagonal pieces */
-            diagonal_restricted_captures_diff += ( white_diagonal_attacks & black_restrictives ).popcount ();
-            diagonal_restricted_captures_diff -= ( black_diagonal_attacks & white_restrictives ).popcount ();
+            diagonal_restricted_captures_diff += ( diagonal_attacks & enemy_restrictives ).popcount_diff ();
 
             /* Sum the legal captures on enemy straight pieces by diagonal pieces */
-            diagonal_or_knight_captures_on_straight_diff += ( white_diagonal_attacks & ( bb ( pcolor::black, ptype::queen ) | bb ( pcolor::black, ptype::rook ) ) ).popcount ();
-            diagonal_or_knight_captures_on_straight_diff -= ( black_diagonal_attacks & ( bb ( pcolor::white, ptype::queen ) | bb ( pcolor::white, ptype::rook ) ) ).popcount ();
+            diagonal_or_knight_captures_on_straight_diff += ( diagonal_attacks & enemy_straight_pieces ).popcount_diff ();
 
             /* Sum the legal attacks on passed pawn trajectories */
-            legal_attacks_on_passed_pawn_trajectories_diff += ( white_straight_attacks & black_passed_pawn_trajectories ).popcount () + ( white_diagonal_attacks & black_passed_pawn_trajectories ).popcount ();
-            legal_attacks_on_passed_pawn_trajectories_diff -= ( black_straight_attacks & white_passed_pawn_trajectories ).popcount () + ( black_diagonal_attacks & white_passed_pawn_trajectories ).popcount ();
+            legal_attacks_on_passed_pawn_trajectories_diff += ( straight_attacks & enemy_passed_pawn_trajectories ).popcount_diff () + ( diagonal_attacks & enemy_passed_pawn_trajectories ).popcount_diff ();
         }
+
+        /* Separate the pairs */
+        white_partial_defence_union = partial_defence_union.first  ();
+        black_partial_defence_union = partial_defence_union.second ();
+        restrictives_legally_attacked_by_white_diagonal_pieces = restrictives_legally_attacked_by_diagonal_pieces.first  ();
+        restrictives_legally_attacked_by_black_diagonal_pieces = restrictives_legally_attacked_by_diagonal_pieces.second ();
     }
 
 
@@ -819,25 +896,6 @@ int chess::chessboard::evaluate ( pcolor pc )
 
 
 
-        /* Incorperate the material cost into value */
-        value += BISHOP * ( bb ( pcolor::white, ptype::bishop ).popcount () - bb ( pcolor::black, ptype::bishop ).popcount () );
-        value += ROOK   * ( bb ( pcolor::white, ptype::rook   ).popcount () - bb ( pcolor::black, ptype::rook   ).popcount () );
-        value += QUEEN  * ( bb ( pcolor::white, ptype::queen  ).popcount () - bb ( pcolor::black, ptype::queen  ).popcount () );
-
-        /* Incorporate straight pieces on 7th (or 2nd) rank into value */
-        {
-            const bitboard white_straight_pieces_7th_rank = white_straight_pieces & bitboard { bitboard::masks::rank_7 };
-            const bitboard black_straight_pieces_2nd_rank = black_straight_pieces & bitboard { bitboard::masks::rank_2 };
-            value += STRAIGHT_PIECES_ON_7TH_RANK * ( white_straight_pieces_7th_rank.popcount () - black_straight_pieces_2nd_rank.popcount () );
-        }
-
-        /* Incorporate bishops on initial cells into value */
-        {
-            const bitboard white_initial_bishops = bb ( pcolor::white, ptype::bishop ) & white_bishop_initial_cells;
-            const bitboard black_initial_bishops = bb ( pcolor::black, ptype::bishop ) & black_bishop_initial_cells;
-            value += BISHOP_OR_KNIGHT_INITIAL_CELL * ( white_initial_bishops.popcount () - black_initial_bishops.popcount () );
-        }
-
         /* Incorporate double bishops into value */
         value += DOUBLE_BISHOP * ( ( bb ( pcolor::white, ptype::bishop ).popcount () == 2 ) - ( bb ( pcolor::black, ptype::bishop ).popcount () == 2 ) );
 
@@ -919,24 +977,6 @@ int chess::chessboard::evaluate ( pcolor pc )
             legal_attacks_on_passed_pawn_trajectories_diff -= ( knight_attacks & white_passed_pawn_trajectories ).popcount ();
         }
 
-
-
-        /* Incorperate the number of knights into value */
-        value += KNIGHT * ( bb ( pcolor::white, ptype::knight ).popcount () - bb ( pcolor::black, ptype::knight ).popcount () );
-
-        /* Incorporate knights on initial cells into value */
-        {
-            const bitboard white_initial_knights = bb ( pcolor::white, ptype::knight ) & white_knight_initial_cells;
-            const bitboard black_initial_knights = bb ( pcolor::black, ptype::knight ) & black_knight_initial_cells;
-            value += BISHOP_OR_KNIGHT_INITIAL_CELL * ( white_initial_knights.popcount () - black_initial_knights.popcount () );
-        }
-
-        /* Incorporate knights in the venter into value */
-        {
-            const bitboard white_center_knights = bb ( pcolor::white, ptype::knight ) & white_center;
-            const bitboard black_center_knights = bb ( pcolor::black, ptype::knight ) & black_center;
-            value += CENTER_KNIGHTS * ( white_center_knights.popcount () - black_center_knights.popcount () );
-        }
     }
 
 
@@ -969,9 +1009,9 @@ int chess::chessboard::evaluate ( pcolor pc )
         const bitboard white_pawn_pushes = ( white_non_pinned_pawns.pawn_push_n ( pp ) | ( white_straight_pinned_pawns.pawn_push_n ( pp ) & white_check_info.straight_pin_vectors ) ) & white_check_info.check_vectors_dep_check_count;
         const bitboard black_pawn_pushes = ( black_non_pinned_pawns.pawn_push_s ( pp ) | ( black_straight_pinned_pawns.pawn_push_s ( pp ) & black_check_info.straight_pin_vectors ) ) & black_check_info.check_vectors_dep_check_count;
 
-        /* Get general pawn attacks */
-        const bitboard white_pawn_attacks = bb ( pcolor::white, ptype::pawn ).pawn_attack ( diagonal_compass::ne ) | bb ( pcolor::white, ptype::pawn ).pawn_attack ( diagonal_compass::nw );
-        const bitboard black_pawn_attacks = bb ( pcolor::black, ptype::pawn ).pawn_attack ( diagonal_compass::se ) | bb ( pcolor::black, ptype::pawn ).pawn_attack ( diagonal_compass::sw );
+        /* Get general pawn attacks from the pawn hash table entry */
+        const bitboard white_pawn_attacks = pawn_entry.white_attacks;
+        const bitboard black_pawn_attacks = pawn_entry.black_attacks;
 
         /* Get the strong squares.
          * These are the squares attacked by a friendly pawn, but not by an enemy pawn.
@@ -1029,49 +1069,14 @@ int chess::chessboard::evaluate ( pcolor pc )
         white_mobility += white_pawn_pushes.popcount () + white_pawn_captures_e.popcount () + white_pawn_captures_w.popcount ();
         black_mobility += black_pawn_pushes.popcount () + black_pawn_captures_e.popcount () + black_pawn_captures_w.popcount ();
 
-        /* Incorporate the number of pawns into value */
-        value += PAWN * ( bb ( pcolor::white, ptype::pawn ).popcount () - bb ( pcolor::black, ptype::pawn ).popcount () );
-
-        /* Incorporate the number of cells generally attacked by pawns into value */
-        value += PAWN_GENERAL_ATTACKS * ( white_pawn_attacks.popcount () - black_pawn_attacks.popcount () );
-
-        /* Incorporate strong squares into value */
-        value += STRONG_SQUARES * ( white_strong_squares.popcount () - black_strong_squares.popcount () );
+        /* Incorporate the pawn structure from the pawn hash table entry into value */
+        value += pawn_entry.value;
 
         /* Sum the legal attacks on passed pawn trajectories.
          * Use pawn general attacks, since legal captures require there to be a piece present.
          */
         legal_attacks_on_passed_pawn_trajectories_diff += ( white_pawn_attacks & black_passed_pawn_trajectories ).popcount () - ( black_pawn_attacks & white_passed_pawn_trajectories ).popcount ();
 
-        /* Incorperate the number of pawns in the center to value */
-        {
-            const bitboard white_center_pawns = bb ( pcolor::white, ptype::pawn ) & white_center;
-            const bitboard black_center_pawns = bb ( pcolor::black, ptype::pawn ) & black_center;
-            value += CENTER_PAWNS * ( white_center_pawns.popcount () - black_center_pawns.popcount () );
-        }
-
-        /* Incororate the number of center cells generally attacked by pawns into value */
-        {
-            const bitboard white_center_defence = white_pawn_attacks & white_center;
-            const bitboard black_center_defence = black_pawn_attacks & black_center;
-            value += PAWN_CENTER_GENERAL_ATTACKS * ( white_center_defence.popcount () - black_center_defence.popcount () );
-        }
-
-        /* Incorporate isolated pawns, and those on semiopen files, into value */
-        {
-            const bitboard white_isolated_pawns = bb ( pcolor::white, ptype::pawn ) & ~( white_pawn_file_fill.shift ( compass::e ) | white_pawn_file_fill.shift ( compass::w ) );
-            const bitboard black_isolated_pawns = bb ( pcolor::black, ptype::pawn ) & ~( black_pawn_file_fill.shift ( compass::e ) | black_pawn_file_fill.shift ( compass::w ) );
-            value += ISOLATED_PAWNS * ( white_isolated_pawns.popcount () - black_isolated_pawns.popcount () );
-            value += ISOLATED_PAWNS_ON_SEMIOPEN_FILES * ( ( white_isolated_pawns & white_semiopen_files ).popcount () - ( black_isolated_pawns & black_semiopen_files ).popcount () );
-        }
-
-        /* Incorporate the number of doubled pawns into value */
-        {
-            const bitboard white_doubled_pawns = bb ( pcolor::white, ptype::pawn ) & white_pawn_rear_span;
-            const bitboard black_doubled_pawns = bb ( pcolor::black, ptype::pawn ) & black_pawn_rear_span;
-            value += DOUBLED_PAWNS * ( white_doubled_pawns.popcount () - black_doubled_pawns.popcount () );
-        }
-
         /* Incorporate the number of cells adjacent to enemy king, which are generally attacked by pawns, into value */
         {
             const bitboard white_pawn_defence_adj_op_king = white_pawn_attacks & black_king_span;
@@ -1079,13 +1084,6 @@ int chess::chessboard::evaluate ( pcolor pc )
             value += PAWN_GENERAL_ATTACKS_ADJ_OP_KING * ( white_pawn_defence_adj_op_king.popcount () - black_pawn_defence_adj_op_king.popcount () );
         }
 
-        /* Incorporate phalanga into value */
-        {
-            const bitboard white_phalanga = bb ( pcolor::white, ptype::pawn ) & bb ( pcolor::white, ptype::pawn ).shift ( compass::e );
-            const bitboard black_phalanga = bb ( pcolor::black, ptype::pawn ) & bb ( pcolor::black, ptype::pawn ).shift ( compass::e );
-            value += PHALANGA * ( white_phalanga.popcount () - black_phalanga.popcount () );
-        }
-
         /* Incorporate blocked passed pawns into value */
         {
             const bitboard white_blocked_passed_pawns = white_behind_passed_pawns.shift ( compass::n ).shift ( compass::n ) & bb ( pcolor::black );
@@ -1093,26 +1091,12 @@ int chess::chessboard::evaluate ( pcolor pc )
             value += BLOCKED_PASSED_PAWNS * ( white_blocked_passed_pawns.popcount () - black_blocked_passed_pawns.popcount () );
         }
 
-        /* Incorporate backwards pawns into value */
-        {
-            const bitboard white_backward_pawns = white_strong_squares.shift ( compass::s ) & bb ( pcolor::white, ptype::pawn );
-            const bitboard black_backward_pawns = black_strong_squares.shift ( compass::n ) & bb ( pcolor::black, ptype::pawn );
-            value += BACKWARD_PAWNS * ( white_backward_pawns.popcount () - black_backward_pawns.popcount () );
-        }
-
         /* Incorporate bishops or knights on strong squares into value */
         {
             const bitboard white_bishop_or_knight_strong_squares = white_strong_squares & ( bb ( pcolor::white, ptype::bishop ) | bb ( pcolor::white, ptype::knight ) );
             const bitboard black_bishop_or_knight_strong_squares = black_strong_squares & ( bb ( pcolor::black, ptype::bishop ) | bb ( pcolor::black, ptype::knight ) );
             value += BISHOP_OR_KNIGHT_ON_STRONG_SQUARE * ( white_bishop_or_knight_strong_squares.popcount () - black_bishop_or_knight_strong_squares.popcount () );
         }
-
-        /* Incorporate passed pawns into value */
-        {
-            const bitboard white_passed_pawns_distance = white_passed_pawns.fill ( compass::s );
-            const bitboard black_passed_pawns_distance = black_passed_pawns.fill ( compass::n );
-            value += PASSED_PAWNS_DISTANCE * ( white_passed_pawns_distance.popcount () - black_passed_pawns_distance.popcount () );
-        }
     }
 
 
@@ -15,6 +15,10 @@
 /* INCLUDES */
 #include <louischessx/chessboard.h>
 
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+
 
 
 /* TYPE CHARACTER CONVERSION */
@@ -158,14 +162,14 @@ std::string chess::chessboard::fen_serialize_board ( const pcolor pc ) const
     }
 
     /* If there is not an en passant target sqaure, output a dash */
-    if ( !aux_info.en_passant_target ) out += "- "; else
+    if ( aux_info.en_passant_color == pcolor::no_piece ) out += "- "; else
     {
         /* Else output the en passant target square */
         out += bitboard::name_cell ( aux_info.en_passant_target ) + " ";
     }
 
-    /* TODO: Implement half-move clock since last capture or pawn push */
-    out += "0 ";
+    /* Add the halfmove clock */
+    out += std::to_string ( game_state_history.back ().halfmove_clock ) + " ";
 
     /* Add the fullmove mumber */
     out += std::to_string ( ( game_state_history.size () - 1 ) / 2 + 1 );
@@ -233,6 +237,10 @@ chess::pcolor chess::chessboard::fen_deserialize_board ( const std::string& desc
     /* Throw if file != 8 */
     if ( file != 8 ) throw chess_input_error { "Invalid file length in board state description in fen_deserialize_board ()." };
 
+    /* Throw if either color has more pieces than a game can reach, since the search stores at most that many move sets for each ply */
+    if ( cb.bb ( pcolor::white ).popcount () > ab_move_sets_t::MAX_MOVE_SETS || cb.bb ( pcolor::black ).popcount () > ab_move_sets_t::MAX_MOVE_SETS )
+        throw chess_input_error { "Too many pieces of one color in board state description in fen_deserialize_board ()." };
+
     /* Get the color who's move it is next */
     const pcolor pc = ( state_match.str ( 2 ) == "w" ? pcolor::white : pcolor::black );
 
@@ -242,13 +250,16 @@ chess::pcolor chess::chessboard::fen_deserialize_board ( const std::string& desc
     if ( !state_match.length ( 5 ) ) cb.set_kingside_castle_lost  ( pcolor::black );
     if ( !state_match.length ( 6 ) ) cb.set_queenside_castle_lost ( pcolor::black );
 
-    /* Set the en passant target square if given. Assume the color that made the move is opposite to pc */
-    if ( state_match.length ( 7 ) ) { cb.aux_info.en_passant_target = bitboard::cell_pos ( state_match.str ( 7 ) ); cb.aux_info.en_passant_color = other_color ( pc ); }
+    /* Set the en passant target square if given. The en passant color is the color which may capture, which is pc. */
+    if ( state_match.length ( 7 ) ) { cb.aux_info.en_passant_target = bitboard::cell_pos ( state_match.str ( 7 ) ); cb.aux_info.en_passant_color = pc; }
     
-    /* Ignore clocks for now */
+    /* Set the history of cb. The player who last moved is the opposite of pc, so that the Zobrist key includes the player to move. */
+    cb.game_state_history = { cb.get_game_state ( other_color ( pc ) ) };
 
-    /* Set the history of cb */
-    cb.game_state_history = { cb.get_game_state ( pcolor::no_piece ) };
+    /* Set the halfmove clock, throwing if it is out of range. Since there are no earlier states, there is nothing to limit the search for repetitions to. The fullmove number is ignored. */
+    int halfmove_clock = 0;
+    try { halfmove_clock = std::stoi ( state_match.str ( 8 ) ); } catch ( const std::exception& ) { throw chess_input_error { "Halfmove clock out of range in fen_deserialize_board ()." }; }
+    cb.game_state_history.back ().halfmove_clock = cb.game_state_history.back ().reversible_plies = halfmove_clock;
 
     /* Copy over the new chessboard */
     * this = cb;
@@ -273,9 +284,11 @@ chess::pcolor chess::chessboard::fen_deserialize_board_keep_history ( const std:
     /* Deserialize the FEN */
     const pcolor pc = fen_deserialize_board ( desc );
 
-    /* Copy back the history and replace the most recent state */
+    /* Copy back the history and replace the most recent state with the deserialized one, which includes its halfmove clock */
+    const game_state_t state = game_state_history.back ();
     game_state_history = std::move ( history );
-    game_state_history.back () = get_game_state ( other_color ( pc ) );
+    game_state_history.back () = state;
+    nnue_history.clear ();
 
     /* Return pc */
     return pc;
@@ -474,8 +487,8 @@ chess::move_t chess::chessboard::fide_deserialize_move ( const pcolor pc, const
     /* Get whether the other player is in check */
     move.check = cb.is_in_check ( other_color ( move.pc ) );
 
-    /* Get whether the other color has been checkmated */
-    move.checkmate = ( cb.evaluate ( move.pc ) == 10000 );
+    /* Get whether the other color has been checkmated, which only the handcrafted evaluation detects */
+    move.checkmate = ( cb.evaluate_handcrafted ( move.pc ) == 10000 );
 
 
 
@@ -492,22 +505,77 @@ chess::move_t chess::chessboard::fide_deserialize_move ( const pcolor pc, const
  * @brief  Create a string describing an alpha-beta search result, in the CECP format.
  *
  * @param  ab_result: The result to format.
+ * @param  ttable: The ttable the search used, from which the principal variation is read. If empty (the default), only the first move is given.
+ * @param  pv_index: The index of the root move in ab_result to describe. 0 (the best move) by default.
  * @return string
  */
-std::string chess::chessboard::get_cecp_thinking ( const ab_result_t& ab_result ) const
+std::string chess::chessboard::get_cecp_thinking ( const ab_result_t& ab_result, const ab_ttable_t& ttable, const std::size_t pv_index ) const
 {
-    /* If empty or incomplete, return an empty string */
-    if ( ab_result.incomplete || ab_result.moves.empty () ) return "";
+    /* If there is no such move, return an empty string */
+    if ( pv_index >= ab_result.moves.size () ) return "";
 
     /* Create the string */
     std::stringstream ss; ss
         << ab_result.depth << ' '
-        << ab_result.moves.front ().second << ' '
+        << ab_result.moves.at ( pv_index ).second << ' '
         << std::chrono::duration_cast<std::chrono::duration<long, std::centi>> ( ab_result.duration ).count () << ' '
         << ab_result.num_nodes + ab_result.num_q_nodes << ' '
         << ab_result.av_q_depth << ' '
-        << ab_result.ttable_hits << '\t'
-        << fide_serialize_move ( ab_result.moves.front ().first );
+        << ab_result.ttable_hits << '\t';
+
+    /* Add the principal variation, serializing each move on a copy of the board */
+    const std::vector<move_t> pv = get_pv ( ab_result.moves.at ( pv_index ).first.pc, ab_result.moves.at ( pv_index ).first, ttable );
+    chessboard board { * this };
+    for ( std::size_t i = 0; i < pv.size (); ++i ) { ss << ( i ? " " : "" ) << board.fide_serialize_move ( pv.at ( i ) ); board.make_move_internal ( pv.at ( i ) ); }
+
+    /* Return it */
+    return ss.str ();
+}
+
+
+
+/* SEARCH STATISTICS FORMATTING */
+
+
+
+/** @name  format, format_json
+ * 
+ * @brief  Format the statistics, either as human-readable lines each beginning with '#' (so they are xboard comments), or as a single-line JSON object.
+ * @return string
+ */
+std::string chess::chessboard::search_stats_t::format () const
+{
+    /* Get the total number of cutoffs, and a function to get a percentage */
+    const unsigned long long total_cutoffs = std::accumulate ( beta_cutoffs.begin (), beta_cutoffs.end (), 0ull );
+    auto percent = [] ( const unsigned long long part, const unsigned long long whole ) { return ( whole ? 100.0 * part / whole : 0.0 ); };
+
+    /* Create the string */
+    std::stringstream ss; ss << std::fixed << std::setprecision ( 1 )
+        << "# beta cutoffs = " << total_cutoffs << " (" << percent ( beta_cutoffs.front (), total_cutoffs ) << "% on the first move), by move index:";
+    for ( const unsigned long long cutoffs : beta_cutoffs ) ss << ' ' << cutoffs;
+    ss  << "\n# null moves = " << null_move_tries << ", cutoffs = " << null_move_cutoffs << " (" << percent ( null_move_cutoffs, null_move_tries ) << "%)"
+        << "\n# quiescence nodes not in check = " << delta_pruning_tries << ", lazy evaluation cutoffs = " << lazy_eval_cutoffs << ", delta prunes = " << delta_prunes << " (" << percent ( delta_prunes, delta_pruning_tries ) << "%)"
+        << "\n# ttable probes = " << ttable_probes << ", hits = " << ttable_hits << ", misses = " << ttable_probes - ttable_hits << ", collisions = " << ttable_collisions
+        << ", stores = " << ttable_stores << ", replacements = " << ttable_replacements
+        << "\n# static exchange evaluations = " << see_calls
+        << "\n# evaluations = " << eval_calls << " (" << std::chrono::duration<double, std::milli> { eval_time }.count () << "ms)"
+        << ", move generations = " << movegen_calls << " (" << std::chrono::duration<double, std::milli> { movegen_time }.count () << "ms)";
+
+    /* Return it */
+    return ss.str ();
+}
+std::string chess::chessboard::search_stats_t::format_json () const
+{
+    /* Create the string, with times in microseconds */
+    std::stringstream ss; ss << "{\"beta_cutoffs\":[";
+    for ( int i = 0; i < NUM_CUTOFF_BUCKETS; ++i ) ss << ( i ? "," : "" ) << beta_cutoffs [ i ];
+    ss  << "],\"null_move_tries\":" << null_move_tries << ",\"null_move_cutoffs\":" << null_move_cutoffs
+        << ",\"delta_pruning_tries\":" << delta_pruning_tries << ",\"lazy_eval_cutoffs\":" << lazy_eval_cutoffs << ",\"delta_prunes\":" << delta_prunes
+        << ",\"ttable_probes\":" << ttable_probes << ",\"ttable_hits\":" << ttable_hits << ",\"ttable_misses\":" << ttable_probes - ttable_hits << ",\"ttable_collisions\":" << ttable_collisions
+        << ",\"ttable_stores\":" << ttable_stores << ",\"ttable_replacements\":" << ttable_replacements
+        << ",\"see_calls\":" << see_calls
+        << ",\"eval_calls\":" << eval_calls << ",\"eval_time_us\":" << std::chrono::duration_cast<std::chrono::microseconds> ( eval_time ).count ()
+        << ",\"movegen_calls\":" << movegen_calls << ",\"movegen_time_us\":" << std::chrono::duration_cast<std::chrono::microseconds> ( movegen_time ).count () << '}';
 
     /* Return it */
     return ss.str ();
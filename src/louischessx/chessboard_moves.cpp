@@ -87,15 +87,40 @@ void chess::chessboard::make_move_internal ( const move_t& move ) chess_validate
     /* Get the aux info */
     const aux_info_t aux = aux_info;
 
+    /* Start the new Zobrist key from the previous one, removing the old aux info and last player, and adding the new last player */
+    std::uint64_t key = game_state_history.back ().key ^ zobrist_aux_key ( aux ) ^ zobrist_last_pc_key ( game_state_history.back ().last_pc ) ^ zobrist_last_pc_key ( move.pc );
+
+    /* The pawn key only changes if a pawn moves, is captured or is promoted */
+    std::uint64_t pawn_key = game_state_history.back ().pawn_key;
+
+    /* Start the new eval accumulator from the previous one */
+    eval_accumulator_t accumulator = game_state_history.back ().accumulator;
+
+    /* If the NNUE is the evaluator, make sure the current state has an NNUE accumulator to update, and record the features changed by the move.
+     * Otherwise discard any NNUE accumulators, since they would not be updated.
+     */
+    const bool use_nnue = ( get_evaluator () == evaluator_t::nnue );
+    if ( use_nnue ) { if ( nnue_history.empty () ) nnue_history.push_back ( compute_nnue_accumulator () ); } else nnue_history.clear ();
+    nnue::feature_delta_t nnue_delta;
+
     /* If this is a null move, reset en passant variables, add to the history, sanity check and return */
     if ( move.pt == ptype::no_piece )
     {
         aux_info.en_passant_target = -1; aux_info.en_passant_color = pcolor::no_piece;
-        game_state_history.emplace_back ( * this, move.pc );
+        const int halfmove_clock = game_state_history.back ().halfmove_clock + 1;
+        game_state_history.emplace_back ( * this, move.pc, key ^ zobrist_aux_key ( aux_info ), pawn_key, accumulator );
+        game_state_history.back ().halfmove_clock = halfmove_clock;
+        if ( use_nnue ) push_nnue_accumulator ( nnue_delta );
         sanity_check_bbs ( move.pc );
         return;
     }
 
+    /* Move the piece in the key. The NNUE adds the promoted piece directly, so that no more than two features are added. */
+    key ^= zobrist_piece_key ( move.pc, move.pt, move.from ) ^ zobrist_piece_key ( move.pc, move.pt, move.to );
+    if ( move.pt == ptype::pawn ) pawn_key ^= zobrist_piece_key ( move.pc, ptype::pawn, move.from ) ^ zobrist_piece_key ( move.pc, ptype::pawn, move.to );
+    accumulator.psqt_value += psqt_value ( move.pc, move.pt, move.to ) - psqt_value ( move.pc, move.pt, move.from );
+    nnue_delta.remove ( move.pc, move.pt, move.from ); nnue_delta.add ( move.pc, ( move.promote_pt == ptype::no_piece ? move.pt : move.promote_pt ), move.to );
+
     /* Unset the original position of the piece */
     get_bb ( move.pc ).reset          ( move.from );
     get_bb ( move.pc, move.pt ).reset ( move.from );
@@ -109,6 +134,11 @@ void chess::chessboard::make_move_internal ( const move_t& move ) chess_validate
     {
         get_bb ( other_color ( move.pc ) ).reset              ( move.en_passant_capture_pos () );
         get_bb ( other_color ( move.pc ), ptype::pawn ).reset ( move.en_passant_capture_pos () );
+        key ^= zobrist_piece_key ( other_color ( move.pc ), ptype::pawn, move.en_passant_capture_pos () );
+        pawn_key ^= zobrist_piece_key ( other_color ( move.pc ), ptype::pawn, move.en_passant_capture_pos () );
+        accumulator.psqt_value -= psqt_value ( other_color ( move.pc ), ptype::pawn, move.en_passant_capture_pos () );
+        nnue_delta.remove ( other_color ( move.pc ), ptype::pawn, move.en_passant_capture_pos () );
+        --accumulator.num_pieces [ cast_penum ( other_color ( move.pc ) ) ];
     } else
 
     /* Else if this is a normal capture, remove any captured pieces */
@@ -116,6 +146,12 @@ void chess::chessboard::make_move_internal ( const move_t& move ) chess_validate
     {
         get_bb ( other_color ( move.pc ) ).reset                  ( move.to );
         get_bb ( other_color ( move.pc ), move.capture_pt ).reset ( move.to );
+        key ^= zobrist_piece_key ( other_color ( move.pc ), move.capture_pt, move.to );
+        if ( move.capture_pt == ptype::pawn ) pawn_key ^= zobrist_piece_key ( other_color ( move.pc ), ptype::pawn, move.to );
+        accumulator.psqt_value -= psqt_value ( other_color ( move.pc ), move.capture_pt, move.to );
+        nnue_delta.remove ( other_color ( move.pc ), move.capture_pt, move.to );
+        --accumulator.num_pieces [ cast_penum ( other_color ( move.pc ) ) ];
+        if ( move.capture_pt != ptype::pawn ) --accumulator.num_restrictives [ cast_penum ( other_color ( move.pc ) ) ];
     } else
 
     /* Else if the move is a kingside castle */
@@ -126,6 +162,9 @@ void chess::chessboard::make_move_internal ( const move_t& move ) chess_validate
         get_bb ( move.pc, ptype::rook ).reset ( move.pc == pcolor::white ? 7 : 63 );
         get_bb ( move.pc ).set                ( move.pc == pcolor::white ? 5 : 61 );
         get_bb ( move.pc, ptype::rook ).set   ( move.pc == pcolor::white ? 5 : 61 );
+        key ^= zobrist_piece_key ( move.pc, ptype::rook, move.pc == pcolor::white ? 7 : 63 ) ^ zobrist_piece_key ( move.pc, ptype::rook, move.pc == pcolor::white ? 5 : 61 );
+        accumulator.psqt_value += psqt_value ( move.pc, ptype::rook, move.pc == pcolor::white ? 5 : 61 ) - psqt_value ( move.pc, ptype::rook, move.pc == pcolor::white ? 7 : 63 );
+        nnue_delta.remove ( move.pc, ptype::rook, move.pc == pcolor::white ? 7 : 63 ); nnue_delta.add ( move.pc, ptype::rook, move.pc == pcolor::white ? 5 : 61 );
 
         /* Set the new castling rights */
         set_castle_made ( move.pc );
@@ -139,6 +178,9 @@ void chess::chessboard::make_move_internal ( const move_t& move ) chess_validate
         get_bb ( move.pc, ptype::rook ).reset ( move.pc == pcolor::white ? 0 : 56 );
         get_bb ( move.pc ).set                ( move.pc == pcolor::white ? 3 : 59 );
         get_bb ( move.pc, ptype::rook ).set   ( move.pc == pcolor::white ? 3 : 59 );
+        key ^= zobrist_piece_key ( move.pc, ptype::rook, move.pc == pcolor::white ? 0 : 56 ) ^ zobrist_piece_key ( move.pc, ptype::rook, move.pc == pcolor::white ? 3 : 59 );
+        accumulator.psqt_value += psqt_value ( move.pc, ptype::rook, move.pc == pcolor::white ? 3 : 59 ) - psqt_value ( move.pc, ptype::rook, move.pc == pcolor::white ? 0 : 56 );
+        nnue_delta.remove ( move.pc, ptype::rook, move.pc == pcolor::white ? 0 : 56 ); nnue_delta.add ( move.pc, ptype::rook, move.pc == pcolor::white ? 3 : 59 );
 
         /* Set the new castling rights */
         set_castle_made ( move.pc );
@@ -156,6 +198,10 @@ void chess::chessboard::make_move_internal ( const move_t& move ) chess_validate
     {
         get_bb ( move.pc, move.promote_pt ).set ( move.to );
         get_bb ( move.pc, ptype::pawn ).reset   ( move.to );
+        key ^= zobrist_piece_key ( move.pc, ptype::pawn, move.to ) ^ zobrist_piece_key ( move.pc, move.promote_pt, move.to );
+        pawn_key ^= zobrist_piece_key ( move.pc, ptype::pawn, move.to );
+        accumulator.psqt_value += psqt_value ( move.pc, move.promote_pt, move.to ) - psqt_value ( move.pc, ptype::pawn, move.to );
+        ++accumulator.num_restrictives [ cast_penum ( move.pc ) ];
     }
 
     /* If this move is a pawn double push, set the en passant target square and color */
@@ -165,13 +211,33 @@ void chess::chessboard::make_move_internal ( const move_t& move ) chess_validate
     /* Else reset en passant target square and color to -1 and no_piece */
     { aux_info.en_passant_target = -1; aux_info.en_passant_color = pcolor::no_piece; }
 
-    /* Push the new state to the history */
-    game_state_history.emplace_back ( * this, move.pc );
+    /* Advance the clocks, unless this move is a capture or pawn move, which can never be undone */
+    const bool irreversible = ( move.pt == ptype::pawn || move.capture_pt != ptype::no_piece );
+    const int halfmove_clock   = ( irreversible ? 0 : game_state_history.back ().halfmove_clock   + 1 );
+    const int reversible_plies = ( irreversible ? 0 : game_state_history.back ().reversible_plies + 1 );
+
+    /* Push the new state to the history, adding the new aux info to the key */
+    game_state_history.emplace_back ( * this, move.pc, key ^ zobrist_aux_key ( aux_info ), pawn_key, accumulator );
+    game_state_history.back ().halfmove_clock = halfmove_clock; game_state_history.back ().reversible_plies = reversible_plies;
+    if ( use_nnue ) push_nnue_accumulator ( nnue_delta );
 
     /* Sanity check */
     sanity_check_bbs ( move.pc );
 }
 
+/** @name  push_nnue_accumulator
+ * 
+ * @brief  Push the NNUE accumulator for a new state, by updating the most recent accumulator.
+ * @param  delta: The features changed since the most recent accumulator.
+ * @return void
+ */
+void chess::chessboard::push_nnue_accumulator ( const nnue::feature_delta_t& delta )
+{
+    /* Add an accumulator, then update it from the previous one, which is only safe to reference once the history has grown */
+    nnue_history.emplace_back ();
+    nnue::update_accumulator ( nnue_history [ nnue_history.size () - 2 ], nnue_history.back (), delta );
+}
+
 /** @name  unmake_move_internal
  * 
  * @brief  Unmake the last made move.
@@ -179,8 +245,9 @@ void chess::chessboard::make_move_internal ( const move_t& move ) chess_validate
  */
 void chess::chessboard::unmake_move_internal ()
 {
-    /* Pop this state from the history */
+    /* Pop this state from the history, and its NNUE accumulator if there is one */
     game_state_history.pop_back ();
+    if ( !nnue_history.empty () ) nnue_history.pop_back ();
 
     /* Copy over the color bitboards */
     get_bb ( pcolor::white ) = game_state_history.back ().bb ( pcolor::white );
@@ -461,14 +528,15 @@ chess::bitboard chess::chessboard::get_sliding_move_set ( const pcolor pc, const
     /* Set moves initially to empty */
     bitboard moves;
 
-    /* If is not a bishop, apply a straight flood span.
-     * If is not a rook, apply a diagonal flood span.
+    /* If is not a bishop, lookup the straight sliding attacks.
+     * If is not a rook, lookup the diagonal sliding attacks.
+     * Both are restricted to their (possibly pinned) attack lookups.
      */
-    if ( pt != ptype::bishop ) moves |= pt_bb.straight_flood_span ( ~bb () & straight_attack_lookup, ~bb ( pc ) & straight_attack_lookup );
-    if ( pt != ptype::rook   ) moves |= pt_bb.diagonal_flood_span ( ~bb () & diagonal_attack_lookup, ~bb ( pc ) & diagonal_attack_lookup );
+    if ( pt != ptype::bishop ) moves |= bitboard::straight_sliding_attack_lookup ( pos, bb () ) & straight_attack_lookup;
+    if ( pt != ptype::rook   ) moves |= bitboard::diagonal_sliding_attack_lookup ( pos, bb () ) & diagonal_attack_lookup;
 
-    /* Ensure that moves protected the king */
-    moves &= check_info.check_vectors_dep_check_count;
+    /* Remove friendly pieces and ensure that moves protected the king */
+    moves &= ~bb ( pc ) & check_info.check_vectors_dep_check_count;
 
     /* Return the move set */
     return moves;
@@ -521,6 +589,89 @@ chess::bitboard chess::chessboard::get_king_move_set ( const pcolor pc, const ch
 
 
 
+/* PERFT */
+
+
+
+/** @name  perft_internal
+ * 
+ * @brief  Count the leaf nodes of the tree of legal moves to a given depth.
+ * @param  pc: The color whose move it is next.
+ * @param  depth: The depth of the tree to count.
+ * @param  bulk_count: If true, the leaf nodes are counted from the move sets at depth 1, rather than by making each move.
+ * @param  divide: If not null, each root move and its number of leaf nodes will be appended to this vector.
+ * @return The number of leaf nodes.
+ */
+unsigned long long chess::chessboard::perft_internal ( const pcolor pc, const int depth, const bool bulk_count, std::vector<std::pair<move_t, unsigned long long>> * const divide )
+{
+    /* If the depth is 0, this is a leaf node */
+    if ( depth <= 0 ) return 1;
+
+    /* Get the other color, check info and the promotion rank */
+    const pcolor npc = other_color ( pc );
+    const check_info_t check_info = get_check_info ( pc );
+    const bitboard rank_8 { pc == pcolor::white ? bitboard::masks::rank_8 : bitboard::masks::rank_1 };
+
+    /* The number of leaf nodes */
+    unsigned long long nodes = 0;
+
+    /* A lambda to make a move, count the nodes below it, and unmake the move */
+    auto count_move = [ & ] ( const move_t& move )
+    {
+        make_move_internal ( move );
+        const unsigned long long move_nodes = perft_internal ( npc, depth - 1, bulk_count, nullptr );
+        unmake_move_internal ();
+        if ( divide ) divide->emplace_back ( move, move_nodes );
+        nodes += move_nodes;
+    };
+
+    /* Iterate through the pieces */
+    for ( const ptype pt : ptype_inc_value ) for ( bitboard pieces = bb ( pc, pt ); pieces; )
+    {
+        /* Get a position of a piece and reset it */
+        const int from = pieces.trailing_zeros ();
+        pieces.reset ( from );
+
+        /* Get the move set */
+        bitboard move_set = get_move_set ( pc, pt, from, check_info );
+
+        /* If bulk counting at depth 1, count the moves directly. Each pawn move to the final rank is four moves due to promotion. */
+        if ( bulk_count && depth == 1 && !divide )
+        {
+            nodes += move_set.popcount () + ( pt == ptype::pawn ? 3 * ( move_set & rank_8 ).popcount () : 0 );
+            continue;
+        }
+
+        /* Iterate through the individual moves */
+        while ( move_set )
+        {
+            /* Get the position of the next move and unset that bit */
+            const int to = move_set.trailing_zeros ();
+            move_set.reset ( to );
+
+            /* Find the capture type */
+            const ptype capture_pt = find_type ( npc, to );
+
+            /* Detect if this is a promotion, in which case try every promotion type */
+            if ( pt == ptype::pawn && rank_8.test ( to ) )
+                for ( const ptype promote_pt : { ptype::queen, ptype::rook, ptype::bishop, ptype::knight } ) count_move ( move_t { pc, pt, capture_pt, promote_pt, from, to } );
+            else
+
+            /* Detect if this is an en passant capture */
+            if ( pt == ptype::pawn && pc == aux_info.en_passant_color && to == aux_info.en_passant_target )
+                count_move ( move_t { pc, pt, ptype::pawn, ptype::no_piece, from, to } );
+
+            /* Else this is an ordinary move */
+            else count_move ( move_t { pc, pt, capture_pt, ptype::no_piece, from, to } );
+        }
+    }
+
+    /* Return the number of nodes */
+    return nodes;
+}
+
+
+
 /* SANITY CHECKS */
 
 
@@ -569,5 +720,8 @@ void chess::chessboard::sanity_check_bbs ( const pcolor _last_pc ) const chess_v
     /* Check the most recent history is correct */
     if ( game_state_t { * this, _last_pc } != game_state_history.back () ) throw chess_internal_error { "Sanity check failed." };
 
+    /* Check the most recent NNUE accumulator is correct, if there is one */
+    if ( !nnue_history.empty () && nnue_history.back () != compute_nnue_accumulator () ) throw chess_internal_error { "Sanity check failed." };
+
 #endif
 }
\ No newline at end of file
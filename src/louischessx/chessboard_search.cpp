@@ -14,62 +14,200 @@
 
 /* INCLUDES */
 #include <louischessx/chessboard.h>
+#include <louischessx/time_manager.h>
+#include <louischessx/tablebase.h>
 
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <memory>
+#include <thread>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
-/* TTABLE PURGING */
 
-/** @name  purge_ttable
+/* TTABLE */
+
+
+
+/** @name  size constructor
+ * 
+ * @brief  Allocates a new, empty table.
+ * @param  size_mb: The maximum size of the table in MB. The actual size will be the largest power-of-two number of buckets that fits.
+ */
+chess::chessboard::ab_ttable_t::ab_ttable_t ( const std::size_t size_mb )
+    : table { std::make_shared<table_t> () }
+{
+    /* Find the largest power of two number of buckets that fits in size_mb, with at least one bucket */
+    table->num_buckets = std::bit_floor ( std::max<std::size_t> ( ( size_mb << 20 ) / sizeof ( bucket_t ), 1 ) );
+
+    /* Allocate the buckets. The slots are value-initialized, so are all empty. */
+    table->buckets = new bucket_t [ table->num_buckets ] ();
+}
+
+/** @name  file constructor
+ * 
+ * @brief  Memory-maps a table previously written by save.
+ *         The mapping is private, so searches using the table never modify the file.
+ * @param  path: The path of the file to map.
+ * @throws chess_input_error if the file cannot be mapped, or was saved with a different format version or set of Zobrist keys.
+ */
+chess::chessboard::ab_ttable_t::ab_ttable_t ( const std::string& path )
+    : table { std::make_shared<table_t> () }
+{
+    /* Open the file and get its size */
+    const int fd = open ( path.c_str (), O_RDONLY );
+    if ( fd < 0 ) throw chess_input_error { "Failed to open transposition table file." };
+    struct stat file_stat;
+    if ( fstat ( fd, &file_stat ) < 0 || static_cast<std::size_t> ( file_stat.st_size ) < sizeof ( file_header_t ) + sizeof ( bucket_t ) ) 
+        { close ( fd ); throw chess_input_error { "Transposition table file is too small." }; }
+
+    /* Map the whole file, then close the descriptor, since the mapping keeps its own reference */
+    void * mapping = mmap ( nullptr, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+    close ( fd );
+    if ( mapping == MAP_FAILED ) throw chess_input_error { "Failed to map transposition table file." };
+    table->mapping = mapping; table->mapping_size = file_stat.st_size;
+
+    /* Validate the header. The mapping will be freed by the table destructor if this throws. */
+    const file_header_t& header = * static_cast<const file_header_t *> ( mapping );
+    if ( std::memcmp ( header.magic, FILE_MAGIC, sizeof ( FILE_MAGIC ) ) != 0 ) throw chess_input_error { "File is not a transposition table." };
+    if ( header.version != FILE_FORMAT_VERSION ) throw chess_input_error { "Transposition table file has a different format version." };
+    if ( header.zobrist_fingerprint != zobrist_fingerprint () ) throw chess_input_error { "Transposition table file was saved with different Zobrist keys." };
+    if ( !std::has_single_bit ( header.num_buckets ) || table->mapping_size != sizeof ( file_header_t ) + header.num_buckets * sizeof ( bucket_t ) ) 
+        throw chess_input_error { "Transposition table file has an invalid size." };
+
+    /* Set up the table. The buckets directly follow the header. */
+    table->buckets = reinterpret_cast<bucket_t *> ( static_cast<file_header_t *> ( mapping ) + 1 );
+    table->num_buckets = header.num_buckets;
+    table->generation = header.generation; table->min_keep_bk_depth = header.min_keep_bk_depth;
+}
+
+/** @name  table_t destructor
+ * 
+ * @brief  Frees or unmaps the buckets.
+ */
+chess::chessboard::ab_ttable_t::table_t::~table_t ()
+{
+    /* Unmap the file if mapped, otherwise delete the buckets */
+    if ( mapping ) munmap ( mapping, mapping_size ); else delete [] buckets;
+}
+
+/** @name  clear
+ * 
+ * @brief  Empty the table, without reallocating it. Should not be called while a search is using the table.
+ * @return void
+ */
+void chess::chessboard::ab_ttable_t::clear () noexcept
+{
+    /* Return if there is no table */
+    if ( !table ) return;
+
+    /* Empty every slot */
+    for ( std::size_t i = 0; i < table->num_buckets; ++i ) for ( slot_t& slot : table->buckets [ i ].slots )
+        { slot.data.store ( 0, std::memory_order_relaxed ); slot.check.store ( 0, std::memory_order_relaxed ); }
+
+    /* Reset the generation */
+    table->generation = 0; table->min_keep_bk_depth = 0;
+}
+
+/** @name  new_generation
  * 
- * @brief  Take a transposition table, and remove entries which are no longer reachable from the current board state.
- * @param  ttable: The transposition table to erase elements from.
- * @param  min_bk_depth: The minimum bk_depth for which an entry is allowed to stay.
- * @return A new ttable with unreachable positions erased.
+ * @brief  Age all of the entries currently in the table, so that they are favoured for replacement by entries from later searches.
+ * @param  min_bk_depth: Aged entries with a bk_depth less than this are considered empty for the purposes of replacement.
+ * @return void
  */
-chess::chessboard::ab_ttable_t chess::chessboard::purge_ttable ( ab_ttable_t ttable, const int min_bk_depth ) const
+void chess::chessboard::ab_ttable_t::new_generation ( const int min_bk_depth ) noexcept
 {
-    /* Erase elements */
-    std::erase_if ( ttable, [ this, min_bk_depth ] ( const ab_ttable_t::value_type& entry )
+    /* Return if there is no table */
+    if ( !table ) return;
+
+    /* Increment the generation and set the minimum bk_depth */
+    table->generation.fetch_add ( 1, std::memory_order_relaxed );
+    table->min_keep_bk_depth.store ( min_bk_depth, std::memory_order_relaxed );
+}
+
+
+
+/** @name  save
+ * 
+ * @brief  Write the table to a file, which can later be loaded with the file constructor. Should not be called while a search is using the table.
+ *         The file is written to a temporary path and then renamed, so a file currently mapped by any table is never truncated.
+ * @param  path: The path of the file to write.
+ * @throws chess_input_error if there is no table or the file cannot be written.
+ * @return void
+ */
+void chess::chessboard::ab_ttable_t::save ( const std::string& path ) const
+{
+    /* Throw if there is no table */
+    if ( !table ) throw chess_input_error { "Cannot save an empty transposition table handle." };
+
+    /* Create the header */
+    file_header_t header {};
+    std::memcpy ( header.magic, FILE_MAGIC, sizeof ( FILE_MAGIC ) ); header.version = FILE_FORMAT_VERSION;
+    header.generation = table->generation; header.min_keep_bk_depth = table->min_keep_bk_depth;
+    header.zobrist_fingerprint = zobrist_fingerprint (); header.num_buckets = table->num_buckets;
+
+    /* Write the header and buckets to the temporary file. The slots are lock-free atomics, so have the same representation as their values. */
+    static_assert ( std::atomic<std::uint64_t>::is_always_lock_free && sizeof ( bucket_t ) == sizeof ( file_header_t ), "Unexpected ttable bucket layout." );
+    const std::string temp_path = path + ".tmp";
     {
-        /* Erase if the depth is less than min_bk_depth */
-        if ( entry.second.bk_depth < min_bk_depth ) return true;
-
-        /* Erase if the count of any piece type is not the same */
-        for ( pcolor pc : { pcolor::white, pcolor::black } ) for ( ptype pt : ptype_inc_value ) if ( entry.first.bb ( pc, pt ).popcount () > bb ( pc, pt ).popcount () ) return true;
-
-        /* Purge if the entry has more castling rights */
-        if ( castle_made ( pcolor::white ) != entry.first.castle_made ( pcolor::white ) ) return true;
-        if ( castle_made ( pcolor::black ) != entry.first.castle_made ( pcolor::black ) ) return true;
-        if ( !has_kingside_castling_rights  ( pcolor::white ) && entry.first.has_kingside_castling_rights  ( pcolor::white ) ) return true;
-        if ( !has_queenside_castling_rights ( pcolor::white ) && entry.first.has_queenside_castling_rights ( pcolor::white ) ) return true;
-        if ( !has_kingside_castling_rights  ( pcolor::black ) && entry.first.has_kingside_castling_rights  ( pcolor::black ) ) return true;
-        if ( !has_queenside_castling_rights ( pcolor::black ) && entry.first.has_queenside_castling_rights ( pcolor::black ) ) return true;
-
-        /* Loop through the pawns in the ttable state, which are not present in the current state */
-        for ( bitboard moved_pawns = entry.first.bb ( pcolor::white, ptype::pawn ) & ~bb ( pcolor::white, ptype::pawn ); moved_pawns; )
-        {
-            /* Get the next pawn */
-            int pos = moved_pawns.trailing_zeros (); moved_pawns.reset ( pos );
+        std::ofstream file { temp_path, std::ios::binary | std::ios::trunc };
+        file.write ( reinterpret_cast<const char *> ( &header ), sizeof ( header ) );
+        file.write ( reinterpret_cast<const char *> ( table->buckets ), table->num_buckets * sizeof ( bucket_t ) );
+        if ( !file.flush () ) { std::remove ( temp_path.c_str () ); throw chess_input_error { "Failed to write transposition table file." }; }
+    }
 
-            /* If there is no pawn in the current state, which can feasibly reach pos and is not already in the ttable state, then purge this ttable state */
-            if ( !( bitboard::pawn_pyramid_s_lookup ( pos ) & bb ( pcolor::white, ptype::pawn ) & ~entry.first.bb ( pcolor::white, ptype::pawn ) ) ) return true;
-        }
+    /* Replace the file */
+    if ( std::rename ( temp_path.c_str (), path.c_str () ) != 0 ) { std::remove ( temp_path.c_str () ); throw chess_input_error { "Failed to replace transposition table file." }; }
+}
+
+
+
+/** @name  purge_ttable
+ * 
+ * @brief  Age the entries of a transposition table from previous searches in place, so that they are favoured for replacement.
+ *         This only starts a new generation, so is cheap, and is safe while other searches are using the table.
+ * @param  ttable: The transposition table to age.
+ * @param  min_bk_depth: The minimum bk_depth for which an aged entry is not considered empty.
+ * @return void
+ */
+void chess::chessboard::purge_ttable ( ab_ttable_t& ttable, const int min_bk_depth ) const
+{
+    /* Start a new generation */
+    ttable.new_generation ( min_bk_depth );
+}
 
-        /* Do the same for black */
-        for ( bitboard moved_pawns = entry.first.bb ( pcolor::black, ptype::pawn ) & ~bb ( pcolor::black, ptype::pawn ); moved_pawns; )
-        {
-            int pos = moved_pawns.trailing_zeros (); moved_pawns.reset ( pos );
-            if ( !( bitboard::pawn_pyramid_n_lookup ( pos ) & bb ( pcolor::black, ptype::pawn ) & ~entry.first.bb ( pcolor::black, ptype::pawn ) ) ) return true;
-        }
 
-        /* Do not delete */
-        return false;
-    } );
 
-    /* Return ttable */
-    return ttable;
+/* SEARCH STATISTICS */
+
+
+
+/** @name  operator+=
+ * 
+ * @brief  Accumulate the statistics of another search.
+ * @param  other: The statistics to add.
+ * @return A reference to this object.
+ */
+chess::chessboard::search_stats_t& chess::chessboard::search_stats_t::operator+= ( const search_stats_t& other ) noexcept
+{
+    /* Add each of the counters */
+    for ( int i = 0; i < NUM_CUTOFF_BUCKETS; ++i ) beta_cutoffs [ i ] += other.beta_cutoffs [ i ];
+    null_move_tries     += other.null_move_tries;     null_move_cutoffs   += other.null_move_cutoffs;
+    delta_pruning_tries += other.delta_pruning_tries; lazy_eval_cutoffs   += other.lazy_eval_cutoffs; delta_prunes += other.delta_prunes;
+    ttable_probes       += other.ttable_probes;       ttable_hits         += other.ttable_hits;       ttable_collisions += other.ttable_collisions;
+    ttable_stores       += other.ttable_stores;       ttable_replacements += other.ttable_replacements;
+    see_calls           += other.see_calls;
+    eval_calls          += other.eval_calls;          eval_time           += other.eval_time;
+    movegen_calls       += other.movegen_calls;       movegen_time        += other.movegen_time;
+
+    /* Return this object */
+    return * this;
 }
 
 
@@ -78,49 +216,91 @@ chess::chessboard::ab_ttable_t chess::chessboard::purge_ttable ( ab_ttable_t tta
 
 
 
+/** @name  new_search
+ * 
+ * @brief  Reset the counters and results of the previous search, and age the move ordering tables.
+ *         The history table is halved. The killer moves are shifted to the same fd_depths from the new root if it follows from the previous root, and cleared otherwise.
+ * @param  game_state_history: The game state history of the board, whose last state is the new root.
+ * @return void
+ */
+void chess::chessboard::ab_working_t::new_search ( const std::vector<game_state_t>& game_state_history ) noexcept
+{
+    /* Reset the counters and results */
+    sum_q_depth = sum_moves = sum_q_moves = 0;
+    num_nodes = num_q_nodes = ttable_hits = tablebase_hits = 0;
+    max_q_depth = 0;
+    stats = search_stats_t {};
+    root_moves.clear ();
+
+    /* Halve the history table */
+    for ( auto& color_history : history ) for ( auto& from_history : color_history ) for ( int& entry : from_history ) entry /= 2;
+
+    /* If the new root follows from the previous root, shift the killer moves so that they stay at the same positions, otherwise clear them */
+    const bool follows = ( root_ply && game_state_history.size () >= root_ply && game_state_history.at ( root_ply - 1 ).key == root_key );
+    const std::size_t offset = ( follows ? std::min<std::size_t> ( game_state_history.size () - root_ply, MAX_FD_DEPTH ) : MAX_FD_DEPTH );
+    std::shift_left ( killer_moves.begin (), killer_moves.end (), offset );
+    std::fill ( killer_moves.end () - offset, killer_moves.end (), std::array<packed_move_t, 2> {} );
+}
+
+/** @name  is_search_move
+ * 
+ * @brief  Get whether a root move is one of the root moves to search.
+ * @param  move: The root move.
+ * @return boolean
+ */
+bool chess::chessboard::ab_working_t::is_search_move ( const move_t& move ) const noexcept
+{
+    /* Every move is searched if there are no search moves, otherwise compare including the promotion type */
+    return search_moves.empty () || std::any_of ( search_moves.begin (), search_moves.end (), [ & ] ( const move_t& other ) { return other.is_similar ( move ) && other.promote_pt == move.promote_pt; } );
+}
+
+
+
 /** @name  alpha_beta_search
  * 
  * @brief  Set up and apply the alpha-beta search.
  * @param  pc: The color whose move it is next.
  * @param  depth: The number of moves that should be made by individual colors. Returns evaluate () at depth = 0.
  * @param  best_only: If true, the search will be optimised as only the best move is returned.
- * @param  ttable: The transposition table to use for the search. Empty by default.
+ * @param  ttable: The transposition table to use for the search, which is shared with any other searches using it. If empty, a table of the default size is allocated into it.
  * @param  end_flag: A stop token which will end the search. Can be unspecified.
  * @param  end_point: A time point at which the search will be automatically stopped. Never by default.
  * @param  alpha: The maximum value pc has discovered, defaults to an abitrarily large negative integer.
  * @param  beta:  The minimum value not pc has discovered, defaults to an abitrarily large positive integer.
+ * @param  thinking: A function called whenever the best root move changes during the search, with a partial result (see alpha_beta_iterative_deepening). Not called by default.
+ * @param  max_nodes: The number of nodes (including quiescence nodes) after which the search will be automatically stopped. Unlimited by default.
+ * @param  search_moves: If not empty, only these root moves are searched, so that the root moves can be shared between several searches. Empty by default.
  * @return ab_result_t
  */
-chess::chessboard::ab_result_t chess::chessboard::alpha_beta_search ( const pcolor pc, const int depth, const bool best_only, ab_ttable_t ttable, const std::stop_token& end_flag, const chess_clock::time_point end_point, const int alpha, const int beta )
+chess::chessboard::ab_result_t chess::chessboard::alpha_beta_search ( const pcolor pc, const int depth, const bool best_only, ab_ttable_t& ttable, const std::stop_token& end_flag, const chess_clock::time_point end_point, const int alpha, const int beta,
+    const ab_thinking_callback_t& thinking, const unsigned long long max_nodes, const std::vector<move_t>& search_moves )
 {
-    /* Allocate ab_working */
-    ab_working = std::make_unique<ab_working_t> ();
+    /* Allocate ab_working if this board has not been searched before, otherwise prepare it for a new search */
+    if ( !ab_working ) ab_working = std::make_unique<ab_working_t> (); else ab_working->new_search ( game_state_history );
 
 	/* Set parameters */
 	ab_working->best_only = best_only;
 	ab_working->end_flag  = end_flag;
 	ab_working->end_point = end_point;
-
-    /* Allocate excess memory  */
-    ab_working->move_sets.resize ( 32 );
-    ab_working->killer_moves.resize ( 32 );
+    ab_working->max_nodes = max_nodes;
+    ab_working->thinking  = ( thinking ? &thinking : nullptr );
+    ab_working->search_moves = search_moves;
 
     /* Reserve excess memory for root moves */
     ab_working->root_moves.reserve ( 32 );
 
-    /* Move over ttable */
-    ab_working->ttable = std::move ( ttable );
+    /* Use ttable, allocating a new one if the handle is empty */
+    if ( !ttable ) ttable = ab_ttable_t { ab_ttable_t::DEFAULT_SIZE_MB };
+    ab_working->ttable = &ttable;
 
     /* Reset counters */
     ab_working->sum_q_depth = ab_working->sum_moves = ab_working->sum_q_moves = ab_working->num_nodes = ab_working->num_q_nodes = 0;
 
-    /* Get the largest fd_depth at which a draw state could occur (with a maximum of 4) */
-    for ( int i = 4; i >= 1 && !ab_working->draw_max_fd_depth; --i ) if ( game_state_history.size () >= 9 - i )
-        if ( game_state_history.at ( game_state_history.size () - 9 + i ) == game_state_history.at ( game_state_history.size () - 5 + i ) ) ab_working->draw_max_fd_depth = i;
-
-    /* Call and time the internal method */
-    const auto t0 = chess_clock::now ();
-    alpha_beta_search_internal ( pc, depth, alpha, beta );
+    /* Call and time the internal method, unless the root moves can be valued from the tablebases */
+    const auto t0 = ab_working->start_point = chess_clock::now ();
+    std::optional<std::vector<std::pair<move_t, int>>> tablebase_moves = ( tablebase::can_probe ( * this ) ? tablebase::probe_root ( * this, pc ) : std::nullopt );
+    if ( tablebase_moves && !search_moves.empty () ) std::erase_if ( * tablebase_moves, [ this ] ( const auto& move ) { return !ab_working->is_search_move ( move.first ); } );
+    if ( tablebase_moves ) ab_working->root_moves = std::move ( * tablebase_moves ); else alpha_beta_search_internal ( pc, depth, alpha, beta );
     const auto t1 = chess_clock::now ();
 
     /* Create the ab result struct */
@@ -131,17 +311,20 @@ chess::chessboard::ab_result_t chess::chessboard::alpha_beta_search ( const pcol
     ab_result.depth       = depth;
     ab_result.num_nodes   = ab_working->num_nodes;
     ab_result.num_q_nodes = ab_working->num_q_nodes;
+    ab_result.total_nodes = ab_working->num_nodes + ab_working->num_q_nodes;
     ab_result.av_q_depth  = ab_working->sum_q_depth / static_cast<double> ( ab_working->num_q_nodes );
     ab_result.av_moves    = ab_working->sum_moves   / static_cast<double> ( ab_working->num_nodes   );
     ab_result.av_q_moves  = ab_working->sum_q_moves / static_cast<double> ( ab_working->num_q_nodes );
     ab_result.max_q_depth = ab_working->max_q_depth;
     ab_result.ttable_hits = ab_working->ttable_hits;
-    ab_result.incomplete  = ab_working->end_flag.stop_requested() || chess_clock::now () > end_point;
+    ab_result.tablebase_hits = ab_working->tablebase_hits;
+    ab_result.tablebase   = tablebase_moves.has_value ();
+    ab_result.incomplete  = ab_working->end_flag.stop_requested() || chess_clock::now () > end_point || ab_working->num_nodes + ab_working->num_q_nodes >= max_nodes;
     ab_result.duration    = t1 - t0;
-    ab_result.ttable      = std::move ( ab_working->ttable );
+    ab_result.stats       = ab_working->stats;
 
-    /* Delete the working values */
-    ab_working.reset ( nullptr );
+    /* Remember the root, so that the next search can tell if it follows from this one */
+    ab_working->root_ply = game_state_history.size (); ab_working->root_key = game_state_history.back ().key;
 
     /* If there are no possible moves, return now */
     if ( ab_result.moves.empty () ) return ab_result;
@@ -172,9 +355,9 @@ chess::chessboard::ab_result_t chess::chessboard::alpha_beta_search ( const pcol
         unmake_move_internal ();
     }
 
-    /* Set failed low and failed high flags */
-    ab_result.failed_low  = ab_result.moves.back  ().second <= alpha;
-    ab_result.failed_high = ab_result.moves.front ().second >= beta;
+    /* Set failed low and failed high flags. Tablebase values are exact, so never fail. */
+    ab_result.failed_low  = !ab_result.tablebase && ab_result.moves.back  ().second <= alpha;
+    ab_result.failed_high = !ab_result.tablebase && ab_result.moves.front ().second >= beta;
 
     /* Return the alpha beta result */
     return ab_result;
@@ -193,47 +376,80 @@ chess::chessboard::ab_result_t chess::chessboard::alpha_beta_search ( const pcol
  * @param  pc: The color whose move it is next.
  * @param  depths: A list of depth values to search.
  * @param  best_only: If true, the search will be optimised as only the best move is returned.
- * @param  ttable: The transposition table to use for the search. Empty by default.
+ * @param  ttable: The transposition table to use for the search, which is shared with any other searches using it. If empty, a table of the default size is allocated into it.
  * @param  end_flag: A stop token which will end the search. Can be unspecified.
  * @param  end_point: A time point at which the search will be automatically stopped. Never by default.
- * @param  cecp_thinking: An atomic boolean, which when set to true will cause information on the search to be printed after each iteration. False by default.
+ * @param  thinking: A function called with the result of each completed depth. It is also called whenever the best root move changes during a depth,
+ *         with a partial result which is marked incomplete and contains only the new best move. Called on the searching thread. Not called by default.
  * @param  finish_first: If true, always wait for the lowest depth search to finish, regardless of end_point or end_flag. True by default.
+ * @param  num_threads: The number of threads to search with. Helper threads search copies of the board, sharing only the ttable (Lazy SMP). 1 by default.
+ * @param  max_nodes: The number of nodes over every depth after which the search will be automatically stopped, like end_point. Since it is independent of the speed of the machine,
+ *         a single-threaded search with a node budget (and a cleared ttable) is reproducible. Helper threads are not counted. Unlimited by default.
+ * @param  time_control: A time manager which is told the result of each depth, and whose soft end point (if earlier than end_point) decides whether to start the next depth.
+ *         end_point should then be its hard end point. None by default.
+ * @param  search_moves: If not empty, only these root moves are searched (see alpha_beta_search). Helper threads search every root move. Empty by default.
  * @return ab_result_t
  */
-chess::chessboard::ab_result_t chess::chessboard::alpha_beta_iterative_deepening ( const pcolor pc, const std::vector<int>& depths, const bool best_only, ab_ttable_t ttable, const std::stop_token& end_flag, const chess_clock::time_point end_point, const std::atomic_bool& cecp_thinking, const bool finish_first )
+chess::chessboard::ab_result_t chess::chessboard::alpha_beta_iterative_deepening ( const pcolor pc, const std::vector<int>& depths, const bool best_only, ab_ttable_t& ttable, const std::stop_token& end_flag, const chess_clock::time_point end_point, const ab_thinking_callback_t& thinking, const bool finish_first, const int num_threads,
+    const unsigned long long max_nodes, time_manager * const time_control, const std::vector<move_t>& search_moves )
 {
-    /* The result of the highest depth complete search */
+    /* Allocate a ttable if the handle is empty, so that there is a table to share with any helper threads */
+    if ( !ttable ) ttable = ab_ttable_t { ab_ttable_t::DEFAULT_SIZE_MB };
+
+    /* Start the helper threads.
+     * The helpers each run their own iterative deepening on a copy of the board, with their results only shared through the ttable.
+     * The helpers are stopped once this search ends (or on unwinding, since jthreads request stop and join on destruction), so may reference ttable.
+     */
+    std::vector<std::jthread> helpers;
+    for ( int i = 1; i < num_threads; ++i ) helpers.emplace_back ( [ board { * this }, pc, &depths, best_only, &ttable, end_point, i ] ( std::stop_token helper_end_flag ) mutable
+        { board.alpha_beta_helper ( pc, depths, best_only, ttable, helper_end_flag, end_point, i ); } );
+
+    /* The result of the highest depth complete search, and the statistics accumulated over every search */
     ab_result_t ab_result;
+    search_stats_t stats;
 
     /* Set aspiration window initially to minima and maxima. Also create counters for how many times the search has failed low and high. */
     int alpha = -20000, beta = 20000, failed_low_counter = 0, failed_high_counter = 0;
 
+    /* The number of nodes visited by the searches so far */
+    unsigned long long num_nodes = 0;
+
+    /* The effective branching factor, measured from the number of nodes of the latest two complete depths, which is used to predict the duration of the next depth */
+    double ebf = ab_search_t::DEFAULT_EBF;
+
     /* Iterate through the depths */
     for ( int i = 0; i < depths.size (); ++i )
     {
-        /* Run the search */
-        ab_result_t new_ab_result = alpha_beta_search ( pc, depths.at ( i ), best_only, std::move ( ttable ), end_flag, ( finish_first && i == 0 ? chess_clock::time_point::max () : end_point ), alpha, beta );
-
-        /* Extract the ttable from new_ab_result */
-        ttable = std::move ( new_ab_result.ttable );
+        /* Run the search with the remainder of the node budget. If finish_first is set, the first depth ignores end_flag, end_point and the node budget. */
+        const bool must_finish = ( finish_first && i == 0 );
+        const unsigned long long remaining_nodes = ( must_finish ? std::numeric_limits<unsigned long long>::max () : max_nodes - std::min ( num_nodes, max_nodes ) );
+        ab_result_t new_ab_result = alpha_beta_search ( pc, depths.at ( i ), best_only, ttable, ( must_finish ? std::stop_token {} : end_flag ), ( must_finish ? chess_clock::time_point::max () : end_point ), alpha, beta, thinking, remaining_nodes, search_moves );
+        num_nodes += new_ab_result.num_nodes + new_ab_result.num_q_nodes;
+        chess_stats ( stats += new_ab_result.stats; );
 
         /* If the search is incomplete, break */
         if ( new_ab_result.incomplete ) break;
 
         /* If the search failed high or low, increase alpha or beta */
-        if ( new_ab_result.failed_low  ) { alpha -= 100 * std::pow ( 5, failed_low_counter++  ); --i; } else
+        if ( new_ab_result.failed_low  ) { alpha -= 100 * std::pow ( 5, failed_low_counter++  ); --i; if ( time_control ) time_control->failed_low (); } else
         if ( new_ab_result.failed_high ) { beta  += 100 * std::pow ( 5, failed_high_counter++ ); --i; } else
 
         /* Else the search was successful */
         {
+            /* Measure the effective branching factor from the previous complete depth, if there was one */
+            const int depth_increase = new_ab_result.depth - ab_result.depth;
+            const unsigned long long last_depth_nodes = ab_result.num_nodes + ab_result.num_q_nodes, depth_nodes = new_ab_result.num_nodes + new_ab_result.num_q_nodes;
+            if ( last_depth_nodes && depth_increase > 0 ) ebf = std::clamp ( std::pow ( static_cast<double> ( depth_nodes ) / last_depth_nodes, 1.0 / depth_increase ), ab_search_t::MIN_EBF, ab_search_t::MAX_EBF );
+
             /* Set the latest result */
             ab_result = std::move ( new_ab_result );
 
-            /* Possibly output thinking info */
-            if ( cecp_thinking && !ab_result.moves.empty () ) std::cout << get_cecp_thinking ( ab_result ) << std::endl;
+            /* Give the result to the thinking function and the time manager, if there are any */
+            if ( thinking     && !ab_result.moves.empty () ) thinking ( ab_result );
+            if ( time_control && !ab_result.moves.empty () ) time_control->depth_complete ( ab_result );
 
-            /* If this is the last depth, there were no moves, or every move is a losing checkmate, or every move is a winning checkmate, break */
-            if ( i + 1 == depths.size () || ab_result.moves.empty () || ab_result.moves.front ().second <= -10000 || ab_result.moves.back ().second >= 10000 ) break;
+            /* If this is the last depth, there were no moves, the moves were valued from the tablebases, or every move is a losing checkmate, or every move is a winning checkmate, break */
+            if ( i + 1 == depths.size () || ab_result.moves.empty () || ab_result.tablebase || ab_result.moves.front ().second <= -10000 || ab_result.moves.back ().second >= 10000 ) break;
 
             /* Reset the failed low and high counters */
             failed_low_counter = failed_high_counter = 0;
@@ -253,19 +469,81 @@ chess::chessboard::ab_result_t chess::chessboard::alpha_beta_iterative_deepening
          * Note that if the last search was successful and this is the last search, the loop would have already ended.
          */
         const chess_clock::duration pred_duration =
-            std::chrono::duration_cast<chess_clock::duration> ( std::pow ( 3.0, depths.at ( i + 1 ) - ab_result.depth ) * ab_result.duration );
+            std::chrono::duration_cast<chess_clock::duration> ( std::pow ( ebf, depths.at ( i + 1 ) - ab_result.depth ) * ab_result.duration );
 
-        /* Force end the search now if this exceeds the end point */
-        if ( chess_clock::now () + pred_duration > end_point ) break;
+        /* Force end the search now if this exceeds the soft end point of the time manager or the end point, or if the node budget has been used */
+        const chess_clock::time_point soft_end_point = ( time_control ? std::min ( time_control->soft_end_point (), end_point ) : end_point );
+        if ( chess_clock::now () + pred_duration > soft_end_point || num_nodes >= max_nodes ) break;
     }
 
-    /* Move ttable back into ab_result */
-    ab_result.ttable = std::move ( ttable );
+    /* Stop all of the helpers, which will be joined on return */
+    for ( std::jthread& helper : helpers ) helper.request_stop ();
 
-    /* Return the result deepest complete search */
+    /* Return the result deepest complete search, with the accumulated statistics and node count */
+    ab_result.stats = stats;
+    ab_result.total_nodes = num_nodes;
     return ab_result;
 }
 
+/** @name  alpha_beta_helper
+ * 
+ * @brief  Run a Lazy SMP helper search, which contributes to any other search of the same position using the same ttable.
+ *         Since helpers share only the ttable, a helper may join a search of the position at any time, even mid-iteration.
+ *         Every other helper searches one ply deeper, so that the helpers are not all searching the same nodes in lockstep.
+ * @param  pc: The color whose move it is next.
+ * @param  depths: The list of depth values of the search being helped.
+ * @param  best_only: Whether the search being helped is optimised to only return the best move.
+ * @param  ttable: The transposition table of the search being helped.
+ * @param  end_flag: A stop token which will end the helper, which should be stopped when the search being helped ends.
+ * @param  end_point: A time point at which the helper will be automatically stopped. Never by default.
+ * @param  helper_index: The index of this helper, starting at 1.
+ * @return void
+ */
+void chess::chessboard::alpha_beta_helper ( const pcolor pc, std::vector<int> depths, const bool best_only, ab_ttable_t& ttable, const std::stop_token& end_flag, const chess_clock::time_point end_point, const int helper_index )
+{
+    /* Offset the depths and run the search, without waiting for the first depth to finish */
+    for ( int& depth : depths ) depth += helper_index % 2;
+    alpha_beta_iterative_deepening ( pc, depths, best_only, ttable, end_flag, end_point, {}, false );
+}
+
+/** @name  get_pv
+ * 
+ * @brief  Get the principal variation following a move, by following the best moves stored in a ttable.
+ *         The variation ends at a position with no legal best move stored, or once a position repeats.
+ * @param  pc: The color whose move it is next.
+ * @param  first_move: The first move of the variation.
+ * @param  ttable: The ttable to follow. May be empty, in which case the variation is only first_move.
+ * @param  max_length: The maximum number of moves in the variation. 16 by default.
+ * @return The moves of the variation, starting with first_move.
+ */
+std::vector<chess::move_t> chess::chessboard::get_pv ( pcolor pc, const move_t& first_move, const ab_ttable_t& ttable, const int max_length ) const
+{
+    /* Make the first move on a copy of the board */
+    chessboard board { * this };
+    std::vector<move_t> pv { first_move };
+    board.make_move_internal ( first_move ); pc = other_color ( pc );
+
+    /* Follow the best moves until there is none, or a position repeats (including the position the variation starts from) */
+    while ( ttable && pv.size () < max_length && !board.is_draw_state ( pv.size () + 1 ) )
+    {
+        /* Look up the best move, stopping if there is none */
+        const std::optional<ab_ttable_entry_t> ttable_entry = ttable.probe ( board.game_state_history.back ().key );
+        if ( !ttable_entry || !ttable_entry->best_move ) break;
+
+        /* Reconstruct the move. Since only a key is stored, stop if the move is not legal in case two states share a key. */
+        move_t move = board.unpack_move ( pc, ttable_entry->best_move );
+        if ( move.pt == ptype::no_piece || !board.get_move_set ( pc, move.pt, move.from, board.get_check_info ( pc ) ).test ( move.to ) ) break;
+
+        /* Make the move and add it to the variation, marking whether it gives check */
+        board.make_move_internal ( move ); pc = other_color ( pc );
+        move.check = board.is_in_check ( pc );
+        pv.push_back ( move );
+    }
+
+    /* Return the variation */
+    return pv;
+}
+
 
 
 /** AB_SEARCH_T IMPLEMENTATION */
@@ -300,43 +578,52 @@ chess::chessboard::ab_search_t::ab_search_t ( chessboard& board_, const pcolor p
     , rank_7 { pc == pcolor::white ? bitboard::masks::rank_7 : bitboard::masks::rank_2 }
     , rank_7_and_8 { rank_7 | rank_8 }
 
-    /* Boolean flags */
+    /* Boolean flags, using the piece counts from the eval accumulator */
     , endgame 
     { 
-        board.bb ( pcolor::white ).popcount () < ENDGAME_PIECES || board.bb ( pcolor::black ).popcount () < ENDGAME_PIECES
-        || ( board.bb ( pcolor::white, ptype::queen ) | board.bb ( pcolor::white, ptype::rook ) | board.bb ( pcolor::white, ptype::bishop ) | board.bb ( pcolor::white, ptype::knight ) ).popcount () <= 2
-        || ( board.bb ( pcolor::black, ptype::queen ) | board.bb ( pcolor::black, ptype::rook ) | board.bb ( pcolor::black, ptype::bishop ) | board.bb ( pcolor::black, ptype::knight ) ).popcount () <= 2
+        board.get_eval_accumulator ().num_pieces [ cast_penum ( pcolor::white ) ] < ENDGAME_PIECES || board.get_eval_accumulator ().num_pieces [ cast_penum ( pcolor::black ) ] < ENDGAME_PIECES
+        || board.get_eval_accumulator ().num_restrictives [ cast_penum ( pcolor::white ) ] <= 2 || board.get_eval_accumulator ().num_restrictives [ cast_penum ( pcolor::black ) ] <= 2
     }
-    , check_for_draw_cycle { !null_depth && bk_depth >= 1 && fd_depth <= ab_working->draw_max_fd_depth }
+    , check_for_draw { bk_depth >= 1 }
     , read_ttable { !null_depth && bk_depth >= TTABLE_MIN_BK_DEPTH && fd_depth <= TTABLE_MAX_FD_DEPTH }
-    , use_ttable_value { fd_depth >= TTABLE_USE_VALUE_MIN_FD_DEPTH && fd_depth >= ab_working->draw_max_fd_depth }
-    , store_ttable_value { fd_depth >= ab_working->draw_max_fd_depth }
+    , use_ttable_value { fd_depth >= TTABLE_USE_VALUE_MIN_FD_DEPTH }
     , use_delta_pruning { !endgame }
     , use_null_move 
     {
         !null_depth && bk_depth >= 1 && !endgame && !check_info.check_count && fd_depth >= NULL_MOVE_MIN_FD_DEPTH
-        && fd_depth >= ab_working->draw_max_fd_depth
         && bk_depth >= NULL_MOVE_MIN_LEFTOVER_BK_DEPTH + NULL_MOVE_CHANGE_BK_DEPTH
         && bk_depth <= NULL_MOVE_MAX_LEFTOVER_BK_DEPTH + NULL_MOVE_CHANGE_BK_DEPTH
     }
+    , use_pvs { bk_depth >= PVS_MIN_BK_DEPTH && ( fd_depth || ab_working->best_only ) }
+    , use_lmr { use_pvs && bk_depth >= LMR_MIN_BK_DEPTH && !check_info.check_count }
+    , use_reverse_futility { fd_depth && bk_depth >= 1 && bk_depth <= REVERSE_FUTILITY_MAX_BK_DEPTH && !check_info.check_count && !endgame }
+    , use_futility { fd_depth && bk_depth >= 1 && bk_depth <= FUTILITY_MAX_BK_DEPTH && !check_info.check_count }
 
     /* Non-constants */
     , alpha { alpha_ }
     , beta { beta_ }
     , best_value { -10000 - bk_depth }
-    , write_ttable { read_ttable }
+    , write_ttable { read_ttable && ( fd_depth || ab_working->search_moves.empty () ) }
     , ttable_best_move { false }
+    , num_moves_searched { 0 }
+    , num_late_moves_searched { 0 }
+    , searching_quiet_moves { false }
+    , searching_late_moves { false }
+    , static_eval { 0 }
+    , quiet_moves_futile { false }
+    , num_generated_pts { 0 }
+    , pc_can_move { false }
 {
     /* Throw if the opposing king is in check */
     #if CHESS_VALIDATE
-        if ( is_in_check ( npc ) ) throw chess_internal_error { "Opposing color is in check in alpha_beta_search_internal ()." };
+        if ( board.is_in_check ( npc ) ) throw chess_internal_error { "Opposing color is in check in alpha_beta_search_internal ()." };
     #endif
 
     /* add to the number of nodes visited */
     if ( bk_depth >= 1 ) ++ab_working->num_nodes; else { ab_working->sum_q_depth += fd_depth; ++ab_working->num_q_nodes; ab_working->max_q_depth = std::max ( ab_working->max_q_depth, fd_depth ); }
 
-    /* Clear the move sets, if this isn't the root node of iterative deepening */
-    for ( auto& moves : ab_working->move_sets.at ( fd_depth ) ) moves.clear ();
+    /* Clear the move sets */
+    ab_working->move_sets [ fd_depth ].clear ();
 }
 
 
@@ -348,10 +635,19 @@ chess::chessboard::ab_search_t::ab_search_t ( chessboard& board_, const pcolor p
  */
 int chess::chessboard::ab_search_t::search ()
 {
-    /* CHECK FOR A CYCLE */
+    /* CHECK FOR MAXIMUM DEPTH */
+
+    /* If there is no space for the move sets of deeper nodes, return the static evaluation */
+    if ( fd_depth == ab_working_t::MAX_FD_DEPTH - 1 ) return evaluate ();
 
-    /* Only if flagged to do so */
-    if ( check_for_draw_cycle && board.is_draw_state () ) return 0;
+
+
+    /* CHECK FOR A DRAW */
+
+    /* Only if flagged to do so. Any repetition of a state since the root is a draw, since it could be repeated again.
+     * Checkmate takes precedence over the fifty-move rule, so if in check, there must also be a legal move. This is rarely tested, since the state must first be a draw.
+     */
+    if ( check_for_draw && board.is_draw_state ( fd_depth ) && ( !check_info.check_count || board.has_mobility ( pc, check_info ) ) ) return 0;
 
 
 
@@ -361,53 +657,77 @@ int chess::chessboard::ab_search_t::search ()
     if ( read_ttable )
     {
         /* Try to find the state */
-        auto search_it = ab_working->ttable.find ( board.game_state_history.back () );
+        const std::optional<ab_ttable_entry_t> ttable_entry = ab_working->ttable->probe ( board.game_state_history.back ().key );
+        chess_stats ( ++ab_working->stats.ttable_probes; );
 
         /* See if an entry has been found */
-        if ( search_it != ab_working->ttable.end () )
+        if ( ttable_entry )
         {
             /* Extract the best move */
-            best_move.from = search_it->second.best_move_from;
-            best_move.to   = search_it->second.best_move_to;
-            best_move.pt   = board.find_type ( pc, best_move.from );
+            ttable_move = board.unpack_move ( pc, ttable_entry->best_move );
 
-            /* Set to have found a best move and increment the ttable hit counter */
-            ttable_best_move = best_move.pt != ptype::no_piece;
+            /* Set to have found a best move and increment the ttable hit counter.
+             * Since only a key is stored, check that the move is legal in case two states share a key.
+             */
+            ttable_best_move = ttable_move.pt != ptype::no_piece && board.get_move_set ( pc, ttable_move.pt, ttable_move.from, check_info ).test ( ttable_move.to );
             ++ab_working->ttable_hits;
+            chess_stats ( ++ab_working->stats.ttable_hits; if ( ttable_entry->best_move && !ttable_best_move ) ++ab_working->stats.ttable_collisions; );
 
             /* Must also have an equal or better bk_depth in the ttable entry to use its value */
-            if ( use_ttable_value && bk_depth <= search_it->second.bk_depth )
+            if ( use_ttable_value && bk_depth <= ttable_entry->bk_depth )
             {
                 /* If the bound is exact, return the bound.
                  * If it is a lower bound, modify alpha.
                  * If it is an upper bound, modify beta.
                  */
-                if ( search_it->second.bound == ab_ttable_entry_t::bound_t::exact ) return search_it->second.value;
-                if ( search_it->second.bound == ab_ttable_entry_t::bound_t::lower ) alpha = std::max ( alpha, search_it->second.value ); else
-                if ( search_it->second.bound == ab_ttable_entry_t::bound_t::upper ) beta  = std::min ( beta,  search_it->second.value );
+                if ( ttable_entry->bound == ab_ttable_entry_t::bound_t::exact ) return ttable_entry->value;
+                if ( ttable_entry->bound == ab_ttable_entry_t::bound_t::lower ) alpha = std::max ( alpha, ttable_entry->value ); else
+                if ( ttable_entry->bound == ab_ttable_entry_t::bound_t::upper ) beta  = std::min ( beta,  ttable_entry->value );
 
                 /* Possibly return now on an alpha-beta cutoff */
                 if ( alpha >= beta ) return alpha;
 
                 /* If we are deeper than the value in the ttable, then don't store new values in it */
-                if ( bk_depth < search_it->second.bk_depth ) write_ttable = false;
+                if ( bk_depth < ttable_entry->bk_depth ) write_ttable = false;
             }
         }
     }
 
 
 
+    /* TRY A TABLEBASE PROBE */
+
+    /* Don't probe at the root, where the moves are instead valued from the DTZ tables.
+     * Only probe when bk_depth is at least the probe depth, so that the time spent reading the tables stays bounded.
+     * The tablebase value is exact, so return it immediately.
+     */
+    if ( fd_depth >= 1 && bk_depth >= tablebase::get_probe_depth () && tablebase::can_probe ( board ) )
+        if ( const std::optional<int> tablebase_value = tablebase::probe_wdl ( board, pc, fd_depth ) ) { ++ab_working->tablebase_hits; return * tablebase_value; }
+
+
+
     /* CHECK FOR LEAF */
 
     /* If bk_depth is non-positive, start or continue with quiescence */
     if ( bk_depth <= 0 )
     {
-        /* Get static evaluation */
-        best_value = board.evaluate ( pc );
-
-        /* If not in check, try delta pruning */
+        /* If not in check, try lazy evaluation and delta pruning */
         if ( !check_info.check_count )
         {
+            /* Count the node */
+            chess_stats ( ++ab_working->stats.delta_pruning_tries; );
+
+            /* Get the lazy evaluation from the material and piece-square values of the eval accumulator */
+            const int lazy_value = board.get_eval_accumulator ().psqt_value * ( pc == pcolor::white ? 1 : -1 );
+
+            /* Return the lazy evaluation if it is so far above beta that the full evaluation will almost certainly be too.
+             * The margin only holds for the handcrafted evaluation, of which the lazy evaluation is a part.
+             */
+            if ( get_evaluator () == evaluator_t::handcrafted && lazy_value - LAZY_EVAL_MARGIN >= beta ) { chess_stats ( ++ab_working->stats.lazy_eval_cutoffs; ); return lazy_value; }
+
+            /* Get static evaluation */
+            best_value = evaluate ();
+
             /* Else return now if exceeding the max quiescence depth */
             if ( -bk_depth >= QUIESCENCE_MAX_Q_DEPTH ) return best_value;
 
@@ -421,9 +741,12 @@ int chess::chessboard::ab_search_t::search ()
             } ) + ( board.bb ( pc, ptype::pawn ) & rank_7 ).popcount () * 550;
 
             /* Or return on delta pruning if allowed */
-            if ( use_delta_pruning && best_value + quiescence_delta < alpha ) return best_value;
+            if ( use_delta_pruning && best_value + quiescence_delta < alpha ) { chess_stats ( ++ab_working->stats.delta_prunes; ); return best_value; }
         }
 
+        /* Else get static evaluation */
+        else best_value = evaluate ();
+
         /* Tune alpha to the static evaluation */
         alpha = std::max ( alpha, best_value );
 
@@ -433,13 +756,28 @@ int chess::chessboard::ab_search_t::search ()
 
 
 
+    /* TRY FUTILITY PRUNING */
+
+    /* Get the static evaluation if either form of futility pruning may be applied */
+    if ( use_reverse_futility || use_futility ) static_eval = evaluate ();
+
+    /* If the static evaluation is so far above beta that no move is likely to bring it back down, return beta (as for a null move) */
+    if ( use_reverse_futility && static_eval - REVERSE_FUTILITY_MARGIN * bk_depth >= beta ) return beta;
+
+    /* If the static evaluation is so far below alpha that no quiet move is likely to raise it, flag quiet moves to be skipped */
+    quiet_moves_futile = use_futility && static_eval + FUTILITY_MARGIN * bk_depth <= alpha;
+
+
+
     /* TRY NULL MOVE */
 
     /* If null move is possible, try it */
     if ( use_null_move )
     {
-        /* Make a null move */
+        /* Make a null move, which has no countermove */
+        chess_stats ( ++ab_working->stats.null_move_tries; );
         board.make_move_internal ( move_t { pc } );
+        ab_working->move_stack [ fd_depth ] = move_t {};
 
         /* Apply the null move */
         int score = -board.alpha_beta_search_internal ( npc, bk_depth - NULL_MOVE_CHANGE_BK_DEPTH, -beta, -beta + 1, fd_depth + 1, 1 );
@@ -451,7 +789,7 @@ int chess::chessboard::ab_search_t::search ()
          * This is because this position must be very powerful, so the other player is going to want to avoid it.
          * Don't return score, since the null move will cause extremes of values otherwise.
          */
-        if ( score >= beta ) return beta;
+        if ( score >= beta ) { chess_stats ( ++ab_working->stats.null_move_cutoffs; ); return beta; }
     }
 
 
@@ -459,57 +797,15 @@ int chess::chessboard::ab_search_t::search ()
     /* TRY BEST MOVE */
 
     /* Test if a best move has been found and try it if so */
-    if ( ttable_best_move ) if ( apply_move_set ( best_move.pt, best_move.from, singleton_bitboard ( best_move.to ) ) ) return best_value;
-
-
-
-    /* COLLATE MOVE SETS */
-    {
-        /* Store whether there are any possible moves */
-        bool pc_can_move = false;
-
-        /* Iterate through the pieces */
-        for ( const ptype pt : ptype_inc_value )
-        {
-            /* Iterate through pieces */
-            for ( bitboard pieces = board.bb ( pc, pt ); pieces; )
-            {
-                /* Get the position of the next piece and reset that bit.
-                * Favour the further away pieces to encourage them to move towards the other color.
-                */
-                const int pos = ( opposing_conc ? pieces.trailing_zeros () : 63 - pieces.leading_zeros () );
-                pieces.reset ( pos );
-
-                /* Get the move set */
-                const bitboard move_set = board.get_move_set ( pc, pt, pos, check_info );
-
-                /* Update pc_can_move */
-                pc_can_move |= move_set.is_nonempty ();
-
-                /* If the move set is non-empty or pt is the king, store the moves.
-                 * The king's move set must be present to search for castling moves.
-                 */
-                if ( move_set || pt == ptype::king ) access_move_sets ( pt ).emplace_back ( pos, move_set );
-            }
-        }
-
-        /* If there are no possible moves, return on a checkmate or stalemeate depending if in check or not */
-        if ( !pc_can_move ) { if ( check_info.check_count ) return -10000 - bk_depth; else return 0; }
-    }
-
-
-
-    /* REMOVE BEST MOVE */
-
-    /* If a best move was found, then it has already failed, so remove it from the move set */
-    if ( ttable_best_move ) for ( auto& move_set : access_move_sets ( best_move.pt ) )
-        if ( move_set.first == best_move.from && move_set.second.test ( best_move.to ) ) { move_set.second.reset ( best_move.to ); break; }
+    if ( ttable_best_move ) if ( apply_move_set ( ttable_move.pt, ttable_move.from, singleton_bitboard ( ttable_move.to ) ) ) return best_value;
 
 
 
     /* SEARCH */
 
-    /* Look for pawn moves that promote that pawn */
+    /* The move sets of each piece type are generated by access_move_sets as they are first needed, so that a cutoff on an early capture saves generating the rest.
+     * Look for pawn moves that promote that pawn.
+     */
     for ( auto& move_set : access_move_sets ( ptype::pawn ) )
     {
         /* Apply the move, then remove those bits */
@@ -517,8 +813,8 @@ int chess::chessboard::ab_search_t::search ()
         move_set.second &= ~rank_8;
     }
 
-    /* Loop through captees, most valuable to least valuable, only if there are pieces of that type */
-    for ( const ptype captee_pt : ptype_dec_value ) if ( board.bb ( npc, captee_pt ) )
+    /* Loop through captees, most valuable to least valuable, only if there are pieces of that type. The king can never be captured, so is skipped. */
+    for ( const ptype captee_pt : ptype_dec_value ) if ( captee_pt != ptype::king && board.bb ( npc, captee_pt ) )
     {
         /* Loop through captors, least valuable to most, and their move sets */
         for ( const ptype captor_pt : ptype_inc_value ) for ( auto& move_set : access_move_sets ( captor_pt ) )
@@ -530,6 +826,7 @@ int chess::chessboard::ab_search_t::search ()
                 const int captee_pos = captees.trailing_zeros (); captees.reset ( captee_pos );
 
                 /* If the captee is cheapter than the captor, and the static exchange is negative, disregard this capture for now */
+                chess_stats ( if ( cast_penum ( captee_pt ) < cast_penum ( captor_pt ) ) ++ab_working->stats.see_calls; );
                 if ( cast_penum ( captee_pt ) < cast_penum ( captor_pt ) && board.static_exchange_evaluation ( pc, captee_pos, captee_pt, move_set.first, captor_pt ) < 0 ) continue;
 
                 /* Try capturing, and return on alpha-beta cutoff */
@@ -543,20 +840,31 @@ int chess::chessboard::ab_search_t::search ()
 
 
 
+    /* Every remaining piece type is needed now, so generate their move sets.
+     * If there are no possible moves, return on a checkmate or stalemeate depending if in check or not.
+     * There cannot have been a move already tried, since there would have been a possible move.
+     */
+    generate_move_sets ( ptype::king );
+    if ( !pc_can_move ) { if ( check_info.check_count ) return -10000 - bk_depth; else return 0; }
+
+    /* The remaining moves are quiet moves, or captures which lose material */
+    searching_quiet_moves = true;
+
     /* Look for killer moves */
-    for ( const auto& killer_move : ab_working->killer_moves.at ( fd_depth ) )
+    for ( const packed_move_t killer_move : ab_working->killer_moves [ fd_depth ] )
     {
-        /* Loop through the move sets for the piece type of the killer move */
-        if ( killer_move.pt != ptype::no_piece ) for ( auto& move_set : access_move_sets ( killer_move.pt ) )
+        /* Loop through the move sets for the type of piece at the departure of the killer move, if there is one of pc */
+        const ptype killer_pt = ( killer_move ? board.find_type ( pc, killer_move.from () ) : ptype::no_piece );
+        if ( killer_pt != ptype::no_piece ) for ( auto& move_set : access_move_sets ( killer_pt ) )
         {
             /* See if this is the correct piece for the move */
-            if ( move_set.first == killer_move.from && move_set.second.test ( killer_move.to ) )
+            if ( move_set.first == killer_move.from () && move_set.second.test ( killer_move.to () ) )
             {
                 /* Apply the killer move and return on alpha-beta cutoff */
-                if ( apply_move_set ( killer_move.pt, killer_move.from, singleton_bitboard ( killer_move.to ) ) ) return best_value;
+                if ( apply_move_set ( killer_pt, killer_move.from (), singleton_bitboard ( killer_move.to () ) ) ) return best_value;
 
                 /* Unset that bit in the move set */
-                move_set.second.reset ( killer_move.to );
+                move_set.second.reset ( killer_move.to () );
 
                 /* killer move found, so break */
                 break;
@@ -584,11 +892,49 @@ int chess::chessboard::ab_search_t::search ()
         access_move_sets ( ptype::king ).front ().second.reset ( king_pos - 2 );
     }
 
-    /* If not quiescing or in check, iterate through piece types and their move sets to try the remaining moves */
-    if ( bk_depth >= 1 || check_info.check_count ) for ( const ptype pt : ptype_dec_move_value ) for ( const auto& move_set : access_move_sets ( pt ) )
+    /* The remaining moves are late moves */
+    searching_late_moves = true;
+
+    /* If not quiescing or in check, score and sort the remaining moves, then try them */
+    if ( bk_depth >= 1 || check_info.check_count )
     {
-        /* Try the move, and return on alpha-beta cutoff */
-        if ( apply_move_set ( pt, move_set.first, move_set.second ) ) return best_value;
+        /* Get the countermove to the previous move, if there was one */
+        const move_t& prev_move = ( fd_depth ? ab_working->move_stack [ fd_depth - 1 ] : move_t {} );
+        const packed_move_t countermove = ( prev_move.pt != ptype::no_piece ? ab_working->countermoves [ cast_penum ( pc ) ] [ cast_penum ( prev_move.pt ) ] [ prev_move.to ] : packed_move_t {} );
+
+        /* Get the scored moves for this depth, and the history table for pc */
+        ab_scored_moves_t& scored_moves = ab_working->scored_moves [ fd_depth ];
+        const auto& history = ab_working->history [ cast_penum ( pc ) ];
+
+        /* Expand the move sets, in the same piece order as before, scoring each move by its history, or as the countermove */
+        scored_moves.num_moves = 0;
+        for ( const ptype pt : ptype_dec_move_value ) for ( const auto& move_set : access_move_sets ( pt ) ) for ( bitboard move_set_bb = move_set.second; move_set_bb; )
+        {
+            /* Get the next destination, choosing motion towards the opposing color */
+            const int to = ( opposing_conc ? 63 - move_set_bb.leading_zeros () : move_set_bb.trailing_zeros () );
+            move_set_bb.reset ( to );
+
+            /* Store the move and its score. The countermove is always a normal move, so can be compared with the move packed without flags. */
+            const packed_move_t move { move_set.first, to };
+            scored_moves.scores [ scored_moves.num_moves ] = ( move == countermove ? COUNTERMOVE_SCORE : history [ move_set.first ] [ to ] );
+            scored_moves.moves  [ scored_moves.num_moves++ ] = move;
+        }
+
+        /* Insertion sort the moves by decreasing score. This is stable, so that moves with equal scores keep their piece order, and fast for so few moves. */
+        for ( int i = 1; i < scored_moves.num_moves; ++i )
+        {
+            const int score = scored_moves.scores [ i ]; const packed_move_t move = scored_moves.moves [ i ];
+            int j = i;
+            for ( ; j > 0 && scored_moves.scores [ j - 1 ] < score; --j ) { scored_moves.scores [ j ] = scored_moves.scores [ j - 1 ]; scored_moves.moves [ j ] = scored_moves.moves [ j - 1 ]; }
+            scored_moves.scores [ j ] = score; scored_moves.moves [ j ] = move;
+        }
+
+        /* Try the moves, finding the type of each moving piece from the board, and return on alpha-beta cutoff */
+        for ( int i = 0; i < scored_moves.num_moves; ++i )
+        {
+            const packed_move_t move = scored_moves.moves [ i ];
+            if ( apply_move_set ( board.find_type ( pc, move.from () ), move.from (), singleton_bitboard ( move.to () ) ) ) return best_value;
+        }
     }
 
 
@@ -596,23 +942,7 @@ int chess::chessboard::ab_search_t::search ()
     /* FINALLY */
 
     /* If is flagged to do so, add to the transposition table */
-    if ( write_ttable ) 
-    {
-        if ( store_ttable_value )
-            ab_working->ttable.insert_or_assign ( board.game_state_history.back(),
-                                                ab_ttable_entry_t{best_value, static_cast<char> ( bk_depth ),
-                                                                  (best_value <= orig_alpha
-                                                                   ? ab_ttable_entry_t::bound_t::upper
-                                                                   : ab_ttable_entry_t::bound_t::exact),
-                                                                  static_cast<char> ( best_move.from ),
-                                                                  static_cast<char> ( best_move.to )});
-        else
-            ab_working->ttable.insert_or_assign ( board.game_state_history.back(),
-                                                ab_ttable_entry_t{-10000 - bk_depth, static_cast<char> ( bk_depth ),
-                                                                  ab_ttable_entry_t::bound_t::lower,
-                                                                  static_cast<char> ( best_move.from ),
-                                                                  static_cast<char> ( best_move.to )});
-    }
+    if ( write_ttable ) store_ttable ( ab_ttable_entry_t { best_value, static_cast<char> ( bk_depth ), ( best_value <= orig_alpha ? ab_ttable_entry_t::bound_t::upper : ab_ttable_entry_t::bound_t::exact ), packed_move_t { best_move } } );
 
     /* Return the best value */
     return best_value;
@@ -628,30 +958,78 @@ int chess::chessboard::ab_search_t::search ()
  */
 bool chess::chessboard::ab_search_t::apply_move ( const move_t& move )
 {
+    /* If at the root node and this move is not one of the root moves to search, skip it */
+    if ( fd_depth == 0 && !ab_working->is_search_move ( move ) ) return false;
+
     /* Apply the move */
     board.make_move_internal ( move );
 
+    /* Get whether this is a quiet move which does not give check, only if it could be pruned or reduced */
+    const bool quiet = searching_quiet_moves && ( quiet_moves_futile || ( use_lmr && searching_late_moves ) )
+        && move.capture_pt == ptype::no_piece && move.promote_pt == ptype::no_piece && !board.is_in_check ( npc );
+
+    /* If quiet moves are futile, skip this move, with the futility bound as its value */
+    if ( quiet && quiet_moves_futile )
+    {
+        /* Unmake the move, update the best value and return */
+        board.unmake_move_internal ();
+        best_value = std::max ( best_value, static_eval + FUTILITY_MARGIN * bk_depth );
+        return false;
+    }
+
     /* Recursively call to get the value for this move.
      * Switch around and negate alpha and beta, since it is the other player's turn.
      * Since the next move is done by the other player, negate the value.
+     * If using PVS, moves after the first are first searched with a null window (reduced in depth if a late quiet move),
+     * then re-searched with full depth and the full window only if they beat alpha.
      */
-    const int new_value = -board.alpha_beta_search_internal ( npc, bk_depth - 1, -beta, -alpha, fd_depth + 1, ( null_depth ? null_depth + 1 : 0 ) );
+    ab_working->move_stack [ fd_depth ] = move;
+    int new_value;
+    if ( !use_pvs || num_moves_searched == 0 ) new_value = -board.alpha_beta_search_internal ( npc, bk_depth - 1, -beta, -alpha, fd_depth + 1, ( null_depth ? null_depth + 1 : 0 ) ); else
+    {
+        /* Get the reduction for the null window search */
+        const int reduction = ( quiet && use_lmr && searching_late_moves && num_late_moves_searched >= LMR_MIN_LATE_MOVES ? LMR_CHANGE_BK_DEPTH : 0 );
+
+        /* Search with a null window, then re-search at full depth and then with the full window if alpha is beaten */
+        new_value = -board.alpha_beta_search_internal ( npc, bk_depth - 1 - reduction, -alpha - 1, -alpha, fd_depth + 1, ( null_depth ? null_depth + 1 : 0 ) );
+        if ( reduction && new_value > alpha ) new_value = -board.alpha_beta_search_internal ( npc, bk_depth - 1, -alpha - 1, -alpha, fd_depth + 1, ( null_depth ? null_depth + 1 : 0 ) );
+        if ( new_value > alpha && new_value < beta ) new_value = -board.alpha_beta_search_internal ( npc, bk_depth - 1, -beta, -alpha, fd_depth + 1, ( null_depth ? null_depth + 1 : 0 ) );
+    }
 
     /* Unmake the move */
     board.unmake_move_internal ();
 
+    /* Count the move */
+    ++num_moves_searched; if ( searching_late_moves ) ++num_late_moves_searched;
+
     /* Set the best value and hence best move */
     if ( new_value > best_value ) { best_value = new_value; best_move = move; }
 
     /* Add to the number of moves made */
     if ( bk_depth >= 1 ) ++ab_working->sum_moves; else ++ab_working->sum_q_moves;
 
-    /* If end flag is set or past the end point, return true */
+    /* If end flag is set or past the end point, return true. The node budget is cheap enough to check at every depth, which keeps it exact. */
     if ( bk_depth >= END_CUTOFF_MIN_BK_DEPTH && ( ab_working->end_flag.stop_requested () || chess_clock::now () > ab_working->end_point ) ) return true;
+    if ( ab_working->num_nodes + ab_working->num_q_nodes >= ab_working->max_nodes ) return true;
 
     /* If at the root node, add to the root moves. */
     if ( fd_depth == 0 ) ab_working->root_moves.push_back ( std::make_pair ( move, new_value ) );
 
+    /* If at the root node, and this move has replaced the first move as the best move without failing high, give a partial result to the thinking function */
+    if ( fd_depth == 0 && ab_working->thinking && num_moves_searched > 1 && best_move == move && new_value < beta )
+    {
+        ab_result_t ab_result;
+        ab_result.moves       = { std::make_pair ( move, new_value ) };
+        ab_result.depth       = bk_depth;
+        ab_result.num_nodes   = ab_working->num_nodes;
+        ab_result.num_q_nodes = ab_working->num_q_nodes;
+        ab_result.av_q_depth  = ( ab_working->num_q_nodes ? ab_working->sum_q_depth / static_cast<double> ( ab_working->num_q_nodes ) : 0.0 );
+        ab_result.ttable_hits = ab_working->ttable_hits;
+        ab_result.incomplete  = true;
+        ab_result.duration    = chess_clock::now () - ab_working->start_point;
+        ( * ab_working->thinking ) ( ab_result );
+    }
+
     /* If the new best value is greater than alpha then:
      *     If this is not the root node, reassign alpha to the best value, else
      *     if this is the root node and best_only is true, reassign alpha to best value - 1 (-1 since this will avoid duplicate best values).
@@ -660,21 +1038,34 @@ bool chess::chessboard::ab_search_t::apply_move ( const move_t& move )
     if ( fd_depth ) alpha = std::max ( alpha, best_value ); else if ( ab_working->best_only ) alpha = std::max ( alpha, best_value - 1 );
     if ( alpha >= beta )
     {
-        /* If the move is not a capture and most recent killer move is not similar, update the killer moves */
-        if ( move.capture_pt == ptype::no_piece && !access_killer_move ( 0 ).is_similar ( move ) )
+        /* If the move is not a capture and most recent killer move is different, update the killer moves */
+        const packed_move_t packed_move { move };
+        if ( move.capture_pt == ptype::no_piece && access_killer_move ( 0 ) != packed_move )
         {
             /* Swap the killer moves */
             std::swap ( access_killer_move ( 0 ), access_killer_move ( 1 ) );
 
-            /* If the most recent killer move is still not similar, replace it */
-            if ( !access_killer_move ( 0 ).is_similar ( move ) ) access_killer_move ( 0 ) = move;
+            /* If the most recent killer move is still different, replace it */
+            if ( access_killer_move ( 0 ) != packed_move ) access_killer_move ( 0 ) = packed_move;
+        }
+
+        /* If the move is quiet and not quiescing, update the history and countermove tables */
+        if ( move.capture_pt == ptype::no_piece && move.promote_pt == ptype::no_piece && bk_depth >= 1 )
+        {
+            /* Add to the history of the move, halving the whole table for pc if the maximum is exceeded */
+            auto& history = ab_working->history [ cast_penum ( pc ) ];
+            if ( ( history [ move.from ] [ move.to ] += bk_depth * bk_depth ) > HISTORY_MAX ) for ( auto& from_history : history ) for ( int& entry : from_history ) entry /= 2;
+
+            /* Set the move as the countermove to the previous move, if there was one */
+            const move_t& prev_move = ( fd_depth ? ab_working->move_stack [ fd_depth - 1 ] : move_t {} );
+            if ( prev_move.pt != ptype::no_piece ) ab_working->countermoves [ cast_penum ( pc ) ] [ cast_penum ( prev_move.pt ) ] [ prev_move.to ] = packed_move;
         }
 
         /* If is flagged to do so, add to the transposition table as a lower bound */
-        if ( write_ttable ) if ( store_ttable_value )
-            ab_working->ttable.insert_or_assign ( board.game_state_history.back (), ab_ttable_entry_t { best_value, static_cast<char> ( bk_depth ), ab_ttable_entry_t::bound_t::lower, static_cast<char> ( best_move.from ), static_cast<char> ( best_move.to ) } );
-        else
-            ab_working->ttable.insert_or_assign ( board.game_state_history.back (), ab_ttable_entry_t { -10000 - bk_depth, static_cast<char> ( bk_depth ), ab_ttable_entry_t::bound_t::lower, static_cast<char> ( best_move.from ), static_cast<char> ( best_move.to ) } );
+        if ( write_ttable ) store_ttable ( ab_ttable_entry_t { best_value, static_cast<char> ( bk_depth ), ab_ttable_entry_t::bound_t::lower, packed_move_t { best_move } } );
+
+        /* Count the cutoff by the index of the move */
+        chess_stats ( ++ab_working->stats.beta_cutoffs [ std::min ( num_moves_searched, search_stats_t::NUM_CUTOFF_BUCKETS ) - 1 ]; );
 
         /* Return */
         return true;
@@ -735,11 +1126,68 @@ bool chess::chessboard::ab_search_t::apply_move_set ( const ptype pt, const int
 
 /** @name  access_move_sets
  *
- * @brief  Returns a reference to the array of moves for this depth
- * @param  pt: The piece to get the move array for
- * @return A reference to that array
+ * @brief  Returns the move sets of a piece type for this depth
+ * @param  pt: The piece to get the move sets for
+ * @return A span over those move sets
+ */
+std::span<std::pair<int, chess::bitboard>> chess::chessboard::ab_search_t::access_move_sets ( ptype pt )
+{
+    /* Generate the move sets if necessary, then return the range for pt */
+    if ( cast_penum ( pt ) >= num_generated_pts ) generate_move_sets ( pt );
+    ab_move_sets_t& move_sets = ab_working->move_sets [ fd_depth ]; return { move_sets.move_sets.data () + move_sets.ranges [ cast_penum ( pt ) ], move_sets.move_sets.data () + move_sets.ranges [ cast_penum ( pt ) + 1 ] };
+}
+
+/** @name  generate_move_sets
+ *
+ * @brief  Generate the move sets for this depth of every piece type up to and including pt, in the order of ptype, which have not already been generated.
+ *         Move sets are generated in order so that the range for each piece type is contiguous. The best move from the ttable is removed, since it is tried first.
+ * @param  pt: The last piece type to generate the move sets for
+ * @return void
  */
-std::vector<std::pair<int, chess::bitboard>>& chess::chessboard::ab_search_t::access_move_sets ( ptype pt ) { return ab_working->move_sets.at ( fd_depth ).at ( cast_penum ( pt ) ); };
+void chess::chessboard::ab_search_t::generate_move_sets ( const ptype last_pt )
+{
+    /* Time the generation */
+    chess_stats ( ++ab_working->stats.movegen_calls; const search_stats_t::scoped_timer_t movegen_timer { ab_working->stats.movegen_time }; );
+
+    /* Get the move sets for this depth, and the number of move sets stored so far */
+    ab_move_sets_t& move_sets = ab_working->move_sets [ fd_depth ];
+    int num_move_sets = ( num_generated_pts ? move_sets.ranges [ num_generated_pts ] : 0 );
+
+    /* Iterate through the piece types which have not been generated */
+    for ( ; num_generated_pts <= cast_penum ( last_pt ); ++num_generated_pts )
+    {
+        /* Get the piece type and set the start of its range */
+        const ptype pt = ptype_inc_value [ num_generated_pts ];
+        move_sets.ranges [ num_generated_pts ] = num_move_sets;
+
+        /* Iterate through pieces */
+        for ( bitboard pieces = board.bb ( pc, pt ); pieces; )
+        {
+            /* Get the position of the next piece and reset that bit.
+            * Favour the further away pieces to encourage them to move towards the other color.
+            */
+            const int pos = ( opposing_conc ? pieces.trailing_zeros () : 63 - pieces.leading_zeros () );
+            pieces.reset ( pos );
+
+            /* Get the move set, reusing the check info of this node */
+            bitboard move_set = board.get_move_set ( pc, pt, pos, check_info );
+
+            /* Update pc_can_move */
+            pc_can_move |= move_set.is_nonempty ();
+
+            /* If this piece made the best move from the ttable, it has already been tried, so remove it */
+            if ( ttable_best_move && ttable_move.pt == pt && ttable_move.from == pos ) move_set.reset ( ttable_move.to );
+
+            /* If the move set is non-empty or pt is the king, store the moves.
+             * The king's move set must be present to search for castling moves.
+             */
+            if ( move_set || pt == ptype::king ) move_sets.move_sets [ num_move_sets++ ] = { pos, move_set };
+        }
+
+        /* Set the end of the range */
+        move_sets.ranges [ num_generated_pts + 1 ] = num_move_sets;
+    }
+}
 
 /** @name  access_killer_move
  *
@@ -747,7 +1195,35 @@ std::vector<std::pair<int, chess::bitboard>>& chess::chessboard::ab_search_t::ac
  * @param  index: The index of the killer move (0 or 1)
  * @return The killer move
  */
-chess::move_t& chess::chessboard::ab_search_t::access_killer_move ( int index ) { return ab_working->killer_moves.at ( fd_depth ).at ( index ); };
+chess::packed_move_t& chess::chessboard::ab_search_t::access_killer_move ( int index ) { return ab_working->killer_moves [ fd_depth ] [ index ]; };
+
+/** @name  evaluate
+ *
+ * @brief  Statically evaluate the board for pc, timing the evaluation if CHESS_STATS is true.
+ * @return int
+ */
+int chess::chessboard::ab_search_t::evaluate ()
+{
+    /* Time the evaluation */
+    chess_stats ( ++ab_working->stats.eval_calls; const search_stats_t::scoped_timer_t eval_timer { ab_working->stats.eval_time }; );
+
+    /* Evaluate */
+    return board.evaluate ( pc );
+}
+
+/** @name  store_ttable
+ *
+ * @brief  Store an entry for the current state in the ttable, counting the store if CHESS_STATS is true.
+ * @param  entry: The entry to store.
+ * @return void
+ */
+void chess::chessboard::ab_search_t::store_ttable ( const ab_ttable_entry_t& entry )
+{
+    /* Store the entry, counting whether another state was replaced */
+    const bool replaced = ab_working->ttable->store ( board.game_state_history.back ().key, entry );
+    chess_stats ( ++ab_working->stats.ttable_stores; ab_working->stats.ttable_replacements += replaced; );
+    static_cast<void> ( replaced );
+}
 
 
 
@@ -41,7 +41,7 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
     if ( cmd.starts_with ( "xboard" ) )
     {
         /* Wait for the protover command and check for at least version 2 */
-        std::string next_cmd; std::getline ( chess_in, next_cmd );
+        const std::string next_cmd = next_command ();
         if ( !next_cmd.starts_with ( "protover " ) || next_cmd.size () < 10 || safe_stoi ( next_cmd.substr ( 9 ) ) < 2 ) throw chess_input_error { "Did not recieve valid protover command after xboard" };
 
         /* Send feature requests */ 
@@ -57,6 +57,12 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
         write_chess_out ( "feature myname=LouisChessX" ); /* Name this engine */
         write_chess_out ( "feature colors=0"        ); /* Don't send the 'white' or 'black' commands */
         write_chess_out ( "feature smp=1"           ); /* Allow the cores command */
+        write_chess_out ( "feature memory=1"        ); /* Allow the memory command */
+        write_chess_out ( "feature analyze=1"       ); /* Allow analysis mode */
+        write_chess_out ( "feature option=\"MultiPV -spin 1 1 16\"" ); /* Allow the number of principal variations in analysis mode to be set */
+        #if CHESS_USE_SYZYGY
+            write_chess_out ( "feature egt=\"syzygy\"" ); /* Allow the egtpath command for Syzygy tablebases */
+        #endif
         write_chess_out ( "feature done=1"          ); /* End of features */
     } else
 
@@ -74,11 +80,15 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
      */
     if ( cmd.starts_with ( "new" ) )
     {
-        /* Cancel any ongoing search */
-        stop_precomputation ();
+        /* Cancel and wait for any ongoing search */
+        end_searches ();
+
+        /* Save the cumulative ttable to its file, if there is one */
+        save_ttable_file ();
 
-        /* Reset the board and clear the cumulative ttable */
-        game_cb.reset_to_initial (); cumulative_ttable.clear ();
+        /* Reset the board. If the ttable is persisted, age it so that it may be used in the new game, otherwise clear it. */
+        game_cb.reset_to_initial ();
+        if ( ttable_file_path.size () ) cumulative_ttable.new_generation ( ttable_min_bk_depth ); else cumulative_ttable.clear ();
 
         /* Change to normal mode */
         mode = computer_mode_t::normal;
@@ -104,10 +114,10 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
 
     /** @name  quit
      * 
-     * @brief  Supplied when the engine should quit immediately. Simply cancels ongoing search.
+     * @brief  Supplied when the engine should quit immediately. Cancels ongoing search, and saves the cumulative ttable to its file, if there is one.
      * @return Nothing.
      */
-    if ( cmd.starts_with ( "quit" ) ) stop_precomputation (); else
+    if ( cmd.starts_with ( "quit" ) ) { end_searches (); save_ttable_file (); } else
 
     /** @name  force
      * 
@@ -123,6 +133,40 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
         mode = computer_mode_t::force;
     } else
 
+    /** @name  analyze
+     * 
+     * @brief  Put the engine into analysis mode, such that it searches the current position indefinitely, outputting its thinking.
+     *         Moves are then given with usermove, and the analysis is restarted for each new position.
+     * @return Thinking output.
+     */
+    if ( cmd == "analyze" )
+    {
+        /* Enter analysis mode and start analysing */
+        mode = computer_mode_t::analyze;
+        start_analysis ();
+    } else
+
+    /** @name  exit
+     * 
+     * @brief  Leave analysis mode, entering force mode.
+     * @return Nothing.
+     */
+    if ( cmd == "exit" )
+    {
+        /* Stop and wait for the analysis */
+        end_searches ();
+
+        /* Enter force mode */
+        mode = computer_mode_t::force;
+    } else
+
+    /** @name  .
+     * 
+     * @brief  Requests a status update during analysis. Thinking is already output periodically, so ignore the command.
+     * @return Nothing.
+     */
+    if ( cmd == "." ); else
+
     /** @name  go
      * 
      * @brief  Leave force mode (if active) and make the engine play as the color who's turn it is now.
@@ -142,11 +186,12 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
         /* Start time control */
         start_time_control ();
 
-        /* Start a search and get the result */
-        chessboard::ab_result_t ab_result = start_search ( game_cb, computer_pc, move_t {}, cumulative_ttable, true )->ab_result_future.get ();
-
-        /* Output the move, if any */
-        make_and_output_move ( ab_result );
+        /* Play a book move if there is one, otherwise start a search and output its move, if any */
+        if ( !make_and_output_book_move () )
+        {
+            game_cb.purge_ttable ( cumulative_ttable, ttable_min_bk_depth );
+            if ( std::optional<chessboard::ab_result_t> ab_result = wait_for_search ( start_search ( game_cb, computer_pc, move_t {}, search_type_t::response, output_post ) ) ) make_and_output_move ( * ab_result );
+        }
     } else
 
     /** @name  playother
@@ -223,6 +268,46 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
         computer_clock = opponent_clock = time_base;
     } else
 
+    /** @name  sd DEPTH
+     * 
+     * @brief  Limit the depth of searches.
+     * @param  DEPTH: The maximum depth, an integer of at least 1.
+     * @return Nothing.
+     */
+    if ( cmd.starts_with ( "sd " ) )
+    {
+        /* Stop and wait for any searches, so that none with the old limit is used */
+        end_searches ();
+
+        /* Get the depth, and throw if it is not positive */
+        const int depth = safe_stoi ( cmd.substr ( 3 ) );
+        if ( depth < 1 ) throw chess_input_error { "Search depth must be positive." };
+
+        /* Set the maximum depth */
+        std::unique_lock search_lock { search_mx };
+        max_depth = depth;
+    } else
+
+    /** @name  nodes N
+     * 
+     * @brief  An engine-specific command to stop each search after it has visited N nodes (including quiescence nodes), as well as at the time limit.
+     *         Unlike a time limit, the result of a single-threaded search with a node limit does not depend on the speed of the machine.
+     * @param  N: The number of nodes, or 0 for no limit.
+     * @return Nothing.
+     */
+    if ( cmd.starts_with ( "nodes " ) )
+    {
+        /* Stop and wait for any searches, so that none with the old limit is used */
+        end_searches ();
+
+        /* Get the number of nodes, which throws if it is negative */
+        const unsigned long long nodes = safe_stoull ( cmd.substr ( 6 ) );
+
+        /* Set the node budget */
+        std::unique_lock search_lock { search_mx };
+        max_nodes = ( nodes ? nodes : std::numeric_limits<unsigned long long>::max () );
+    } else
+
     /** @name  time N
      * 
      * @brief  Set the computer clock to have N centiseconds remaining. Used to synchronize clocks.
@@ -271,6 +356,16 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
         /* Try to decode the move description */
         const move_t move = game_cb.fide_deserialize_move ( next_pc, cmd.substr ( 9 ) );
 
+        /* If in analysis mode, make the move without time control and analyse the new position */
+        if ( mode == computer_mode_t::analyze )
+        {
+            end_searches ();
+            game_cb.make_move ( move );
+            next_pc = other_color ( next_pc );
+            start_analysis ();
+            return true;
+        }
+
         /* Try to make the move */
         game_cb.make_move ( move );
         
@@ -289,22 +384,40 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
             /* Stop any precomputation */
             search_data_it_t search_data_it = stop_precomputation ( move );
 
-            /* Start the correct search if had not already been started. Set to output thinking if requested. */
-            if ( search_data_it == active_searches.end () ) search_data_it = start_search ( game_cb, computer_pc, move, game_cb.purge_ttable ( cumulative_ttable, ttable_min_bk_depth ), true, output_post );
-            else search_data_it->cecp_thinking = output_post;
-
-            /* Get the result of the search. Wait slightly longer than the max response duration, to stop the timeout from just missing the end of the search. */
-            if ( search_data_it->ab_result_future.wait_for ( max_response_duration ) == std::future_status::timeout ) search_data_it->end_flag.request_stop ();
-            chessboard::ab_result_t ab_result = search_data_it->ab_result_future.get ();
-
-            /* Output thinking */
-            write_chess_out ( game_cb.get_cecp_thinking ( ab_result ) );
-
-            /* Output the move, if any */
-            make_and_output_move ( ab_result );
+            /* If a search was not already started, try to play a book move instead */
+            if ( search_data_it != active_searches.end () || !make_and_output_book_move () )
+            {
+                /* Start the correct search if had not already been started. Set to output thinking if requested. */
+                if ( search_data_it == active_searches.end () ) { game_cb.purge_ttable ( cumulative_ttable, ttable_min_bk_depth ); search_data_it = start_search ( game_cb, computer_pc, move, search_type_t::response, output_post ); }
+                else
+                {
+                    /* Set to output thinking, and time the pondered search as a response from now (or from when it starts, if it is still waiting) */
+                    std::unique_lock search_lock { search_mx };
+                    search_data_it->cecp_thinking = output_post;
+                    search_data_it->ponder_hit = true;
+                    if ( search_data_it->started ) search_data_it->time_control.restart ( chess_clock::now (), response_duration, max_response_duration );
+                }
+
+                /* Get the result of the search, stopping it if it is still running after the max response duration. There is none if the game changed during the search. */
+                if ( std::optional<chessboard::ab_result_t> ab_result = wait_for_search ( search_data_it, chess_clock::now () + max_response_duration ) )
+                {
+                    /* Output thinking */
+                    write_chess_out ( game_cb.get_cecp_thinking ( * ab_result, cumulative_ttable ) );
+
+                    /* Output the move, if any */
+                    make_and_output_move ( * ab_result );
+                }
+            }
         }
     } else
 
+    /** @name  ?
+     * 
+     * @brief  Move now. Searches are interrupted by this command in wait_for_search, so otherwise it is ignored.
+     * @return Nothing.
+     */
+    if ( cmd == "?" ); else
+
     /** @name  ping N
      * 
      * @brief  Ping pong command.
@@ -347,31 +460,38 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
      */
     if ( cmd.starts_with ( "setboard " ) )
     {
-        /* Throw if is not in force mode */
-        if ( mode != computer_mode_t::force ) throw chess_input_error { "Recieved 'setboard' command when the computer is not in force mode." };
+        /* Throw if is not in force or analysis mode */
+        if ( mode == computer_mode_t::normal ) throw chess_input_error { "Recieved 'setboard' command when the computer is not in force mode." };
 
-        /* Stop any precomputation */
-        stop_precomputation ();
+        /* Stop and wait for any searches */
+        end_searches ();
 
         /* Set the game state */
         next_pc = game_cb.fen_deserialize_board_keep_history ( cmd.substr ( 9 ) );
 
         /* Clear the transposition table */
         cumulative_ttable.clear ();
+
+        /* Restart any analysis */
+        if ( mode == computer_mode_t::analyze ) start_analysis ();
     } else
 
     /** @name  undo
      * 
-     * @brief  Undo the last move. Should be in force mode.
+     * @brief  Undo the last move. Should be in force or analysis mode.
      * @return Nothing.
      */
     if ( cmd.starts_with ( "undo" ) )
     {
-        /* Throw if is not in force mode */
-        if ( mode != computer_mode_t::force ) throw chess_input_error { "Recieved 'undo' command when the computer is not in force mode." };
+        /* Throw if is not in force or analysis mode */
+        if ( mode == computer_mode_t::normal ) throw chess_input_error { "Recieved 'undo' command when the computer is not in force mode." };
+
+        /* Stop and wait for any analysis, then undo the last move */
+        end_searches ();
+        game_cb.unmake_move (); next_pc = other_color ( next_pc );
 
-        /* Undo the last move */
-        game_cb.unmake_move ();
+        /* Restart any analysis */
+        if ( mode == computer_mode_t::analyze ) start_analysis ();
     } else
 
     /** @name  remove
@@ -422,12 +542,85 @@ bool chess::game_controller::handle_command ( const std::string& cmd ) try
      * @return Nothing.
      */
     if ( cmd.starts_with ( "cores " ) ) 
+    {
+        /* Change the number of parallel searches, which also stops any searches and the search threads */
+        set_parallel_searches ( safe_stoi ( cmd.substr ( 5 ) ) );
+    } else
+
+    /** @name  memory N
+     * 
+     * @brief  Set the size of the transposition table.
+     * @param  N: The size in MB, an integer.
+     * @return Nothing.
+     */
+    if ( cmd.starts_with ( "memory " ) ) 
+    {
+        /* Stop and wait for any searches */
+        end_searches ();
+
+        /* Get the new size, and throw if it is not positive */
+        const int size_mb = safe_stoi ( cmd.substr ( 7 ) );
+        if ( size_mb <= 0 ) throw chess_input_error { "Transposition table size must be positive." };
+
+        /* Resize the cumulative ttable */
+        set_ttable_size ( size_mb );
+    } else
+
+    /** @name  option MultiPV=N
+     * 
+     * @brief  Set the number of principal variations output in analysis mode.
+     * @param  N: The number of variations, an integer of at least 1.
+     * @return Nothing.
+     */
+    if ( cmd.starts_with ( "option MultiPV=" ) )
+    {
+        /* Stop any searches, since they read the number of variations, then set it */
+        const int new_multi_pv = std::max ( safe_stoi ( cmd.substr ( 15 ) ), 1 );
+        end_searches ();
+        multi_pv = new_multi_pv;
+
+        /* Restart any analysis, since a single variation is searched differently */
+        if ( mode == computer_mode_t::analyze ) start_analysis ();
+    } else
+
+    /** @name  stats [reset]
+     * 
+     * @brief  An engine-specific command to output the detailed statistics of every search since they were last reset, also logging them as JSON.
+     *         With the reset parameter, the statistics are instead reset. Requires CHESS_STATS to be true (see macros.h).
+     * @return The statistics, as comments.
+     */
+    if ( cmd == "stats" || cmd == "stats reset" )
+    {
+    #if CHESS_STATS
+        /* Copy or reset the statistics */
+        std::unique_lock search_lock { search_mx };
+        const chessboard::search_stats_t stats = search_stats;
+        if ( cmd == "stats reset" ) search_stats = {};
+        search_lock.unlock ();
+
+        /* Output the statistics */
+        if ( cmd == "stats" ) { write_chess_out ( stats.format () ); write_chess_log ( "stats ", stats.format_json () ); }
+    #else
+        /* Statistics are not gathered */
+        throw chess_input_error { "Search statistics were not compiled in (define CHESS_STATS)." };
+    #endif
+    } else
+
+    /** @name  egtpath TYPE PATH
+     * 
+     * @brief  Set the path of endgame tablebases. Only Syzygy tablebases are supported.
+     * @param  TYPE: The tablebase type, which must be syzygy.
+     * @param  PATH: The directories containing the tables, separated by colons.
+     * @return Nothing.
+     */
+    if ( cmd.starts_with ( "egtpath " ) )
     {
         /* Stop precomputation */
         stop_precomputation ();
 
-        /* Change the number of parallel searches */
-        num_parallel_searches = safe_stoi ( cmd.substr ( 5 ) );
+        /* Throw if not Syzygy, otherwise load the tables */
+        if ( !cmd.starts_with ( "egtpath syzygy " ) ) throw chess_input_error { "Only Syzygy tablebases are supported." };
+        tablebase::init ( cmd.substr ( 15 ) );
     } else
 
     /** @name  easy
@@ -509,6 +702,124 @@ catch ( const std::exception& e )
     throw chess_input_error { "Failed to convert string to an inteter." };
 }
 
+/** @name  safe_stoull
+ * 
+ * @brief  Call std::stoull, but rethrow an exception as a chess_input_error. Unlike std::stoull, negative numbers are rejected rather than wrapped.
+ * @param  str: The string to convert
+ * @return The converted integer.
+ */
+unsigned long long chess::game_controller::safe_stoull ( const std::string& str ) const try
+{
+    /* Throw if the number is negative, otherwise return std::stoull of str */
+    if ( str.find ( '-' ) != std::string::npos ) throw chess_input_error { "Negative number." };
+    return std::stoull ( str );
+} 
+
+/* Catch an exception */
+catch ( const std::exception& e )
+{
+    /* Rethrow */
+    throw chess_input_error { "Failed to convert string to a non-negative integer." };
+}
+
+
+
+/** @name  make_and_output_book_move
+ * 
+ * @brief  If the current position is in the opening book, performs and outputs a book move.
+ *         Precomputation is not started, since the opponent's reply is also likely to be in the book.
+ * @return True if a book move was made, false if the position is not in the book.
+ */
+bool chess::game_controller::make_and_output_book_move ()
+{
+    /* Check is in normal mode and that it is the computer's move */
+    if ( mode != computer_mode_t::normal ) throw chess_internal_error { "Computer tried to output a move while in force mode." };
+    if ( next_pc != computer_pc ) throw chess_internal_error { "Computer tried to output a move when it's not its turn." }; 
+
+    /* Look for a book move, and return false if there is none */
+    const std::optional<move_t> move = book.probe ( game_cb, computer_pc );
+    if ( !move ) return false;
+
+    /* Output the move */
+    write_chess_out ( "move ", game_cb.fide_serialize_move ( * move ) );
+    write_chess_out ( "# book move" );
+
+    /* Make the move, ending and restarting time control for the opponent */
+    game_cb.make_move ( * move );
+    end_time_control ();
+    next_pc = other_color ( next_pc );
+    start_time_control ();
+
+    /* Return true */
+    return true;
+}
+
+
+
+/** @name  wait_for_search
+ * 
+ * @brief  Wait for a search to finish, while answering commands which xboard expects a reply to during a search.
+ *         '?' stops the search, so that its best move so far is played, and ping, time, otim, post and nopost are handled immediately.
+ *         Other commands are left queued to be handled after the search, but those which end or change the game (quit, new, force, result, setboard, undo and remove) stop the search early.
+ *         So that the order of replies is kept, commands after one which is left queued are also left queued, other than '?'.
+ * @param  search_data_it: The search to wait for.
+ * @param  end_point: A time point at which to stop the search, if it has not finished. Never by default.
+ * @return The result of the search, or nothing if a command which ends or changes the game was left queued, in which case the result must not be played.
+ */
+std::optional<chess::chessboard::ab_result_t> chess::game_controller::wait_for_search ( const search_data_it_t search_data_it, const chess_clock::time_point end_point )
+{
+    /* Get whether the search has finished. Search threads notify input_cv once they set the result. */
+    auto search_finished = [ & ] () { return search_data_it->ab_result_future.wait_for ( std::chrono::seconds { 0 } ) == std::future_status::ready; };
+
+    /* The number of commands at the front of the queue which are being left to handle after the search, and whether any of them ends or changes the game */
+    std::size_t num_deferred = 0;
+    bool game_changed = false;
+
+    /* Lock input_mx and loop until the search finishes */
+    std::unique_lock input_lock { input_mx };
+    while ( !search_finished () )
+    {
+        /* Wait for a new command or the search to finish. If the end point is reached first, stop the search and wait for it without handling further commands. */
+        if ( !input_cv.wait_until ( input_lock, end_point, [ & ] () { return num_deferred < input_queue.size () || search_finished (); } ) )
+            { search_data_it->end_flag.request_stop (); break; }
+
+        /* Look at each new command */
+        while ( num_deferred < input_queue.size () )
+        {
+            /* Get the command */
+            const std::string& cmd = input_queue.at ( num_deferred );
+
+            /* If it is '?', remove it and stop the search */
+            if ( cmd == "?" ) { input_queue.erase ( input_queue.begin () + num_deferred ); search_data_it->end_flag.request_stop (); } else
+
+            /* Else if it can be answered now, and no commands before it are being left, remove and handle it with input_mx unlocked */
+            if ( num_deferred == 0 && ( cmd.starts_with ( "ping " ) || cmd.starts_with ( "time " ) || cmd.starts_with ( "otim " ) || cmd.starts_with ( "post" ) || cmd.starts_with ( "nopost" ) ) )
+            {
+                const std::string handled_cmd = std::move ( input_queue.front () ); input_queue.pop_front ();
+                input_lock.unlock (); handle_command ( handled_cmd );
+
+                /* If thinking output was turned on or off, also apply it to the running search */
+                if ( handled_cmd.starts_with ( "post" ) || handled_cmd.starts_with ( "nopost" ) ) { std::unique_lock search_lock { search_mx }; search_data_it->cecp_thinking = output_post; }
+                input_lock.lock ();
+            }
+
+            /* Else leave it to be handled after the search. If it ends or changes the game, stop the search early. */
+            else
+            {
+                if ( cmd.starts_with ( "quit" ) || cmd.starts_with ( "new" ) || cmd.starts_with ( "force" ) || cmd.starts_with ( "result" ) || cmd.starts_with ( "setboard" ) || cmd.starts_with ( "undo" ) || cmd.starts_with ( "remove" ) )
+                    { search_data_it->end_flag.request_stop (); game_changed = true; }
+                ++num_deferred;
+            }
+        }
+    }
+
+    /* Unlock input_mx and get the result, which is dropped if the game has changed, since the move would come after the command which changed it */
+    input_lock.unlock ();
+    chessboard::ab_result_t ab_result = search_data_it->ab_result_future.get ();
+    if ( game_changed ) return std::nullopt;
+    return ab_result;
+}
+
 
 
 /** @name  make_and_output_move
@@ -544,6 +855,9 @@ void chess::game_controller::make_and_output_move ( chessboard::ab_result_t& ab_
         write_chess_out ( "# av. moves per node  = ",    ab_result.av_moves     );
         write_chess_out ( "# av. moves per q. node  = ", ab_result.av_q_moves   );
 
+        /* Log the detailed statistics of the search */
+        chess_stats ( write_chess_log ( "stats ", ab_result.stats.format_json () ); );
+
         /* Make the move */
         game_cb.make_move ( ab_result.moves.front ().first );
 
@@ -553,15 +867,13 @@ void chess::game_controller::make_and_output_move ( chessboard::ab_result_t& ab_
         /* Set the latest best value */
         latest_best_value = ab_result.moves.front ().second;
 
-        /* Set the cumulative ttable */
-        cumulative_ttable = game_cb.purge_ttable ( std::move ( ab_result.ttable ), ttable_min_bk_depth );
-
         /* Swap the next color */
         next_pc = other_color ( next_pc ); 
 
         /* If is a win, stalemate or draw, output a result */
         if ( ab_result.moves.front ().first.checkmate ) write_chess_out ( computer_pc == pcolor::white ? "1-0 {White mates}" : "0-1 {Black mates}" ); else
         if ( ab_result.moves.front ().first.stalemate ) write_chess_out ( "1/2-1/2 {Stalemate}" ); else
+        if ( ab_result.moves.front ().first.draw && game_cb.is_fifty_move_draw () ) write_chess_out ( "1/2-1/2 {Draw by fifty move rule}" ); else
         if ( ab_result.moves.front ().first.draw      ) write_chess_out ( "1/2-1/2 {Draw by repetition}" );
 
         /* Else, since the game has not ended, start time controls and precomputation */
@@ -581,7 +893,8 @@ void chess::game_controller::make_and_output_move ( chessboard::ab_result_t& ab_
         /* Else if the computer is not in check and doesn't have any mobility, then this is a stalemate */
         if ( !computer_check_info.check_count && !computer_has_mobility ) write_chess_out ( "1/2-1/2 {Stalemate}" ); else
 
-        /* Else check if this is a draw state */
+        /* Else check if this is a draw state, by the fifty-move rule or repetition */
+        if ( game_cb.is_fifty_move_draw () ) write_chess_out ( "1/2-1/2 {Draw by fifty move rule}" ); else
         if ( game_cb.is_draw_state () ) write_chess_out ( "1/2-1/2 {Draw by repetition}" ); else
 
         /* Else the ab_result has no moves for an unknown reason, so produce an internal error */
@@ -15,6 +15,10 @@
 /* INCLUDES */
 #include <louischessx/game_controller.h>
 
+#include <algorithm>
+#include <exception>
+#include <optional>
+
 
 
 /* TIME CONTROL */
@@ -31,6 +35,9 @@ void chess::game_controller::configure_search_time_paramaters ()
     /* Return if not in normal mode */
     if ( mode != computer_mode_t::normal ) return;
 
+    /* The computer's clock, less the time to allow for communicating its move */
+    const chess_clock::duration usable_clock = std::max ( computer_clock - move_overhead, chess_clock::duration::zero () );
+
     /* Switch depending on the type of clock */
     switch ( clock_type )
     {
@@ -43,11 +50,14 @@ void chess::game_controller::configure_search_time_paramaters ()
             const int computer_moves_until_time_control = moves_per_control - moves_made ( next_pc != computer_pc ) % moves_per_control;
             const int opponent_moves_until_time_control = moves_per_control - moves_made ( next_pc == computer_pc ) % moves_per_control;
 
-            /* Set the maximum response time */
-            max_response_duration = computer_clock / computer_moves_until_time_control;
+            /* Set the optimum response time to an even share of the clock.
+             * Allow up to four times this, but unless this is the last move of the time control, keep at least half of the clock for the remaining moves.
+             */
+            response_duration = computer_clock / computer_moves_until_time_control;
+            max_response_duration = std::min ( response_duration * 4, usable_clock / std::min ( computer_moves_until_time_control, 2 ) );
 
             /* Set the maximum thinking time. This is the sum of the response duration for both the computer and opponent. */
-            max_search_duration = max_response_duration + std::max<chess_clock::duration> ( opponent_clock / opponent_moves_until_time_control, average_opponent_response_time );
+            max_search_duration = response_duration + std::max<chess_clock::duration> ( opponent_clock / opponent_moves_until_time_control, average_opponent_response_time );
 
             /* Break */
             break;
@@ -56,11 +66,12 @@ void chess::game_controller::configure_search_time_paramaters ()
         /* For incremental clock */
         case clock_type_t::incremental:
         {
-            /* Set the maximum response time. Use up all the remaining time in the next 50 moves */
-            max_response_duration = time_increase + computer_clock / 25;
+            /* Set the optimum response time. Use up all the remaining time in the next 50 moves. Allow up to four times this, but never more than half of the clock. */
+            response_duration = time_increase + computer_clock / 25;
+            max_response_duration = std::min ( response_duration * 4, usable_clock / 2 );
 
             /* Set the maximum thinking time. This is the sum of the response duration for both the computer and opponent */
-            max_search_duration = max_response_duration + std::max<chess_clock::duration> ( time_increase + opponent_clock / 25, average_opponent_response_time );
+            max_search_duration = response_duration + std::max<chess_clock::duration> ( time_increase + opponent_clock / 25, average_opponent_response_time );
 
             /* Break */
             break;
@@ -69,13 +80,16 @@ void chess::game_controller::configure_search_time_paramaters ()
         /* For fixed max clock */
         case clock_type_t::fixed_max:
         {
-            /* Set the maximum response time */
-            max_response_duration = time_base;
+            /* Set the optimum and maximum response times to the time base, since no time can be saved for later moves */
+            response_duration = max_response_duration = std::max ( time_base - move_overhead, time_base / 2 );
 
             /* Set the maximum thinking time */
-            max_search_duration = max_response_duration * 2;
+            max_search_duration = time_base * 2;
         }
     }
+
+    /* The optimum response time should not exceed the maximum */
+    response_duration = std::min ( response_duration, max_response_duration );
 }
 
 
@@ -164,46 +178,204 @@ bool chess::game_controller::end_time_control ()
 
 /** @name  start_search
  * 
- * @brief  Start a search, pushing the search data to the bottom of active_searches.
- *         When the search finishes, the iterator to the active search will be pushed to completed_searches.
- *         search_cv will then be notified and the thread will exit.
+ * @brief  Start a search, pushing the search data to the bottom of active_searches and queueing it for the search threads.
+ *         The next free search thread will run the waiting search with the highest priority, then set its result and notify search_cv.
  *         The game state will be stored, so can be safely modified after this function returns.
+ *         search_mx must not be held by the caller.
  * @param  cb: The chessboard state to run the search on.
  * @param  pc: The player color to search.
  * @param  opponent_move: The opponent move which lead to this state, empty move by default.
- * @param  ttable: The transposition table from previous searches. Empty by default.
- * @param  direct_response: If true, then this search is in response to an opponent move, so max_response_duration should be used instead of max_search_duration. False by default.
+ * @param  search_type: The purpose of the search, which determines its duration. Unless pondering, no other searches will be running,
+ *         so the search becomes the assisted search, such that every free search thread joins it. Pondering by default.
  * @param  output_thinking: If true, then thinking is printed. False by default.
+ * @param  priority: The priority of the search over other waiting searches. Defaults to the highest priority.
  * @return An iterator to the search data in active_searches.
  */
-chess::game_controller::search_data_it_t chess::game_controller::start_search ( const chessboard& cb, const pcolor pc, const move_t& opponent_move, chessboard::ab_ttable_t ttable, const bool direct_response, const bool output_thinking )
+chess::game_controller::search_data_it_t chess::game_controller::start_search ( const chessboard& cb, const pcolor pc, const move_t& opponent_move, const search_type_t search_type, const bool output_thinking, const int priority )
 {
     /* Create the search data */
-    active_searches.emplace_back ( cb, pc, opponent_move, std::stop_source {}, output_thinking );
+    active_searches.emplace_back ( cb, pc, opponent_move, search_type, priority, std::stop_source {}, output_thinking );
+
+    /* The search will write to the ttable, so any persisted copy will now be outdated */
+    ttable_file_outdated = true;
 
-    /* Get an iterator to the active search */
+    /* Get an iterator to the active search, and the future to its result */
     search_data_it_t search_data_it = --active_searches.end ();
+    search_data_it->ab_result_future = search_data_it->ab_result_promise.get_future ();
+
+    /* Aquire a lock on search_mx */
+    std::unique_lock search_lock { search_mx };
+
+    /* Start the search threads if they are not running */
+    if ( search_threads.empty () ) for ( int i = 0; i < std::max ( num_parallel_searches, 1 ); ++i ) search_threads.emplace_back ( &game_controller::search_thread_loop, this );
+
+    /* Queue the search, and make it the assisted search if it is not pondering, then unlock and notify the search threads */
+    waiting_searches.push_back ( search_data_it );
+    if ( search_type != search_type_t::ponder ) assisted_search = search_data_it;
+    search_lock.unlock (); search_cv.notify_all ();
+
+    /* Return the iterator to the active search */
+    return search_data_it;
+}
+
+
+
+/** @name  search_thread_loop
+ * 
+ * @brief  The function run by each search thread. Repeatedly runs the waiting search with the highest priority, until search_threads_end_flag is set.
+ *         If there are no waiting searches, joins the assisted search as a helper, if it is running and does not have a helper for every other search thread.
+ * @return void
+ */
+void chess::game_controller::search_thread_loop ()
+{
+    /* Aquire a lock on search_mx */
+    std::unique_lock search_lock { search_mx };
+
+    /* The board to run searches on. Searches copy their position into it, which keeps its search data (such as the move ordering tables) between searches. */
+    chessboard search_cb;
+
+    /* A function to get whether a search only needs the best move, which is unless it is an analysis with multiple principal variations */
+    auto get_best_only = [ this ] ( const search_data_t& search_data ) { return search_data.search_type != search_type_t::analysis || multi_pv == 1; };
 
-    /* Start an asynchronous wait for the search to finish */
-    active_searches.back ().ab_result_future = std::async ( std::launch::async, [ this, search_data_it, ttable { std::move ( ttable ) }, direct_response ] () mutable
+    /* A function to get whether the assisted search can be joined */
+    auto can_assist = [ this ] ()
+        { return assisted_search && ( * assisted_search )->started && !( * assisted_search )->finished && ( * assisted_search )->num_helpers + 1 < search_threads.size (); };
+
+    /* Loop until the end flag is set */
+    while ( true )
     {
-        /* Wait for the search to complete */
-        chessboard::ab_result_t ab_result = search_data_it->cb.alpha_beta_iterative_deepening ( search_data_it->pc, search_depths, true, std::move ( ttable ), search_data_it->end_flag.get_token(), chess_clock::now () + ( direct_response ? max_response_duration : max_search_duration ), search_data_it->cecp_thinking );
+        /* Block until there is a waiting search, an assisted search to join, or the end flag is set */
+        search_cv.wait ( search_lock, [ & ] () { return waiting_searches.size () || can_assist () || search_threads_end_flag; } );
+        if ( search_threads_end_flag ) return;
+
+        /* If there are no waiting searches, join the assisted search */
+        if ( waiting_searches.empty () )
+        {
+            /* Get the search and count this thread as a helper */
+            const search_data_it_t search_data_it = * assisted_search;
+            const int helper_index = ++search_data_it->num_helpers; ++num_running_searches;
+
+            /* Unlock search_mx while searching. The search data will not be destroyed while this thread is counted as running. */
+            search_lock.unlock ();
+
+            /* Help the search on a copy of its board, ignoring any exception since the assisted search will report its own */
+            try { ( search_cb = search_data_it->cb ).alpha_beta_helper ( search_data_it->pc, search_data_it->depths, get_best_only ( * search_data_it ), cumulative_ttable, search_data_it->helper_end_flag.get_token (), search_data_it->end_point, helper_index ); } catch ( ... ) {}
+
+            /* Relock search_mx and notify */
+            search_lock.lock ();
+            --num_running_searches;
+            search_cv.notify_all ();
+            continue;
+        }
+
+        /* Take the waiting search with the highest priority. Of equal priorities, the first queued is taken. */
+        auto waiting_it = std::max_element ( waiting_searches.begin (), waiting_searches.end (), [] ( search_data_it_t lhs, search_data_it_t rhs ) { return lhs->priority < rhs->priority; } );
+        const search_data_it_t search_data_it = * waiting_it;
+        waiting_searches.erase ( waiting_it ); ++num_running_searches;
+
+        /* Mark the search as started, which allows helpers to join it if it is the assisted search.
+         * Set its end point and time manager limits, timing a pondered search which is now the response as a response. Analyses have no end point.
+         */
+        search_data_it->started = true;
+        const chess_clock::time_point start_point = chess_clock::now ();
+        switch ( search_data_it->ponder_hit ? search_type_t::response : search_data_it->search_type )
+        {
+            case search_type_t::ponder:   search_data_it->time_control.restart ( start_point, max_search_duration, max_search_duration ); break;
+            case search_type_t::response: search_data_it->time_control.restart ( start_point, response_duration, max_response_duration ); break;
+            case search_type_t::analysis: break;
+        }
+        search_data_it->end_point = search_data_it->time_control.hard_end_point ();
+
+        /* Set the depths, limited to max_depth (or just max_depth, if every depth exceeds it), and the node budget */
+        const std::vector<int>& depths = ( search_data_it->search_type == search_type_t::analysis ? analysis_depths : search_depths );
+        search_data_it->depths.clear ();
+        std::copy_if ( depths.begin (), depths.end (), std::back_inserter ( search_data_it->depths ), [ this ] ( const int depth ) { return depth <= max_depth; } );
+        if ( search_data_it->depths.empty () ) search_data_it->depths = { max_depth };
+        search_data_it->max_nodes = max_nodes;
+        search_cv.notify_all ();
 
-        /* Lock the mutex, add search_data_it to the list of completed searches, and unlock the mutex */
-        std::unique_lock search_lock { search_mx };
-        completed_searches.push_back ( search_data_it );
+        /* Unlock search_mx while searching */
         search_lock.unlock ();
 
-        /* Notify the condition variable */
+        /* Run the search on a copy of the board in search_cb, so that helpers can copy the unmodified board. Catch any exception to be rethrown by the future. */
+        std::optional<chessboard::ab_result_t> ab_result; std::exception_ptr ab_exception;
+        try
+        {
+            const chessboard::ab_thinking_callback_t thinking = [ this, search_data_it ] ( const chessboard::ab_result_t& ab_result ) { output_thinking ( * search_data_it, ab_result ); };
+            ab_result = ( search_cb = search_data_it->cb ).alpha_beta_iterative_deepening ( search_data_it->pc, search_data_it->depths, get_best_only ( * search_data_it ), cumulative_ttable, search_data_it->end_flag.get_token (), search_data_it->end_point, thinking, true, 1,
+                search_data_it->max_nodes, ( search_data_it->search_type == search_type_t::analysis ? nullptr : &search_data_it->time_control ) );
+        } catch ( ... ) { ab_exception = std::current_exception (); }
+
+        /* Relock search_mx, stop any helpers, then set the result and notify, including any wait for the result in wait_for_search. This must happen before the search is no longer counted as running, since end_searches may then destroy the search data. */
+        search_lock.lock ();
+        search_data_it->finished = true; search_data_it->helper_end_flag.request_stop ();
+        chess_stats ( if ( ab_result ) search_stats += ab_result->stats; );
+        if ( ab_result ) search_data_it->ab_result_promise.set_value ( std::move ( * ab_result ) ); else search_data_it->ab_result_promise.set_exception ( ab_exception );
+        { std::unique_lock input_lock { input_mx }; } input_cv.notify_all (); /* Locking input_mx first stops the notification being missed */
+        --num_running_searches;
         search_cv.notify_all ();
+    }
+}
 
-        /* Return the result */
-        return ab_result;
-    } );
+/** @name  stop_search_threads
+ * 
+ * @brief  Stop and join the search threads. There must be no running or waiting searches.
+ * @return void
+ */
+void chess::game_controller::stop_search_threads ()
+{
+    /* Set the end flag, then unlock and notify */
+    std::unique_lock search_lock { search_mx };
+    search_threads_end_flag = true;
+    search_lock.unlock (); search_cv.notify_all ();
 
-    /* Return the iterator to the active search */
-    return search_data_it;
+    /* Join the threads */
+    for ( std::thread& search_thread : search_threads ) search_thread.join ();
+    search_threads.clear ();
+
+    /* Reset the end flag */
+    search_lock.lock ();
+    search_threads_end_flag = false;
+}
+
+
+
+/** @name  start_analysis
+ * 
+ * @brief  Stop any searches, then start an analysis of game_cb for next_pc, which outputs its thinking.
+ * @return void
+ */
+void chess::game_controller::start_analysis ()
+{
+    /* Stop and wait for any searches, then empty active_searches */
+    end_searches ();
+
+    /* Age the entries from previous searches, then start the analysis */
+    game_cb.purge_ttable ( cumulative_ttable, ttable_min_bk_depth );
+    start_search ( game_cb, next_pc, move_t {}, search_type_t::analysis, true );
+}
+
+/** @name  output_thinking
+ * 
+ * @brief  Called by a search thread with thinking info from a search, which is output if enabled for the search.
+ *         The output is rate-limited: a new best move is always output, but otherwise thinking is output at most once every thinking_interval.
+ *         An analysis outputs a line for each of up to multi_pv principal variations.
+ * @param  search_data: The search.
+ * @param  ab_result: The thinking info.
+ * @return void
+ */
+void chess::game_controller::output_thinking ( search_data_t& search_data, const chessboard::ab_result_t& ab_result )
+{
+    /* Only output if enabled for the search */
+    if ( !search_data.cecp_thinking || ab_result.moves.empty () ) return;
+
+    /* Return if the best move is unchanged and thinking was output too recently */
+    const chess_clock::time_point now = chess_clock::now ();
+    if ( ab_result.moves.front ().first.is_similar ( search_data.last_thinking_move ) && now - search_data.last_thinking_point < thinking_interval ) return;
+    search_data.last_thinking_point = now; search_data.last_thinking_move = ab_result.moves.front ().first;
+
+    /* Output a line for each principal variation. A search which is not an analysis only finds the best move. */
+    for ( int i = 0; i < multi_pv && i < ab_result.moves.size (); ++i ) write_chess_out ( search_data.cb.get_cecp_thinking ( ab_result, cumulative_ttable, i ) );
 }
 
 
@@ -211,67 +383,41 @@ chess::game_controller::search_data_it_t chess::game_controller::start_search (
 /** @name  start_precomputation
  * 
  * @brief  Start a thread to precompute searches for possible opponent responses. The thread will be stored in search_controller.
- *         Setting search_end_flag to true then notifying search_cv will cancel all active searches and the controller thread will prompty finish execution.
- *         Setting known_opponent_move before doing the above will cause the controller thread to not stop the search based on known_opponent_move (but will not start it if not already started).
+ *         The thread runs a shallow search for the opponent's best moves, then starts a search for each, prioritized by the value of the opponent move.
+ *         Setting search_end_flag to true then notifying search_cv causes the controller thread to start no further searches and prompty finish execution.
  *         The game state will be stored, so can be safely modified after this function returns.
  * @return void
  */
 void chess::game_controller::start_precomputation ()
 {
-    /* Stop any active searches */
-    stop_precomputation ();
-
-    /* Empty active_searches and completed_searches */
-    active_searches.clear (); completed_searches.clear (); 
+    /* Stop and wait for any searches, then empty active_searches */
+    end_searches ();
 
     /* Set the end flag to false and the known opponent move to unknown */
     search_end_flag = false; known_opponent_move = move_t {};
 
     /* Start the new thread if pondering is allowed */
-    if ( pondering && num_parallel_searches ) search_controller = std::thread { [ this, cb { game_cb }, pc { computer_pc }, ttable { cumulative_ttable } ] () mutable
+    if ( pondering && num_parallel_searches ) search_controller = std::thread { [ this, cb { game_cb }, pc { computer_pc } ] () mutable
     {
-        /* Get the opponent moves */
-        chessboard::ab_result_t opponent_ab_result = cb.alpha_beta_iterative_deepening ( other_color ( pc ), opponent_search_depths, false, std::move ( ttable ), std::stop_token {}, chess_clock::now () + std::chrono::milliseconds ( 750 ) );
+        /* Age the entries from previous searches, once for this search and every search it starts, since they all share the position of cb */
+        cb.purge_ttable ( cumulative_ttable, ttable_min_bk_depth );
 
-        /* Get the ttable back */
-        ttable = std::move ( opponent_ab_result.ttable );
-
-        /* Aquire a lock on search_mx */
-        std::unique_lock search_lock { search_mx };
+        /* Get the opponent moves */
+        chessboard::ab_result_t opponent_ab_result = cb.alpha_beta_iterative_deepening ( other_color ( pc ), opponent_search_depths, false, cumulative_ttable, std::stop_token {}, chess_clock::now () + std::chrono::milliseconds ( 750 ) );
 
-        /* Start num_parallel_searches threads (or less if there are few opposing moves) */
-        for ( int i = 0; i < num_parallel_searches && i < opponent_ab_result.moves.size (); ++i )
+        /* Start a search for every opponent move, prioritized by how good the move is for the opponent.
+         * Only num_parallel_searches will run at once, and whenever one finishes, its thread takes the most likely opponent move that is yet to be searched.
+         */
+        for ( const auto& [ opponent_move, opponent_value ] : opponent_ab_result.moves )
         {
-            /* Make the move, start the search, then unmake the move */
-            cb.make_move_internal ( opponent_ab_result.moves.at ( i ).first );
-            start_search ( cb, pc, opponent_ab_result.moves.at ( i ).first, cb.purge_ttable ( ttable, ttable_min_bk_depth ) );
-            cb.unmake_move_internal ();  
-        }
+            /* Stop if the end flag has been set */
+            if ( std::unique_lock search_lock { search_mx }; search_end_flag ) break;
 
-        /* Loop as many times as there are opposing moves */
-        for ( int i = 0; i < opponent_ab_result.moves.size (); ++i )
-        {
-            /* Block on the condition variable. Block until there are is another completed search, or the end flag is set */
-            search_cv.wait ( search_lock, [ this, i ] () { return i < completed_searches.size () || search_end_flag; } );
-
-            /* If the end flag is set, break */
-            if ( search_end_flag ) break;
-
-            /* Determine if there are any searches left to start */
-            if ( i + num_parallel_searches < opponent_ab_result.moves.size () )
-            {
-                /* Start another search by making the next move, starting the search, and unmaking the move */
-                cb.make_move_internal ( opponent_ab_result.moves.at ( i + num_parallel_searches ).first );
-                start_search ( cb, pc, opponent_ab_result.moves.at ( i + num_parallel_searches ).first, cb.purge_ttable ( ttable, ttable_min_bk_depth ) );
-                cb.unmake_move_internal ();  
-            }
+            /* Make the move, start the search, then unmake the move */
+            cb.make_move_internal ( opponent_move );
+            start_search ( cb, pc, opponent_move, search_type_t::ponder, false, opponent_value );
+            cb.unmake_move_internal ();
         }
-
-        /* Cancel all searches, except if the search matches known_opponent_move */
-        for ( search_data_t& search_data : active_searches ) if ( search_data.opponent_move != known_opponent_move ) search_data.end_flag.request_stop ();
-
-        /* Unlock search_mx */
-        search_lock.unlock ();
     } };
 }
 
@@ -279,8 +425,9 @@ void chess::game_controller::start_precomputation ()
 
 /** @name  stop_precomputation
  * 
- * @brief  Stop precomputation, if it's running.
- * @param  oppponent_move: The now known opponent move. Defaults to no move, but if provided will set known_opponent_move which has an effect described by start_precomputation.
+ * @brief  Stop precomputation, if it's running, and cancel every search except one based on opponent_move.
+ *         If that search is still waiting, it is left queued, so that it is run by the next free search thread.
+ * @param  oppponent_move: The now known opponent move, which is stored in known_opponent_move. Defaults to no move.
  * @return Iterator to a search which was made based on oppponent_move, or one past the end iterator if not found.
  */
 chess::game_controller::search_data_it_t chess::game_controller::stop_precomputation ( const move_t& opponent_move )
@@ -294,9 +441,42 @@ chess::game_controller::search_data_it_t chess::game_controller::stop_precomputa
     /* Unlock and notify */
     search_lock.unlock (); search_cv.notify_all ();
 
-    /* Join the controller thread */
+    /* Join the controller thread, so that no further searches are started */
     if ( search_controller.joinable () ) search_controller.join ();
 
-    /* Try to find an active search based on opponent_move and return the iterator */
-    return std::find_if ( active_searches.begin (), active_searches.end (), [ &opponent_move ] ( const search_data_t& search_data ) { return search_data.opponent_move == opponent_move; } );
-}
\ No newline at end of file
+    /* Try to find an active search based on opponent_move */
+    const search_data_it_t search_data_it = std::find_if ( active_searches.begin (), active_searches.end (), [ &opponent_move ] ( const search_data_t& search_data ) { return search_data.opponent_move == opponent_move; } );
+
+    /* Cancel all other searches, and remove the cancelled ones which are still waiting so that they are never run */
+    search_lock.lock ();
+    for ( search_data_t& search_data : active_searches ) if ( search_data.opponent_move != known_opponent_move ) { search_data.end_flag.request_stop (); search_data.helper_end_flag.request_stop (); }
+    std::erase_if ( waiting_searches, [ this ] ( search_data_it_t search_data_it ) { return search_data_it->opponent_move != known_opponent_move; } );
+
+    /* Make the surviving search the assisted search, so that the threads of the cancelled searches join it as they finish */
+    if ( search_data_it != active_searches.end () ) assisted_search = search_data_it;
+    search_lock.unlock (); search_cv.notify_all ();
+
+    /* Return the iterator */
+    return search_data_it;
+}
+
+/** @name  end_searches
+ * 
+ * @brief  Stop precomputation and every search, and wait for them to finish.
+ *         Since searches use the cumulative transposition table by reference, this must be called before the table is cleared or replaced.
+ * @return void
+ */
+void chess::game_controller::end_searches ()
+{
+    /* Stop precomputation, and any search it left running */
+    stop_precomputation ();
+
+    /* Cancel and dequeue every search, then wait for the search threads to finish running them */
+    std::unique_lock search_lock { search_mx };
+    for ( search_data_t& search_data : active_searches ) { search_data.end_flag.request_stop (); search_data.helper_end_flag.request_stop (); }
+    waiting_searches.clear (); assisted_search.reset ();
+    search_cv.wait ( search_lock, [ this ] () { return num_running_searches == 0; } );
+
+    /* Clear the searches */
+    active_searches.clear ();
+}
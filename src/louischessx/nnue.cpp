@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * src/chess/nnue.cpp
+ *
+ * Implementation of include/chess/nnue.h
+ *
+ */
+
+
+
+/* INCLUDES */
+#include <louischessx/nnue.h>
+#include <louischessx/chessboard.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#if CHESS_USE_AVX512 || CHESS_USE_AVX2
+    #include <immintrin.h>
+#endif
+
+
+
+/* STATIC ATTRIBUTES */
+
+/* The network */
+chess::nnue::network_t chess::nnue::network;
+
+/* Each SIMD loop processes whole registers of neurons */
+static_assert ( chess::nnue::HIDDEN_SIZE % 32 == 0, "HIDDEN_SIZE must be a multiple of the AVX-512 register width." );
+
+
+
+/* LOADING */
+
+
+
+/** @name  load
+ *
+ * @brief  Load a network file, replacing any network previously loaded.
+ *         Should not be called while a search is running.
+ * @param  path: The path of the network file.
+ * @throws chess_input_error if the file cannot be read, or is the wrong size.
+ * @return void
+ */
+void chess::nnue::load ( const std::string& path )
+{
+    /* Read the whole file */
+    std::ifstream file { path, std::ios::binary };
+    if ( !file ) throw chess_input_error { "Failed to open NNUE file." };
+    const std::vector<unsigned char> data { std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> {} };
+
+    /* Check the size, allowing for padding to a multiple of 64 bytes */
+    constexpr std::size_t expected_size = ( NUM_FEATURES * HIDDEN_SIZE + HIDDEN_SIZE + 2 * HIDDEN_SIZE + 1 ) * sizeof ( std::int16_t );
+    if ( file.bad () || data.size () < expected_size || data.size () > ( expected_size + 63 ) / 64 * 64 ) throw chess_input_error { "NNUE file is the wrong size." };
+
+    /* Decode the little-endian values in order, into a new network so that the old one is kept if anything fails */
+    std::unique_ptr<network_t> new_network = std::make_unique<network_t> ();
+    auto it = data.begin ();
+    auto decode = [ & ] ( std::int16_t& value ) { value = static_cast<std::int16_t> ( it [ 0 ] | it [ 1 ] << 8 ); it += 2; };
+    for ( auto& weights : new_network->feature_weights ) for ( std::int16_t& value : weights ) decode ( value );
+    for ( std::int16_t& value : new_network->feature_biases ) decode ( value );
+    for ( auto& weights : new_network->output_weights ) for ( std::int16_t& value : weights ) decode ( value );
+    decode ( new_network->output_bias );
+
+    /* Replace the network */
+    network = * new_network; loaded = true;
+}
+
+
+
+/* ACCUMULATORS */
+
+
+
+/** @name  reset_accumulator
+ *
+ * @brief  Set an accumulator to the hidden layer biases, as if there were no pieces.
+ * @param  acc: The accumulator to reset.
+ * @return void
+ */
+void chess::nnue::reset_accumulator ( accumulator_t& acc ) noexcept
+{
+    /* Both perspectives start at the biases */
+    acc.values [ 0 ] = network.feature_biases;
+    acc.values [ 1 ] = network.feature_biases;
+}
+
+/** @name  add_feature
+ *
+ * @brief  Add a piece to an accumulator.
+ * @param  acc: The accumulator.
+ * @param  pc: The color of the piece.
+ * @param  pt: The type of the piece.
+ * @param  pos: The position of the piece.
+ * @return void
+ */
+void chess::nnue::add_feature ( accumulator_t& acc, const pcolor pc, const ptype pt, const int pos ) noexcept
+{
+    /* Update the accumulator in place with a delta of just this feature */
+    feature_delta_t delta; delta.add ( pc, pt, pos );
+    update_accumulator ( acc, acc, delta );
+}
+
+/** @name  update_accumulator
+ *
+ * @brief  Incrementally update an accumulator after a move.
+ * @param  prev: The accumulator before the move.
+ * @param  next: The accumulator to set for after the move, which may be prev to update in place.
+ * @param  delta: The features changed by the move.
+ * @return void
+ */
+void chess::nnue::update_accumulator ( const accumulator_t& prev, accumulator_t& next, const feature_delta_t& delta ) noexcept
+{
+    /* Iterate over the perspectives */
+    for ( int p = 0; p < 2; ++p )
+    {
+        /* Get the weights of the added and removed features from this perspective */
+        std::array<const std::int16_t *, 2> added, removed;
+        for ( int i = 0; i < delta.num_added;   ++i ) added   [ i ] = network.feature_weights [ p ? flip_feature ( delta.added   [ i ] ) : delta.added   [ i ] ].data ();
+        for ( int i = 0; i < delta.num_removed; ++i ) removed [ i ] = network.feature_weights [ p ? flip_feature ( delta.removed [ i ] ) : delta.removed [ i ] ].data ();
+
+        /* Get the old and new values */
+        const std::int16_t * const src = prev.values [ p ].data ();
+        std::int16_t * const dst = next.values [ p ].data ();
+
+        /* Add and subtract the weights, one register of neurons at a time */
+#if CHESS_USE_AVX512
+        for ( int n = 0; n < HIDDEN_SIZE; n += 32 )
+        {
+            __m512i value = _mm512_load_si512 ( src + n );
+            for ( int i = 0; i < delta.num_added;   ++i ) value = _mm512_add_epi16 ( value, _mm512_load_si512 ( added   [ i ] + n ) );
+            for ( int i = 0; i < delta.num_removed; ++i ) value = _mm512_sub_epi16 ( value, _mm512_load_si512 ( removed [ i ] + n ) );
+            _mm512_store_si512 ( dst + n, value );
+        }
+#elif CHESS_USE_AVX2
+        for ( int n = 0; n < HIDDEN_SIZE; n += 16 )
+        {
+            __m256i value = _mm256_load_si256 ( reinterpret_cast<const __m256i *> ( src + n ) );
+            for ( int i = 0; i < delta.num_added;   ++i ) value = _mm256_add_epi16 ( value, _mm256_load_si256 ( reinterpret_cast<const __m256i *> ( added   [ i ] + n ) ) );
+            for ( int i = 0; i < delta.num_removed; ++i ) value = _mm256_sub_epi16 ( value, _mm256_load_si256 ( reinterpret_cast<const __m256i *> ( removed [ i ] + n ) ) );
+            _mm256_store_si256 ( reinterpret_cast<__m256i *> ( dst + n ), value );
+        }
+#else
+        for ( int n = 0; n < HIDDEN_SIZE; ++n )
+        {
+            std::int16_t value = src [ n ];
+            for ( int i = 0; i < delta.num_added;   ++i ) value += added   [ i ] [ n ];
+            for ( int i = 0; i < delta.num_removed; ++i ) value -= removed [ i ] [ n ];
+            dst [ n ] = value;
+        }
+#endif
+    }
+}
+
+
+
+/* EVALUATION */
+
+
+
+/** @name  evaluate
+ *
+ * @brief  Compute the output of the network.
+ * @param  acc: The accumulator for the position.
+ * @param  pc: The color whose move it is next.
+ * @return Integer value in centipawns, positive for pc, negative for not pc.
+ */
+int chess::nnue::evaluate ( const accumulator_t& acc, const pcolor pc ) noexcept
+{
+    /* Get the hidden layers, the player to move's first */
+    const std::array<const std::int16_t *, 2> hidden { acc.values [ cast_penum ( pc ) ].data (), acc.values [ cast_penum ( other_color ( pc ) ) ].data () };
+
+    /* Sum the clipped hidden layers multiplied by the output weights, one register of neurons at a time.
+     * Pairs of products are summed into 32-bit lanes, which VNNI can do in a single instruction.
+     */
+    std::int64_t sum = 0;
+#if CHESS_USE_AVX512
+    const __m512i zero = _mm512_setzero_si512 (), qa = _mm512_set1_epi16 ( QA );
+    __m512i total = zero;
+    for ( int p = 0; p < 2; ++p ) for ( int n = 0; n < HIDDEN_SIZE; n += 32 )
+    {
+        const __m512i value = _mm512_min_epi16 ( _mm512_max_epi16 ( _mm512_load_si512 ( hidden [ p ] + n ), zero ), qa );
+        const __m512i weight = _mm512_load_si512 ( network.output_weights [ p ].data () + n );
+    #ifdef __AVX512VNNI__
+        total = _mm512_dpwssd_epi32 ( total, value, weight );
+    #else
+        total = _mm512_add_epi32 ( total, _mm512_madd_epi16 ( value, weight ) );
+    #endif
+    }
+    sum = _mm512_reduce_add_epi32 ( total );
+#elif CHESS_USE_AVX2
+    const __m256i zero = _mm256_setzero_si256 (), qa = _mm256_set1_epi16 ( QA );
+    __m256i total = zero;
+    for ( int p = 0; p < 2; ++p ) for ( int n = 0; n < HIDDEN_SIZE; n += 16 )
+    {
+        const __m256i value = _mm256_min_epi16 ( _mm256_max_epi16 ( _mm256_load_si256 ( reinterpret_cast<const __m256i *> ( hidden [ p ] + n ) ), zero ), qa );
+        const __m256i weight = _mm256_load_si256 ( reinterpret_cast<const __m256i *> ( network.output_weights [ p ].data () + n ) );
+        total = _mm256_add_epi32 ( total, _mm256_madd_epi16 ( value, weight ) );
+    }
+    const __m128i total_128 = _mm_add_epi32 ( _mm256_castsi256_si128 ( total ), _mm256_extracti128_si256 ( total, 1 ) );
+    const __m128i total_64  = _mm_add_epi32 ( total_128, _mm_unpackhi_epi64 ( total_128, total_128 ) );
+    sum = _mm_cvtsi128_si32 ( _mm_add_epi32 ( total_64, _mm_shuffle_epi32 ( total_64, 1 ) ) );
+#else
+    for ( int p = 0; p < 2; ++p ) for ( int n = 0; n < HIDDEN_SIZE; ++n )
+        sum += std::clamp<int> ( hidden [ p ] [ n ], 0, QA ) * network.output_weights [ p ] [ n ];
+#endif
+
+    /* Add the bias, dequantize and scale to centipawns */
+    return std::clamp<std::int64_t> ( ( sum + network.output_bias ) * EVAL_SCALE / ( QA * QB ), -MAX_VALUE, MAX_VALUE );
+}
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * src/chess/remote_search.cpp
+ *
+ * Implementation of include/chess/remote_search.h
+ *
+ */
+
+
+
+/* INCLUDES */
+#include <louischessx/remote_search.h>
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+
+/* REMOTE SEARCH FUNCTIONS */
+
+
+
+/** @name  remote_search
+ *
+ * @brief  Search a position by splitting its root moves between workers, then merge their results.
+ *         Each worker searches its share of the root moves to a fixed depth with its own transposition table, so only the root move values are shared.
+ *         The root moves are ordered by a depth 1 search, then dealt to the workers in turn, so that each share has a mix of good and bad moves.
+ *         Given a single worker, the whole position is sent without splitting.
+ * @param  cb: The position to search.
+ * @param  pc: The color whose move it is next.
+ * @param  depth: The depth to search to.
+ * @param  max_nodes: The node budget of each worker.
+ * @param  workers: The workers to search on, which are each used by one thread.
+ * @throws chess_input_error if there are no workers, or a worker fails.
+ * @return An ab_result_t containing the best move of each share, ordered by value. Only the depth, total node count, duration and incomplete flag are also set.
+ *         The depth is that of the shallowest share, and the total node count includes every share.
+ */
+chess::chessboard::ab_result_t chess::remote_search ( const chessboard& cb, const pcolor pc, const int depth, const unsigned long long max_nodes, const std::span<remote_worker> workers )
+{
+    /* Throw if there are no workers */
+    if ( workers.empty () ) throw chess_input_error { "No workers to search on in remote_search ()." };
+
+    /* Deal the root moves into shares, unless there is only one worker, in which case there is one share of every move */
+    std::vector<std::vector<std::string>> shares ( 1 );
+    if ( workers.size () > 1 )
+    {
+        /* Order the root moves with a depth 1 search, with a small ttable since it is so shallow */
+        chessboard root_cb { cb };
+        chessboard::ab_ttable_t root_ttable { 1 };
+        const chessboard::ab_result_t root_result = root_cb.alpha_beta_search ( pc, 1, false, root_ttable );
+
+        /* Deal the moves, never making more shares than moves */
+        shares.assign ( std::min ( workers.size (), root_result.moves.size () ), {} );
+        for ( std::size_t i = 0; i < root_result.moves.size (); ++i ) shares.at ( i % shares.size () ).push_back ( cb.fide_serialize_move ( root_result.moves.at ( i ).first ) );
+
+        /* If there are no root moves, there is nothing to search */
+        if ( shares.empty () ) return chessboard::ab_result_t {};
+    }
+
+    /* Search each share on its own worker, storing the results and any error */
+    const std::string fen = cb.fen_serialize_board ( pc );
+    std::vector<remote_worker::result_t> results ( shares.size () );
+    std::vector<std::string> errors ( shares.size () );
+    {
+        std::vector<std::jthread> threads;
+        for ( std::size_t i = 0; i < shares.size (); ++i ) threads.emplace_back ( [ &, i ] ()
+        {
+            try { results.at ( i ) = workers [ i ].search ( fen, depth, max_nodes, shares.at ( i ) ); }
+            catch ( const std::exception& e ) { errors.at ( i ) = workers [ i ].get_address () + ": " + e.what (); }
+        } );
+    }
+
+    /* Rethrow the first error */
+    for ( const std::string& error : errors ) if ( error.size () ) throw chess_input_error { error };
+
+    /* Merge the results, deserializing the best move of each share */
+    chessboard::ab_result_t ab_result;
+    ab_result.depth = depth;
+    for ( const remote_worker::result_t& result : results )
+    {
+        if ( result.moves.size () ) ab_result.moves.emplace_back ( cb.fide_deserialize_move ( pc, result.moves.front ().first ), result.moves.front ().second );
+        ab_result.depth       = std::min ( ab_result.depth, result.depth );
+        ab_result.total_nodes += result.nodes;
+        ab_result.duration    = std::max ( ab_result.duration, std::chrono::duration_cast<chess_clock::duration> ( result.duration ) );
+        ab_result.incomplete |= result.incomplete;
+    }
+
+    /* Order the moves, and return the result */
+    std::stable_sort ( ab_result.moves.begin (), ab_result.moves.end (), [] ( const auto& lhs, const auto& rhs ) { return lhs.second > rhs.second; } );
+    return ab_result;
+}
+
+
+
+/* REMOTE WORKER */
+
+
+
+/** @name  address constructor
+ *
+ * @brief  Connects to a worker.
+ * @param  address: The address of the worker, as host:port.
+ * @throws chess_input_error if the address is invalid, or the worker cannot be connected to.
+ */
+chess::remote_worker::remote_worker ( const std::string& _address )
+    : address { _address }
+{
+    /* Split the address into the host and port */
+    const std::size_t colon = address.rfind ( ':' );
+    if ( colon == std::string::npos || colon == 0 || colon + 1 == address.size () ) throw chess_input_error { "Worker address '" + address + "' is not of the form host:port." };
+    const std::string host = address.substr ( 0, colon ), port = address.substr ( colon + 1 );
+
+    /* Look up the host */
+    addrinfo hints {}; hints.ai_family = AF_UNSPEC; hints.ai_socktype = SOCK_STREAM;
+    addrinfo * addresses = nullptr;
+    if ( getaddrinfo ( host.c_str (), port.c_str (), &hints, &addresses ) != 0 ) throw chess_input_error { "Failed to look up worker '" + address + "'." };
+
+    /* Connect to the first address which accepts */
+    for ( const addrinfo * it = addresses; it && fd < 0; it = it->ai_next )
+    {
+        fd = socket ( it->ai_family, it->ai_socktype, it->ai_protocol );
+        if ( fd >= 0 && connect ( fd, it->ai_addr, it->ai_addrlen ) < 0 ) { close ( fd ); fd = -1; }
+    }
+    freeaddrinfo ( addresses );
+    if ( fd < 0 ) throw chess_input_error { "Failed to connect to worker '" + address + "'." };
+
+    /* Disable Nagle's algorithm, since every message is a single small line which is waited on */
+    const int enable = 1;
+    setsockopt ( fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof ( enable ) );
+}
+
+/** @name  destructor
+ *
+ * @brief  Closes the connection.
+ */
+chess::remote_worker::~remote_worker ()
+{
+    /* Close the socket, if not moved from */
+    if ( fd >= 0 ) close ( fd );
+}
+
+
+
+/** @name  search
+ *
+ * @brief  Search a position on the worker, waiting for the result.
+ * @param  fen: The FEN of the position.
+ * @param  depth: The depth to search to.
+ * @param  max_nodes: The node budget of the search.
+ * @param  search_moves: The root moves to search in FIDE notation, or empty to search every root move.
+ * @throws chess_input_error if the connection fails, after which is_connected is false, or the worker could not search the position.
+ * @return The result.
+ */
+chess::remote_worker::result_t chess::remote_worker::search ( const std::string& fen, const int depth, const unsigned long long max_nodes, const std::vector<std::string>& search_moves )
+{
+    /* Throw if the connection has already failed, since the request and response lines may be out of step */
+    if ( !connected ) throw chess_input_error { "Lost connection to worker." };
+
+    /* Send the request */
+    std::string request = "search " + std::to_string ( depth ) + " " + std::to_string ( max_nodes ) + " " + fen;
+    if ( search_moves.size () ) request = std::accumulate ( search_moves.begin (), search_moves.end (), request + " moves", [] ( std::string lhs, const std::string& rhs ) { return lhs + " " + rhs; } );
+    if ( !write_line ( fd, request ) ) { connected = false; throw chess_input_error { "Lost connection to worker." }; }
+
+    /* Read the response */
+    std::string response;
+    if ( !read_line ( fd, buffer, response ) ) { connected = false; throw chess_input_error { "Lost connection to worker." }; }
+    std::istringstream response_stream { response };
+    std::string kind; response_stream >> kind;
+
+    /* If the worker has given an error, throw it */
+    if ( kind == "error" ) { std::string message; std::getline ( response_stream >> std::ws, message ); throw chess_input_error { "Worker could not search position: " + message }; }
+
+    /* Otherwise read the result */
+    result_t result; long long microseconds = 0;
+    if ( kind != "result" || !( response_stream >> result.depth >> result.nodes >> microseconds >> result.incomplete ) ) { connected = false; throw chess_input_error { "Malformed response from worker." }; }
+    result.duration = std::chrono::microseconds { microseconds };
+    if ( std::pair<std::string, int> move; response_stream >> move.first >> move.second ) result.moves.push_back ( move );
+    if ( !response_stream.eof () ) { connected = false; throw chess_input_error { "Malformed response from worker." }; }
+
+    /* Return the result */
+    return result;
+}
+
+
+
+/** @name  read_line
+ *
+ * @brief  Read a line from a socket.
+ * @param  fd: The socket.
+ * @param  buffer: Data received after the end of the last line, which is updated.
+ * @param  line: Set to the line read, without a newline.
+ * @return False if the connection closed or failed before a whole line was read, or the line is longer than MAX_LINE_LENGTH.
+ */
+bool chess::remote_worker::read_line ( const int fd, std::string& buffer, std::string& line )
+{
+    /* Receive until the buffer contains a newline, giving up if the line is too long to be valid */
+    for ( std::size_t end; ( end = buffer.find ( '\n' ) ) == std::string::npos; )
+    {
+        if ( buffer.size () > MAX_LINE_LENGTH ) return false;
+        char data [ 4096 ];
+        const ssize_t received = recv ( fd, data, sizeof ( data ), 0 );
+        if ( received <= 0 ) return false;
+        buffer.append ( data, received );
+    }
+
+    /* Take the line out of the buffer, removing any carriage return */
+    const std::size_t end = buffer.find ( '\n' );
+    line = buffer.substr ( 0, end - ( end && buffer [ end - 1 ] == '\r' ) );
+    buffer.erase ( 0, end + 1 );
+    return true;
+}
+
+/** @name  write_line
+ *
+ * @brief  Write a line to a socket.
+ * @param  fd: The socket.
+ * @param  line: The line to write, to which a newline is added.
+ * @return False if the connection closed or failed.
+ */
+bool chess::remote_worker::write_line ( const int fd, const std::string& line )
+{
+    /* Send until the whole line is written. MSG_NOSIGNAL stops a closed connection from raising SIGPIPE. */
+    const std::string data = line + "\n";
+    for ( std::size_t sent = 0; sent < data.size (); )
+    {
+        const ssize_t result = send ( fd, data.data () + sent, data.size () - sent, MSG_NOSIGNAL );
+        if ( result <= 0 ) return false;
+        sent += result;
+    }
+    return true;
+}
+
+
+
+/* REMOTE SERVER */
+
+
+
+/** @name  address constructor
+ *
+ * @brief  Starts listening for connections.
+ * @param  bind_address: The address to listen on, such as 127.0.0.1 for this machine only, or :: for every interface.
+ * @param  port: The TCP port to listen on.
+ * @throws chess_input_error if the address is invalid, or the port cannot be listened on.
+ */
+chess::remote_server::remote_server ( const std::string& bind_address, const int port )
+{
+    /* Throw if the port is out of range */
+    if ( port < 1 || port > 65535 ) throw chess_input_error { "Port must be between 1 and 65535." };
+
+    /* Look up the address */
+    addrinfo hints {}; hints.ai_family = AF_UNSPEC; hints.ai_socktype = SOCK_STREAM; hints.ai_flags = AI_PASSIVE;
+    addrinfo * addresses = nullptr;
+    if ( getaddrinfo ( bind_address.c_str (), std::to_string ( port ).c_str (), &hints, &addresses ) != 0 ) throw chess_input_error { "Failed to look up bind address '" + bind_address + "'." };
+
+    /* Listen on the first address which can be bound, allowing the port to be reused straight after an earlier server closes.
+     * IPv6 sockets also accept IPv4 connections, so that :: is every interface.
+     */
+    for ( const addrinfo * it = addresses; it && fd < 0; it = it->ai_next )
+    {
+        fd = socket ( it->ai_family, it->ai_socktype, it->ai_protocol );
+        if ( fd < 0 ) continue;
+        const int enable = 1, disable = 0;
+        setsockopt ( fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof ( enable ) );
+        if ( it->ai_family == AF_INET6 ) setsockopt ( fd, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof ( disable ) );
+        if ( bind ( fd, it->ai_addr, it->ai_addrlen ) < 0 || listen ( fd, SOMAXCONN ) < 0 ) { close ( fd ); fd = -1; }
+    }
+    freeaddrinfo ( addresses );
+    if ( fd < 0 ) throw chess_input_error { "Failed to listen on " + bind_address + " port " + std::to_string ( port ) + "." };
+}
+
+/** @name  destructor
+ *
+ * @brief  Stops listening.
+ */
+chess::remote_server::~remote_server ()
+{
+    /* Close the socket */
+    if ( fd >= 0 ) close ( fd );
+}
+
+
+
+/** @name  serve
+ *
+ * @brief  Accept and serve connections forever.
+ *         Once max_connections are being served, no more are accepted until one closes, so the rest wait to be served.
+ * @param  hash_mb: The size of the transposition table of each connection in MB.
+ * @param  num_threads: The number of threads to search each position with (see alpha_beta_iterative_deepening).
+ * @param  max_connections: The maximum number of connections to serve at once.
+ * @throws chess_input_error if max_connections is not positive.
+ * @return Never returns.
+ */
+void chess::remote_server::serve ( const std::size_t hash_mb, const int num_threads, const int max_connections )
+{
+    /* Throw if max_connections is not positive */
+    if ( max_connections < 1 ) throw chess_input_error { "Maximum number of connections must be positive." };
+
+    /* Accept connections, serving each on a detached thread, since connections are independent and last until the coordinator closes them.
+     * Only this thread adds connections, so once there are max_connections, it can wait for one to close before accepting another.
+     */
+    while ( true )
+    {
+        for ( int current = num_connections; current >= max_connections; current = num_connections ) num_connections.wait ( current );
+        const int connection_fd = accept ( fd, nullptr, nullptr );
+        if ( connection_fd < 0 ) continue;
+        ++num_connections;
+        std::thread { serve_connection, connection_fd, hash_mb, num_threads, std::ref ( num_connections ) }.detach ();
+    }
+}
+
+/** @name  serve_connection
+ *
+ * @brief  Serve requests from a connection until it is closed.
+ * @param  connection_fd: The socket of the connection, which is closed on return.
+ * @param  hash_mb: The size of the transposition table in MB.
+ * @param  num_threads: The number of threads to search each position with.
+ * @param  num_connections: The number of connections being served, which is decremented and notified on return.
+ * @return void
+ */
+void chess::remote_server::serve_connection ( const int connection_fd, const std::size_t hash_mb, const int num_threads, std::atomic<int>& num_connections )
+{
+    /* Disable Nagle's algorithm, since every message is a single small line which is waited on */
+    const int enable = 1;
+    setsockopt ( connection_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof ( enable ) );
+
+    /* Allocate the ttable, then handle requests until the connection closes */
+    chessboard::ab_ttable_t ttable { hash_mb };
+    std::string buffer;
+    for ( std::string request; remote_worker::read_line ( connection_fd, buffer, request ) && remote_worker::write_line ( connection_fd, handle_request ( request, ttable, num_threads ) ); );
+
+    /* Close the connection, and count it as finished */
+    close ( connection_fd );
+    --num_connections; num_connections.notify_one ();
+}
+
+/** @name  handle_request
+ *
+ * @brief  Handle a single request line.
+ * @param  request: The request, without a newline.
+ * @param  ttable: The transposition table to search with.
+ * @param  num_threads: The number of threads to search each position with.
+ * @return The response, without a newline.
+ */
+std::string chess::remote_server::handle_request ( const std::string& request, chessboard::ab_ttable_t& ttable, const int num_threads ) try
+{
+    /* Read the request, which has a six field FEN */
+    std::istringstream request_stream { request };
+    std::string kind, fen, field, moves_keyword; int depth = 0; unsigned long long max_nodes = 0;
+    if ( !( request_stream >> kind >> depth >> max_nodes ) || kind != "search" ) throw chess_input_error { "Malformed request." };
+    for ( int i = 0; i < 6 && request_stream >> field; ++i ) fen += ( i ? " " : "" ) + field;
+    if ( depth < 1 || depth > chessboard::MAX_SEARCH_DEPTH ) throw chess_input_error { "Depth must be between 1 and " + std::to_string ( chessboard::MAX_SEARCH_DEPTH ) + "." };
+
+    /* Set up the board, which requires one king of each color, and that the color not to move is not in check */
+    chessboard cb;
+    const pcolor pc = cb.fen_deserialize_board ( fen );
+    if ( cb.bb ( pcolor::white, ptype::king ).popcount () != 1 || cb.bb ( pcolor::black, ptype::king ).popcount () != 1 ) throw chess_input_error { "Position must have one king of each color." };
+    if ( cb.is_in_check ( other_color ( pc ) ) ) throw chess_input_error { "The color not to move is in check." };
+
+    /* Read the root moves to search, if any */
+    std::vector<move_t> search_moves;
+    if ( request_stream >> moves_keyword && moves_keyword != "moves" ) throw chess_input_error { "Malformed request." };
+    for ( std::string move; request_stream >> move; ) search_moves.push_back ( cb.fide_deserialize_move ( pc, move ) );
+
+    /* Search every depth up to the requested depth with a cleared ttable */
+    ttable.clear ();
+    std::vector<int> depths ( depth ); std::iota ( depths.begin (), depths.end (), 1 );
+    const auto t0 = chess_clock::now ();
+    const chessboard::ab_result_t ab_result = cb.alpha_beta_iterative_deepening ( pc, depths, true, ttable, std::stop_token {}, chess_clock::time_point::max (), {}, true, num_threads, max_nodes, nullptr, search_moves );
+    const auto t1 = chess_clock::now ();
+
+    /* Format the result, with the best move if there is one */
+    std::ostringstream response;
+    response << "result " << ab_result.depth << " " << ab_result.total_nodes << " " << std::chrono::duration_cast<std::chrono::microseconds> ( t1 - t0 ).count () << " " << ( ab_result.depth < depth );
+    if ( ab_result.moves.size () ) response << " " << cb.fide_serialize_move ( ab_result.moves.front ().first ) << " " << ab_result.moves.front ().second;
+    return response.str ();
+}
+
+/* Catch any error, such as an invalid FEN or move, or a failure to allocate, so that the connection is kept */
+catch ( const std::exception& e )
+{
+    /* Return the error */
+    return std::string { "error " } + e.what ();
+}
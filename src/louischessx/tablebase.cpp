@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * src/chess/tablebase.cpp
+ *
+ * Implementation of include/chess/tablebase.h
+ *
+ */
+
+
+
+/* INCLUDES */
+#include <louischessx/tablebase.h>
+
+#include <algorithm>
+#include <mutex>
+
+#if CHESS_USE_SYZYGY
+    #include <tbprobe.h>
+#endif
+
+
+
+/* INITIALIZATION */
+
+
+
+/** @name  init
+ *
+ * @brief  Load the tablebases in a set of directories, replacing any tablebases previously loaded.
+ *         Should not be called while a search is running.
+ * @param  path: The directories containing the tables, separated by colons.
+ * @throws chess_input_error if tablebase support is not compiled in, or no tables could be loaded.
+ * @return void
+ */
+void chess::tablebase::init ( [[maybe_unused]] const std::string& path )
+{
+#if CHESS_USE_SYZYGY
+    /* Initialize Fathom, which frees any previously loaded tables */
+    largest = 0;
+    if ( !tb_init ( path.c_str () ) ) throw chess_input_error { "Failed to initialize Syzygy tablebases." };
+
+    /* Throw if no tables were found */
+    if ( TB_LARGEST == 0 ) throw chess_input_error { "No Syzygy tablebases found." };
+    largest = TB_LARGEST;
+#else
+    /* Tablebases are not supported */
+    throw chess_input_error { "Syzygy tablebase support was not compiled in (define CHESS_USE_SYZYGY)." };
+#endif
+}
+
+
+
+/* PROBING */
+
+
+
+/** @name  probe_wdl
+ *
+ * @brief  Probe the WDL tables for the value of a position.
+ *         Cursed wins and blessed losses, which are decided by the fifty-move rule, are given as draws.
+ *         This only reads the tables, so may be called from any search thread.
+ * @param  cb: The position.
+ * @param  pc: The color who is to move.
+ * @param  fd_depth: The number of moves made since the root, so that nearer wins are preferred.
+ * @return The value of the position for pc, or std::nullopt if it is not in the tables.
+ */
+std::optional<int> chess::tablebase::probe_wdl ( [[maybe_unused]] const chessboard& cb, [[maybe_unused]] const pcolor pc, [[maybe_unused]] const int fd_depth ) noexcept
+{
+#if CHESS_USE_SYZYGY
+    /* Get the en passant target, which is only given if pc may capture */
+    const chessboard::aux_info_t& aux_info = cb.get_aux_info ();
+    const unsigned ep = ( aux_info.en_passant_color == pc ? aux_info.en_passant_target : 0 );
+
+    /* Probe the tables. There must be no castling rights, and the fifty-move counter must be zero. */
+    const unsigned result = tb_probe_wdl
+    (
+        cb.bb ( pcolor::white ).get_value (), cb.bb ( pcolor::black ).get_value (),
+        cb.bb ( ptype::king ).get_value (), cb.bb ( ptype::queen ).get_value (), cb.bb ( ptype::rook ).get_value (),
+        cb.bb ( ptype::bishop ).get_value (), cb.bb ( ptype::knight ).get_value (), cb.bb ( ptype::pawn ).get_value (),
+        0, 0, ep, pc == pcolor::white
+    );
+
+    /* Convert the result to a value */
+    if ( result == TB_RESULT_FAILED ) return std::nullopt;
+    if ( result == TB_WIN  ) return  WIN_VALUE - fd_depth;
+    if ( result == TB_LOSS ) return -WIN_VALUE + fd_depth;
+    return 0;
+#else
+    /* Tablebases are not supported */
+    return std::nullopt;
+#endif
+}
+
+/** @name  probe_root
+ *
+ * @brief  Probe the DTZ tables for the value of every legal move in a position.
+ *         Wins are valued higher the sooner they zero the fifty-move counter, and losses higher the later.
+ * @param  cb: The position.
+ * @param  pc: The color who is to move.
+ * @return Each legal move and its value for pc, or std::nullopt if the position is not in the tables.
+ */
+std::optional<std::vector<std::pair<chess::move_t, int>>> chess::tablebase::probe_root ( [[maybe_unused]] const chessboard& cb, [[maybe_unused]] const pcolor pc )
+{
+#if CHESS_USE_SYZYGY
+    /* Fathom's root probe is not thread-safe, so only one thread may probe at once */
+    static std::mutex root_probe_mx;
+    std::unique_lock root_probe_lock { root_probe_mx };
+
+    /* Get the en passant target, which is only given if pc may capture */
+    const chessboard::aux_info_t& aux_info = cb.get_aux_info ();
+    const unsigned ep = ( aux_info.en_passant_color == pc ? aux_info.en_passant_target : 0 );
+
+    /* Probe the tables, getting the result of each legal move. The fifty-move counter is given so that DTZ accounts for it. */
+    unsigned results [ TB_MAX_MOVES ];
+    const unsigned result = tb_probe_root
+    (
+        cb.bb ( pcolor::white ).get_value (), cb.bb ( pcolor::black ).get_value (),
+        cb.bb ( ptype::king ).get_value (), cb.bb ( ptype::queen ).get_value (), cb.bb ( ptype::rook ).get_value (),
+        cb.bb ( ptype::bishop ).get_value (), cb.bb ( ptype::knight ).get_value (), cb.bb ( ptype::pawn ).get_value (),
+        cb.get_halfmove_clock (), 0, ep, pc == pcolor::white, results
+    );
+
+    /* Return on failure, or if there are no legal moves */
+    if ( result == TB_RESULT_FAILED || result == TB_RESULT_CHECKMATE || result == TB_RESULT_STALEMATE ) return std::nullopt;
+
+    /* Convert each result to a move and value */
+    std::vector<std::pair<move_t, int>> moves;
+    for ( const unsigned * it = results; * it != TB_RESULT_FAILED; ++it )
+    {
+        /* Get the move */
+        const int from = TB_GET_FROM ( * it ), to = TB_GET_TO ( * it );
+        const ptype pt = cb.find_type ( pc, from );
+        const ptype capture_pt = ( TB_GET_EP ( * it ) ? ptype::pawn : cb.find_type ( other_color ( pc ), to ) );
+
+        /* Get the promotion type. Fathom orders these from queen to knight. */
+        ptype promote_pt = ptype::no_piece;
+        switch ( TB_GET_PROMOTES ( * it ) )
+        {
+            case TB_PROMOTES_QUEEN:  promote_pt = ptype::queen;  break;
+            case TB_PROMOTES_ROOK:   promote_pt = ptype::rook;   break;
+            case TB_PROMOTES_BISHOP: promote_pt = ptype::bishop; break;
+            case TB_PROMOTES_KNIGHT: promote_pt = ptype::knight; break;
+        }
+
+        /* Get the value of the move, capping the DTZ so that wins are always positive and losses negative */
+        const unsigned wdl = TB_GET_WDL ( * it );
+        const int dtz = std::min<int> ( TB_GET_DTZ ( * it ), WIN_VALUE / 2 );
+        const int value = ( wdl == TB_WIN ? WIN_VALUE - dtz : wdl == TB_LOSS ? -WIN_VALUE + dtz : 0 );
+
+        /* Add the move */
+        moves.emplace_back ( move_t { pc, pt, capture_pt, promote_pt, from, to }, value );
+    }
+
+    /* Return the moves */
+    return moves;
+#else
+    /* Tablebases are not supported */
+    return std::nullopt;
+#endif
+}
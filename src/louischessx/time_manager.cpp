@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020 Louis Hobson <louis-hobson@hotmail.co.uk>. All Rights Reserved.
+ *
+ * Distributed under MIT licence as a part of the Chess C++ library.
+ * For details, see: https://github.com/louishobson/Chess/blob/master/LICENSE
+ *
+ * src/chess/time_manager.cpp
+ *
+ * Implementation of include/chess/time_manager.h
+ *
+ */
+
+
+
+/* INCLUDES */
+#include <louischessx/time_manager.h>
+
+#include <algorithm>
+
+
+
+/* LIMITS */
+
+
+
+/** @name  restart
+ *
+ * @brief  Set new limits, keeping what has been learnt from the depths searched so far. May be called while a search is running.
+ * @param  start: The time to measure the durations from.
+ * @param  optimum: The duration the search should take when the best move is neither stable nor unstable.
+ * @param  maximum: The duration after which the search must stop.
+ * @return void
+ */
+void chess::time_manager::restart ( const chess_clock::time_point start, const chess_clock::duration optimum, const chess_clock::duration maximum ) noexcept
+{
+    /* Set the limits */
+    start_point = start; optimum_duration = optimum; maximum_duration = maximum;
+}
+
+/** @name  hard_end_point
+ *
+ * @brief  Get the time point at which the search must stop.
+ * @return chess_clock::time_point
+ */
+chess::chess_clock::time_point chess::time_manager::hard_end_point () const noexcept
+{
+    /* An unlimited maximum never ends */
+    const chess_clock::duration maximum = maximum_duration;
+    return ( maximum == chess_clock::duration::max () ? chess_clock::time_point::max () : start_point.load () + maximum );
+}
+
+/** @name  soft_end_point
+ *
+ * @brief  Get the time point after which no new depth should be started (or expected to finish).
+ *         Only the searching thread should call this.
+ * @return chess_clock::time_point
+ */
+chess::chess_clock::time_point chess::time_manager::soft_end_point () const noexcept
+{
+    /* If the optimum is not less than the maximum, use the hard end point */
+    const chess_clock::duration optimum = optimum_duration, maximum = maximum_duration;
+    if ( optimum >= maximum ) return hard_end_point ();
+
+    /* Stretch for recent changes of best move */
+    double scale = 1.0 + BEST_MOVE_CHANGE_FACTOR * best_move_changes;
+
+    /* Shrink if the best move has been stable */
+    if ( stable_depths > STABLE_MIN_DEPTHS ) scale *= std::max ( STABLE_MIN_SCALE, 1.0 - STABLE_FACTOR * ( stable_depths - STABLE_MIN_DEPTHS ) );
+
+    /* Stretch in proportion to any drop in score, and if failed low */
+    if ( score_drop > SCORE_DROP_MARGIN ) scale *= 1.0 + SCORE_DROP_FACTOR * std::min ( score_drop, SCORE_DROP_MAX ) / SCORE_DROP_MAX;
+    if ( has_failed_low ) scale *= FAILED_LOW_FACTOR;
+
+    /* Scale the optimum, never exceeding the maximum */
+    return start_point.load () + std::min ( std::chrono::duration_cast<chess_clock::duration> ( optimum * std::min ( scale, MAX_SCALE ) ), maximum );
+}
+
+
+
+/* SEARCH RESULTS */
+
+
+
+/** @name  depth_complete
+ *
+ * @brief  Consider the result of a complete depth. Only the searching thread should call this.
+ * @param  ab_result: The result, which must contain at least one move.
+ * @return void
+ */
+void chess::time_manager::depth_complete ( const chessboard::ab_result_t& ab_result ) noexcept
+{
+    /* Get the best move and its value */
+    const auto& [ new_best_move, new_best_value ] = ab_result.moves.front ();
+
+    /* Age the recent changes of best move, then count the new depth as stable or as another change */
+    best_move_changes /= 2;
+    if ( has_best_move && !new_best_move.is_similar ( best_move ) ) { ++best_move_changes; stable_depths = 0; } else if ( has_best_move ) ++stable_depths;
+
+    /* Get the drop in score since the previous depth */
+    score_drop = ( has_best_move ? best_value - new_best_value : 0 );
+
+    /* Store the new best move, and reset the fail low flag since the depth is complete */
+    best_move = new_best_move; best_value = new_best_value; has_best_move = true;
+    has_failed_low = false;
+}